@@ -2,29 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 
-/****
-  Basic hash table key/value pair
- ****/
-typedef struct Pair
-{
-  // pointer to key string
-  char *key;
-  // pointer to value string
-  char *value;
-  // Pair
-} Pair;
-
-/****
-  Basic hash table
- ****/
-typedef struct BasicHashTable
-{
-  // hash table has capacity
-  int capacity;
-  // Pair struct type with pointer to array storage, which is an array of key value pairs
-  Pair **storage;
-  // Basic Hash Table
-} BasicHashTable;
+#include "b_hashtables.h"
 
 /****
   Create a key/value pair to be stored in the hash table.
@@ -81,6 +59,179 @@ unsigned int hash(char *str, int max)
   return hash % max;
 }
 
+// evictions one insert makes before its homeless pair goes to the stash
+#define BASIC_MAX_KICKS 500
+
+/****
+  Hash a key with the table's hash function.
+ ****/
+static uint64_t hash_key(BasicHashTable *ht, char *key)
+{
+  return ht->hash_function(key, strlen(key), ht->seed);
+}
+
+/****
+  The two buckets of a full hash. The low bits pick the first, the
+  second comes from remixing the whole hash, so keys sharing the first
+  bucket are spread over different second ones. Buckets are numbered,
+  bucket b is storage[b * BASIC_BUCKET_SLOTS] onwards.
+ ****/
+static unsigned int first_bucket(BasicHashTable *ht, uint64_t full_hash)
+{
+  return (unsigned int)(full_hash & (uint64_t)(ht->capacity / BASIC_BUCKET_SLOTS - 1));
+}
+
+static unsigned int second_bucket(BasicHashTable *ht, uint64_t full_hash)
+{
+  return (unsigned int)(hash_wy_mix(full_hash, 0x9e3779b97f4a7c15ull) & (uint64_t)(ht->capacity / BASIC_BUCKET_SLOTS - 1));
+}
+
+/****
+  Find the slot holding key, in its two buckets or the stash. Returns
+  NULL if the key is not stored. stash_index is set to the key's place
+  in the stash, or -1 if it is in a bucket.
+ ****/
+static Pair **find_slot(BasicHashTable *ht, char *key, uint64_t full_hash, int *stash_index)
+{
+  *stash_index = -1;
+  unsigned int buckets[2] = {first_bucket(ht, full_hash), second_bucket(ht, full_hash)};
+  for (int b = 0; b < 2; b++)
+  {
+    Pair **bucket = &ht->storage[buckets[b] * BASIC_BUCKET_SLOTS];
+    for (int i = 0; i < BASIC_BUCKET_SLOTS; i++)
+    {
+      // the cached hash rules out almost every other key without reading it
+      if (bucket[i] != NULL && bucket[i]->hash == full_hash && strcmp(bucket[i]->key, key) == 0)
+      {
+        return &bucket[i];
+      }
+    }
+  }
+  for (int i = 0; i < ht->stash_count; i++)
+  {
+    if (ht->stash[i]->hash == full_hash && strcmp(ht->stash[i]->key, key) == 0)
+    {
+      *stash_index = i;
+      return &ht->stash[i];
+    }
+  }
+  return NULL;
+}
+
+/****
+  Put pair in an empty slot of one of its buckets, if either has one.
+ ****/
+static int place_in_bucket(BasicHashTable *ht, Pair *pair)
+{
+  unsigned int buckets[2] = {first_bucket(ht, pair->hash), second_bucket(ht, pair->hash)};
+  for (int b = 0; b < 2; b++)
+  {
+    Pair **bucket = &ht->storage[buckets[b] * BASIC_BUCKET_SLOTS];
+    for (int i = 0; i < BASIC_BUCKET_SLOTS; i++)
+    {
+      if (bucket[i] == NULL)
+      {
+        bucket[i] = pair;
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+/****
+  Cuckoo insert: with both buckets full, the pair takes the slot of a
+  random pair in one of them, and that pair moves to its other bucket,
+  displacing another in turn. Returns the pair left without a slot
+  after BASIC_MAX_KICKS moves, NULL once everything has one.
+ ****/
+static Pair *displace(BasicHashTable *ht, Pair *pair)
+{
+  // start in either bucket, so a key cannot keep kicking the same pairs
+  ht->rng ^= ht->rng << 13;
+  ht->rng ^= ht->rng >> 7;
+  ht->rng ^= ht->rng << 17;
+  unsigned int bucket = (ht->rng >> 32) & 1 ? second_bucket(ht, pair->hash) : first_bucket(ht, pair->hash);
+  for (int kick = 0; kick < BASIC_MAX_KICKS; kick++)
+  {
+    if (place_in_bucket(ht, pair))
+    {
+      return NULL;
+    }
+    // swap the homeless pair with a random one of the bucket
+    ht->rng ^= ht->rng << 13;
+    ht->rng ^= ht->rng >> 7;
+    ht->rng ^= ht->rng << 17;
+    Pair **slot = &ht->storage[bucket * BASIC_BUCKET_SLOTS + (ht->rng & (BASIC_BUCKET_SLOTS - 1))];
+    Pair *evicted = *slot;
+    *slot = pair;
+    pair = evicted;
+    // the evicted pair goes on to the bucket it was not in
+    unsigned int first = first_bucket(ht, pair->hash);
+    bucket = bucket == first ? second_bucket(ht, pair->hash) : first;
+  }
+  return place_in_bucket(ht, pair) ? NULL : pair;
+}
+
+static void resize(BasicHashTable *ht, int capacity);
+
+/****
+  Store a pair that is not in the table yet, wherever it fits: its
+  buckets, the stash, or a table twice the size.
+ ****/
+static void place_pair(BasicHashTable *ht, Pair *pair)
+{
+  pair = displace(ht, pair);
+  if (pair == NULL)
+  {
+    return;
+  }
+  if (ht->stash_count < BASIC_STASH_SIZE || ht->count < ht->capacity / 2)
+  {
+    // doubling a table this empty would not help, the hash is to blame
+    if (ht->stash_count == ht->stash_capacity)
+    {
+      ht->stash_capacity *= 2;
+      ht->stash = realloc(ht->stash, ht->stash_capacity * sizeof(Pair *));
+    }
+    ht->stash[ht->stash_count++] = pair;
+    return;
+  }
+  resize(ht, ht->capacity * 2);
+  place_pair(ht, pair);
+}
+
+/****
+  Move every pair, stashed ones included, into a new storage array of
+  capacity slots. Pairs are moved, not copied.
+ ****/
+static void resize(BasicHashTable *ht, int capacity)
+{
+  Pair **old_storage = ht->storage;
+  int old_capacity = ht->capacity;
+  Pair **old_stash = ht->stash;
+  int old_stash_count = ht->stash_count;
+
+  ht->storage = calloc(capacity, sizeof(Pair *));
+  ht->capacity = capacity;
+  ht->stash = malloc(BASIC_STASH_SIZE * sizeof(Pair *));
+  ht->stash_count = 0;
+  ht->stash_capacity = BASIC_STASH_SIZE;
+  for (int i = 0; i < old_capacity; i++)
+  {
+    if (old_storage[i])
+    {
+      place_pair(ht, old_storage[i]);
+    }
+  }
+  for (int i = 0; i < old_stash_count; i++)
+  {
+    place_pair(ht, old_stash[i]);
+  }
+  free(old_storage);
+  free(old_stash);
+}
+
 /****
   Fill this in.
 
@@ -92,13 +243,26 @@ BasicHashTable *create_hash_table(int capacity)
   // From the BasicHashTable struct, create new ht pointer, allocate enough memory for Basic HashTable type
   // ht has capacity and storage
   BasicHashTable *ht = malloc(sizeof(BasicHashTable));
-  // assign the int type capacity to the capacity of the ht struct
-  ht->capacity = capacity;
+  // assign the int type capacity, rounded up to a power of two of at least one bucket, to the capacity of the ht struct
+  ht->capacity = BASIC_BUCKET_SLOTS;
+  while (ht->capacity < capacity)
+  {
+    ht->capacity <<= 1;
+  }
+  ht->count = 0;
   // use calloc which allocates mem and initializes allocated mem block to zero
   // arguments: num of blacks to be allocated, size of each block
   // in this case it is capacity and the bytes to fit in the Pair struct
   // calloc Pair type pointer
-  ht->storage = calloc(capacity, sizeof(Pair *));
+  ht->storage = calloc(ht->capacity, sizeof(Pair *));
+  // empty stash with room for the usual handful of pairs
+  ht->stash = malloc(BASIC_STASH_SIZE * sizeof(Pair *));
+  ht->stash_count = 0;
+  ht->stash_capacity = BASIC_STASH_SIZE;
+  // djb2 until the caller picks another hash function
+  ht->hash_function = hash_djb2;
+  ht->seed = 0;
+  ht->rng = 0x2545f4914f6cdd1dull;
   // return new ht
   return ht;
 }
@@ -106,25 +270,29 @@ BasicHashTable *create_hash_table(int capacity)
 /****
   Fill this in.
 
-  If you are overwriting a value with a different key, print a warning.
+  Inserting a key that is already stored overwrites its value, keys
+  that merely collide are kept side by side.
 
   Don't forget to free any malloc'ed memory!
  ****/
 void hash_table_insert(BasicHashTable *ht, char *key, char *value)
 {
-  //our hash function expects to return unsigned int type, and two arguments, key and max, which is capacity
-  unsigned int hashIndex = hash(key, ht->capacity);
-  // if we are overwriting value with different key, print warning,
-  // we can check if there is a value at the storage index
-  if (ht->storage[hashIndex])
+  // hash the key once, both buckets come from this hash
+  uint64_t full_hash = hash_key(ht, key);
+  int stash_index;
+  Pair **slot = find_slot(ht, key, full_hash, &stash_index);
+  // if the key is already stored, only its value is replaced
+  if (slot != NULL)
   {
-    // print warning
-    printf("There is already a value at that current hash index, overwriting.");
-    // invoke destroy pair function, which frees malloc'ed memory
-    destroy_pair(ht->storage[hashIndex]);
+    free((*slot)->value);
+    (*slot)->value = strdup(value);
+    return;
   }
-  // create new pair and store it at the hash index
-  ht->storage[hashIndex] = create_pair(key, value);
+  // create new pair and find it a slot
+  Pair *pair = create_pair(key, value);
+  pair->hash = full_hash;
+  ht->count++;
+  place_pair(ht, pair);
 }
 
 /****
@@ -134,15 +302,31 @@ void hash_table_insert(BasicHashTable *ht, char *key, char *value)
  ****/
 void hash_table_remove(BasicHashTable *ht, char *key)
 {
-  // first we need to find the hash index, same as insert
-  unsigned int hashIndex = hash(key, ht->capacity);
-  // if ht at storage index hashIndex exists
-  if (ht->storage[hashIndex])
+  // first we need to find the key's slot, same as insert
+  uint64_t full_hash = hash_key(ht, key);
+  int stash_index;
+  Pair **slot = find_slot(ht, key, full_hash, &stash_index);
+  if (slot == NULL)
+  {
+    return;
+  }
+  // invoke destroy pair function, which frees malloc'ed memory
+  destroy_pair(*slot);
+  ht->count--;
+  if (stash_index >= 0)
   {
-    // invoke destroy pair function, which frees malloc'ed memory
-    destroy_pair(ht->storage[hashIndex]);
-    // reassign storage at hashindex to null
-    ht->storage[hashIndex] = NULL;
+    // keep the stash packed, the last stashed pair fills the gap
+    *slot = ht->stash[--ht->stash_count];
+    return;
+  }
+  *slot = NULL;
+  // a slot came free, stashed pairs that belong to that bucket move back in
+  for (int i = 0; i < ht->stash_count; i++)
+  {
+    if (place_in_bucket(ht, ht->stash[i]))
+    {
+      ht->stash[i--] = ht->stash[--ht->stash_count];
+    }
   }
 }
 
@@ -153,15 +337,14 @@ void hash_table_remove(BasicHashTable *ht, char *key)
  ****/
 char *hash_table_retrieve(BasicHashTable *ht, char *key)
 {
-  // repeat to find hash index
-  unsigned int hashIndex = hash(key, ht->capacity);
-  // if ht at storage index hash index exists
-  if (ht->storage[hashIndex])
+  // two buckets and the stash are all the places the key can be
+  int stash_index;
+  Pair **slot = find_slot(ht, key, hash_key(ht, key), &stash_index);
+  if (slot != NULL)
   {
-    // return the value at the storage at the hash index
-    return ht->storage[hashIndex]->value;
+    return (*slot)->value;
   }
-  // if no value at storage at hash index, return null
+  // if the key is not in any of them, return null
   return NULL;
 }
 
@@ -180,16 +363,34 @@ void destroy_hash_table(BasicHashTable *ht)
     {
       // invoke destroy pair apss in the storage at index i
       destroy_pair(ht->storage[i]);
-      // reassign ht storage at i to null
+      // reassign storage at i to null
       ht->storage[i] = NULL;
     }
   }
+  // stashed pairs are owned by the table too
+  for (int i = 0; i < ht->stash_count; i++)
+  {
+    destroy_pair(ht->stash[i]);
+  }
+  free(ht->stash);
   // free hashtable storage
   free(ht->storage);
   // free hash table
   free(ht);
 }
 
+/****
+  Hash keys with hash_function keyed by seed, for example `hash_wyhash`
+  with `hash_random_seed()` from utils/hash.h.
+
+  Only call this on an empty table, stored pairs are not moved.
+ ****/
+void hash_table_set_hash_function(BasicHashTable *ht, HashFunction hash_function, uint64_t seed)
+{
+  ht->hash_function = hash_function;
+  ht->seed = seed;
+}
+
 #ifndef TESTING
 int main(void)
 {
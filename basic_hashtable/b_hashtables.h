@@ -1,14 +1,45 @@
 #ifndef hashtables_h
 #define hashtables_h
 
+#include <stdint.h>
+
+#include "../utils/hash.h"
+
+/*
+  `hash` is the full hash of the key, it picks the pair's two buckets
+  again when the pair is moved and is compared before the key.
+ */
 typedef struct Pair {
   char *key;
   char *value;
+  uint64_t hash;
 } Pair;
 
+#define BASIC_BUCKET_SLOTS 4
+#define BASIC_STASH_SIZE 4
+
+/*
+  Bucketized cuckoo hash table. `storage` is still a single array of
+  `capacity` pair pointers, read as buckets of BASIC_BUCKET_SLOTS slots.
+  A key lives in one of two buckets, so a lookup reads at most two of
+  them, plus the stash while it holds anything.
+
+  The stash takes the pairs an insert could not find room for within
+  its displacement bound. It is a small array, only grown past
+  BASIC_STASH_SIZE while the table is less than half full, which takes
+  a bad hash function to happen; otherwise a full stash doubles the
+  table. `rng` picks the pairs an insert displaces.
+ */
 typedef struct BasicHashTable {
   int capacity;
+  int count;
   Pair **storage;
+  Pair **stash;
+  int stash_count;
+  int stash_capacity;
+  HashFunction hash_function;
+  uint64_t seed;
+  uint64_t rng;
 } BasicHashTable;
 
 
@@ -22,5 +53,7 @@ char *hash_table_retrieve(BasicHashTable *ht, char *key);
 
 void destroy_hash_table(BasicHashTable *ht);
 
+void hash_table_set_hash_function(BasicHashTable *ht, HashFunction hash_function, uint64_t seed);
+
 
 #endif
\ No newline at end of file
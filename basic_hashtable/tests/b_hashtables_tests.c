@@ -23,12 +23,125 @@ char *basic_hash_table_test()
     return NULL;
 }
 
+char *basic_hash_table_seeded_hash_test()
+{
+    BasicHashTable *ht = create_hash_table(10);
+    mu_assert(ht->capacity == 16, "Capacity was not rounded up to a power of two");
+
+    hash_table_set_hash_function(ht, hash_wyhash, hash_random_seed());
+    hash_table_insert(ht, "key-0", "val-0");
+    mu_assert(strcmp(hash_table_retrieve(ht, "key-0"), "val-0") == 0, "Value is not stored correctly");
+    hash_table_remove(ht, "key-0");
+    mu_assert(hash_table_retrieve(ht, "key-0") == NULL, "Deleted value is not NULL");
+
+    destroy_hash_table(ht);
+
+    return NULL;
+}
+
+/*
+  Colliding keys are all kept, however full the table gets.
+ */
+char *basic_hash_table_cuckoo_test()
+{
+    BasicHashTable *ht = create_hash_table(8);
+    char key[32], value[32];
+    for (int i = 0; i < 10000; i++)
+    {
+        sprintf(key, "key-%d", i);
+        sprintf(value, "val-%d", i);
+        hash_table_insert(ht, key, value);
+    }
+    mu_assert(ht->count == 10000 && ht->capacity < 10000 / 0.4, "Table did not fill up before growing");
+    for (int i = 0; i < 10000; i++)
+    {
+        sprintf(key, "key-%d", i);
+        sprintf(value, "val-%d", i);
+        char *return_value = hash_table_retrieve(ht, key);
+        mu_assert(return_value != NULL && strcmp(return_value, value) == 0, "Colliding key lost its value");
+    }
+    // a missing key that shares buckets with stored ones is not found
+    mu_assert(hash_table_retrieve(ht, "key-10000") == NULL, "Missing key has a value");
+
+    for (int i = 0; i < 10000; i += 2)
+    {
+        sprintf(key, "key-%d", i);
+        hash_table_remove(ht, key);
+    }
+    hash_table_remove(ht, "key-0");
+    mu_assert(ht->count == 5000, "Remove did not take exactly one pair each");
+    mu_assert(hash_table_retrieve(ht, "key-2") == NULL && strcmp(hash_table_retrieve(ht, "key-3"), "val-3") == 0, "Remove took the wrong pair");
+
+    destroy_hash_table(ht);
+
+    return NULL;
+}
+
+static uint64_t basic_constant_hash(const void *key, size_t len, uint64_t seed)
+{
+    (void)key;
+    (void)len;
+    (void)seed;
+    return 1;
+}
+
+/*
+  With every key in the same two buckets, the stash keeps the rest
+  instead of the table growing without end.
+ */
+char *basic_hash_table_stash_test()
+{
+    BasicHashTable *ht = create_hash_table(8);
+    hash_table_set_hash_function(ht, basic_constant_hash, 0);
+    char key[32];
+    for (int i = 0; i < 100; i++)
+    {
+        sprintf(key, "key-%d", i);
+        hash_table_insert(ht, key, key);
+    }
+    mu_assert(ht->count == 100 && ht->stash_count == 100 - 2 * BASIC_BUCKET_SLOTS && ht->capacity <= 256, "Stash did not take the overflow");
+    for (int i = 0; i < 100; i++)
+    {
+        sprintf(key, "key-%d", i);
+        mu_assert(strcmp(hash_table_retrieve(ht, key), key) == 0, "Stashed key lost its value");
+    }
+
+    // both buckets are full, and they are two different buckets
+    int first = -1, second = -1;
+    for (int i = 0; i < ht->capacity; i++)
+    {
+        if (ht->storage[i] != NULL && first < 0)
+        {
+            first = i;
+        }
+        else if (ht->storage[i] != NULL && i / BASIC_BUCKET_SLOTS != first / BASIC_BUCKET_SLOTS)
+        {
+            second = i;
+        }
+    }
+    mu_assert(second >= 0, "Keys did not use two buckets");
+
+    // a freed bucket slot is refilled from the stash
+    Pair *stashed = ht->stash[0];
+    char removed[32];
+    strcpy(removed, ht->storage[second]->key);
+    hash_table_remove(ht, removed);
+    mu_assert(ht->storage[second] == stashed && ht->stash_count == 100 - 2 * BASIC_BUCKET_SLOTS - 1, "Stashed key did not move into the freed slot");
+    mu_assert(hash_table_retrieve(ht, removed) == NULL && strcmp(hash_table_retrieve(ht, stashed->key), stashed->key) == 0, "Remove took the wrong pair");
+
+    destroy_hash_table(ht);
+
+    return NULL;
+}
 
 char *all_tests()
 {
     mu_suite_start();
 
     mu_run_test(basic_hash_table_test);
+    mu_run_test(basic_hash_table_seeded_hash_test);
+    mu_run_test(basic_hash_table_cuckoo_test);
+    mu_run_test(basic_hash_table_stash_test);
 
     return NULL;
 }
@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+/*
+  Bump arena with size class free lists.
+
+  Small blocks (up to ARENA_MAX_SMALL bytes) are carved off the end of the
+  newest chunk, rounded up to a multiple of ARENA_ALIGN. Blocks allocated
+  one after another therefore sit next to each other in memory, and a
+  whole arena is released by freeing a handful of chunks instead of every
+  block on its own.
+
+  A freed small block is pushed onto the free list of its size class and
+  handed out again by the next allocation of that class, so a table with
+  steady insert/remove churn does not keep growing its arena.
+
+  Large blocks come straight from malloc, but are kept on a doubly linked
+  list so destroy_arena can still release them all.
+ */
+
+// chunk header is padded so the first block stays ARENA_ALIGN aligned
+#define ARENA_CHUNK_HEADER ((sizeof(ArenaChunk) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+#define ARENA_LARGE_HEADER ((sizeof(ArenaLarge) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+/*
+  Size class of a small block, class i holds blocks of (i + 1) * ARENA_ALIGN bytes.
+ */
+static size_t arena_size_class(size_t size)
+{
+  return size == 0 ? 0 : (size - 1) / ARENA_ALIGN;
+}
+
+Arena *create_arena(size_t chunk_size)
+{
+  Arena *arena = calloc(1, sizeof(Arena));
+  // every chunk has to fit at least one block of the largest small class
+  arena->chunk_size = chunk_size < ARENA_MAX_SMALL ? ARENA_MAX_SMALL : chunk_size;
+  return arena;
+}
+
+/*
+  Large blocks bypass the chunks but are still owned by the arena.
+ */
+static void *arena_alloc_large(Arena *arena, size_t size)
+{
+  ArenaLarge *block = malloc(ARENA_LARGE_HEADER + size);
+  block->prev = NULL;
+  block->next = arena->large;
+  if (arena->large != NULL)
+  {
+    arena->large->prev = block;
+  }
+  arena->large = block;
+  return (char *)block + ARENA_LARGE_HEADER;
+}
+
+void *arena_alloc(Arena *arena, size_t size)
+{
+  if (size > ARENA_MAX_SMALL)
+  {
+    return arena_alloc_large(arena, size);
+  }
+  size_t size_class = arena_size_class(size);
+  // reuse a freed block of the same class first
+  void *block = arena->free_lists[size_class];
+  if (block != NULL)
+  {
+    arena->free_lists[size_class] = *(void **)block;
+    return block;
+  }
+  size_t rounded = (size_class + 1) * ARENA_ALIGN;
+  ArenaChunk *chunk = arena->chunks;
+  // start a new chunk when the newest one is full
+  if (chunk == NULL || chunk->used + rounded > chunk->size)
+  {
+    chunk = malloc(ARENA_CHUNK_HEADER + arena->chunk_size);
+    chunk->size = arena->chunk_size;
+    chunk->used = 0;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+  }
+  block = (char *)chunk + ARENA_CHUNK_HEADER + chunk->used;
+  chunk->used += rounded;
+  return block;
+}
+
+/*
+  size has to be the size the block was allocated with.
+ */
+void arena_free(Arena *arena, void *ptr, size_t size)
+{
+  if (ptr == NULL)
+  {
+    return;
+  }
+  if (size > ARENA_MAX_SMALL)
+  {
+    ArenaLarge *block = (ArenaLarge *)((char *)ptr - ARENA_LARGE_HEADER);
+    if (block->prev != NULL)
+    {
+      block->prev->next = block->next;
+    }
+    else
+    {
+      arena->large = block->next;
+    }
+    if (block->next != NULL)
+    {
+      block->next->prev = block->prev;
+    }
+    free(block);
+    return;
+  }
+  // the first word of a free block links it to the rest of its free list
+  size_t size_class = arena_size_class(size);
+  *(void **)ptr = arena->free_lists[size_class];
+  arena->free_lists[size_class] = ptr;
+}
+
+/*
+  Release every block of the arena at once.
+ */
+void destroy_arena(Arena *arena)
+{
+  while (arena->chunks != NULL)
+  {
+    ArenaChunk *next = arena->chunks->next;
+    free(arena->chunks);
+    arena->chunks = next;
+  }
+  while (arena->large != NULL)
+  {
+    ArenaLarge *next = arena->large->next;
+    free(arena->large);
+    arena->large = next;
+  }
+  free(arena);
+}
+
+static void *malloc_allocator_alloc(void *ctx, size_t size)
+{
+  (void)ctx;
+  return malloc(size);
+}
+
+static void malloc_allocator_free(void *ctx, void *ptr, size_t size)
+{
+  (void)ctx;
+  (void)size;
+  free(ptr);
+}
+
+static void *arena_allocator_alloc(void *ctx, size_t size)
+{
+  return arena_alloc(ctx, size);
+}
+
+static void arena_allocator_free(void *ctx, void *ptr, size_t size)
+{
+  arena_free(ctx, ptr, size);
+}
+
+static void arena_allocator_destroy(void *ctx)
+{
+  destroy_arena(ctx);
+}
+
+/*
+  Plain malloc/free. It has no destroy, so every block it handed out has
+  to be freed on its own.
+ */
+Allocator malloc_allocator(void)
+{
+  Allocator allocator = {malloc_allocator_alloc, malloc_allocator_free, NULL, NULL};
+  return allocator;
+}
+
+/*
+  A new arena of its own. destroy releases every block in one go.
+ */
+Allocator arena_allocator(void)
+{
+  Allocator allocator = {arena_allocator_alloc, arena_allocator_free, arena_allocator_destroy, create_arena(ARENA_CHUNK_SIZE)};
+  return allocator;
+}
@@ -0,0 +1,50 @@
+#ifndef arena_h
+#define arena_h
+
+#include <stddef.h>
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGN 16
+#define ARENA_MAX_SMALL 512
+#define ARENA_SIZE_CLASSES (ARENA_MAX_SMALL / ARENA_ALIGN)
+
+typedef struct ArenaChunk {
+  struct ArenaChunk *next;
+  size_t size;
+  size_t used;
+} ArenaChunk;
+
+typedef struct ArenaLarge {
+  struct ArenaLarge *prev;
+  struct ArenaLarge *next;
+} ArenaLarge;
+
+typedef struct Arena {
+  size_t chunk_size;
+  ArenaChunk *chunks;
+  ArenaLarge *large;
+  void *free_lists[ARENA_SIZE_CLASSES];
+} Arena;
+
+typedef struct Allocator {
+  void *(*alloc)(void *ctx, size_t size);
+  void (*free)(void *ctx, void *ptr, size_t size);
+  void (*destroy)(void *ctx);
+  void *ctx;
+} Allocator;
+
+
+Arena *create_arena(size_t chunk_size);
+
+void *arena_alloc(Arena *arena, size_t size);
+
+void arena_free(Arena *arena, void *ptr, size_t size);
+
+void destroy_arena(Arena *arena);
+
+Allocator malloc_allocator(void);
+
+Allocator arena_allocator(void);
+
+
+#endif
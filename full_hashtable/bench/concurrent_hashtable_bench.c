@@ -0,0 +1,38 @@
+#include <concurrent_hashtable.h>
+#include "../utils/bench.h"
+
+// one thread: the cost of the stripe locks without contention
+#define BENCH_STRIPES 16
+
+static char bench_value[64];
+
+static void *bench_create(int capacity)
+{
+    return create_concurrent_hash_table(capacity, BENCH_STRIPES);
+}
+
+static void bench_insert(void *table, char *key, char *value)
+{
+    concurrent_hash_table_insert(table, key, value);
+}
+
+static char *bench_retrieve(void *table, char *key)
+{
+    return concurrent_hash_table_retrieve(table, key, bench_value, sizeof(bench_value)) >= 0 ? bench_value : NULL;
+}
+
+static void bench_remove(void *table, char *key)
+{
+    concurrent_hash_table_remove(table, key);
+}
+
+static void bench_destroy(void *table)
+{
+    destroy_concurrent_hash_table(table);
+}
+
+int main(int argc, char *argv[])
+{
+    BenchEngine engine = {"concurrent", 1, bench_create, bench_insert, bench_retrieve, bench_remove, bench_destroy, NULL};
+    return bench_main(argc, argv, &engine);
+}
@@ -0,0 +1,58 @@
+#include <frozen_hashtable.h>
+#include "../utils/bench.h"
+
+/*
+  The preload goes into a HashTable, which is frozen before the lookups
+  start and then dropped.
+ */
+typedef struct BenchFrozen {
+    HashTable *ht;
+    FrozenHashTable *fht;
+} BenchFrozen;
+
+static void *bench_create(int capacity)
+{
+    BenchFrozen *bench = calloc(1, sizeof(BenchFrozen));
+    bench->ht = create_hash_table(capacity);
+    return bench;
+}
+
+static void bench_insert(void *table, char *key, char *value)
+{
+    BenchFrozen *bench = table;
+    hash_table_insert(bench->ht, key, value);
+}
+
+static void bench_seal(void *table)
+{
+    BenchFrozen *bench = table;
+    bench->fht = hash_table_freeze(bench->ht);
+    destroy_hash_table(bench->ht);
+    bench->ht = NULL;
+}
+
+static char *bench_retrieve(void *table, char *key)
+{
+    BenchFrozen *bench = table;
+    return bench->fht != NULL ? frozen_hash_table_retrieve(bench->fht, key) : NULL;
+}
+
+static void bench_destroy(void *table)
+{
+    BenchFrozen *bench = table;
+    if (bench->ht != NULL)
+    {
+        destroy_hash_table(bench->ht);
+    }
+    if (bench->fht != NULL)
+    {
+        destroy_frozen_hash_table(bench->fht);
+    }
+    free(bench);
+}
+
+int main(int argc, char *argv[])
+{
+    BenchEngine engine = {"frozen", 0, bench_create, bench_insert, bench_retrieve, NULL, bench_destroy, bench_seal};
+    return bench_main(argc, argv, &engine);
+}
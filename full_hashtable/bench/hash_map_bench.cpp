@@ -0,0 +1,38 @@
+#include <hash_map.hpp>
+#include <string>
+#include "../utils/bench.h"
+
+using Map = hashtables::HashMap<std::string, std::string>;
+
+static void *bench_create(int capacity)
+{
+    return new Map(capacity);
+}
+
+static void bench_insert(void *table, char *key, char *value)
+{
+    static_cast<Map *>(table)->insert(key, value);
+}
+
+static char *bench_retrieve(void *table, char *key)
+{
+    // transparent lookup, the key is not copied into a std::string
+    std::string *value = static_cast<Map *>(table)->find(std::string_view(key));
+    return value != nullptr ? value->data() : nullptr;
+}
+
+static void bench_remove(void *table, char *key)
+{
+    static_cast<Map *>(table)->remove(std::string_view(key));
+}
+
+static void bench_destroy(void *table)
+{
+    delete static_cast<Map *>(table);
+}
+
+int main(int argc, char *argv[])
+{
+    BenchEngine engine = {"hash_map", 1, bench_create, bench_insert, bench_retrieve, bench_remove, bench_destroy, nullptr};
+    return bench_main(argc, argv, &engine);
+}
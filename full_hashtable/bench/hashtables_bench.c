@@ -0,0 +1,33 @@
+#include <hashtables.h>
+#include "../utils/bench.h"
+
+static void *bench_create(int capacity)
+{
+    return create_hash_table(capacity);
+}
+
+static void bench_insert(void *table, char *key, char *value)
+{
+    hash_table_insert(table, key, value);
+}
+
+static char *bench_retrieve(void *table, char *key)
+{
+    return hash_table_retrieve(table, key);
+}
+
+static void bench_remove(void *table, char *key)
+{
+    hash_table_remove(table, key);
+}
+
+static void bench_destroy(void *table)
+{
+    destroy_hash_table(table);
+}
+
+int main(int argc, char *argv[])
+{
+    BenchEngine engine = {"hash_table", 1, bench_create, bench_insert, bench_retrieve, bench_remove, bench_destroy, NULL};
+    return bench_main(argc, argv, &engine);
+}
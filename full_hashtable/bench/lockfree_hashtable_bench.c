@@ -0,0 +1,35 @@
+#include <lockfree_hashtable.h>
+#include "../utils/bench.h"
+
+static char bench_value[64];
+
+static void *bench_create(int capacity)
+{
+    return create_lockfree_hash_table(capacity);
+}
+
+static void bench_insert(void *table, char *key, char *value)
+{
+    lockfree_hash_table_insert(table, key, value);
+}
+
+static char *bench_retrieve(void *table, char *key)
+{
+    return lockfree_hash_table_retrieve(table, key, bench_value, sizeof(bench_value)) >= 0 ? bench_value : NULL;
+}
+
+static void bench_remove(void *table, char *key)
+{
+    lockfree_hash_table_remove(table, key);
+}
+
+static void bench_destroy(void *table)
+{
+    destroy_lockfree_hash_table(table);
+}
+
+int main(int argc, char *argv[])
+{
+    BenchEngine engine = {"lockfree", 1, bench_create, bench_insert, bench_retrieve, bench_remove, bench_destroy, NULL};
+    return bench_main(argc, argv, &engine);
+}
@@ -0,0 +1,70 @@
+#include <snapshot.h>
+#include "../utils/bench.h"
+
+/*
+  The preload goes into a HashTable, which is saved to a temporary file
+  and mapped back before the lookups start. The file is unlinked right
+  away, the mapping keeps it alive.
+ */
+typedef struct BenchMapped {
+    HashTable *ht;
+    MappedHashTable *mht;
+} BenchMapped;
+
+static void *bench_create(int capacity)
+{
+    BenchMapped *bench = calloc(1, sizeof(BenchMapped));
+    bench->ht = create_hash_table(capacity);
+    return bench;
+}
+
+static void bench_insert(void *table, char *key, char *value)
+{
+    BenchMapped *bench = table;
+    hash_table_insert(bench->ht, key, value);
+}
+
+static void bench_seal(void *table)
+{
+    BenchMapped *bench = table;
+    char path[] = "/tmp/mapped_bench_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        return;
+    }
+    close(fd);
+    if (hash_table_save(bench->ht, path) == 0)
+    {
+        bench->mht = hash_table_open_mapped(path);
+    }
+    unlink(path);
+    destroy_hash_table(bench->ht);
+    bench->ht = NULL;
+}
+
+static char *bench_retrieve(void *table, char *key)
+{
+    BenchMapped *bench = table;
+    return bench->mht != NULL ? mapped_hash_table_retrieve(bench->mht, key) : NULL;
+}
+
+static void bench_destroy(void *table)
+{
+    BenchMapped *bench = table;
+    if (bench->ht != NULL)
+    {
+        destroy_hash_table(bench->ht);
+    }
+    if (bench->mht != NULL)
+    {
+        destroy_mapped_hash_table(bench->mht);
+    }
+    free(bench);
+}
+
+int main(int argc, char *argv[])
+{
+    BenchEngine engine = {"mapped", 0, bench_create, bench_insert, bench_retrieve, NULL, bench_destroy, bench_seal};
+    return bench_main(argc, argv, &engine);
+}
@@ -0,0 +1,33 @@
+#include <robin_hood.h>
+#include "../utils/bench.h"
+
+static void *bench_create(int capacity)
+{
+    return create_rh_table(capacity);
+}
+
+static void bench_insert(void *table, char *key, char *value)
+{
+    rh_table_insert(table, key, value);
+}
+
+static char *bench_retrieve(void *table, char *key)
+{
+    return rh_table_retrieve(table, key);
+}
+
+static void bench_remove(void *table, char *key)
+{
+    rh_table_remove(table, key);
+}
+
+static void bench_destroy(void *table)
+{
+    destroy_rh_table(table);
+}
+
+int main(int argc, char *argv[])
+{
+    BenchEngine engine = {"robin_hood", 1, bench_create, bench_insert, bench_retrieve, bench_remove, bench_destroy, NULL};
+    return bench_main(argc, argv, &engine);
+}
@@ -0,0 +1,38 @@
+#include <sharded_hashtable.h>
+#include "../utils/bench.h"
+
+#define BENCH_SHARDS 16
+
+static char bench_value[64];
+
+static void *bench_create(int capacity)
+{
+    int shard_capacity = capacity / BENCH_SHARDS;
+    return create_sharded_hash_table(BENCH_SHARDS, shard_capacity > 8 ? shard_capacity : 8);
+}
+
+static void bench_insert(void *table, char *key, char *value)
+{
+    sharded_hash_table_insert(table, key, value);
+}
+
+static char *bench_retrieve(void *table, char *key)
+{
+    return sharded_hash_table_retrieve(table, key, bench_value, sizeof(bench_value)) >= 0 ? bench_value : NULL;
+}
+
+static void bench_remove(void *table, char *key)
+{
+    sharded_hash_table_remove(table, key);
+}
+
+static void bench_destroy(void *table)
+{
+    destroy_sharded_hash_table(table);
+}
+
+int main(int argc, char *argv[])
+{
+    BenchEngine engine = {"sharded", 1, bench_create, bench_insert, bench_retrieve, bench_remove, bench_destroy, NULL};
+    return bench_main(argc, argv, &engine);
+}
@@ -0,0 +1,33 @@
+#include <swiss_table.h>
+#include "../utils/bench.h"
+
+static void *bench_create(int capacity)
+{
+    return create_swiss_table(capacity);
+}
+
+static void bench_insert(void *table, char *key, char *value)
+{
+    swiss_table_insert(table, key, value);
+}
+
+static char *bench_retrieve(void *table, char *key)
+{
+    return swiss_table_retrieve(table, key);
+}
+
+static void bench_remove(void *table, char *key)
+{
+    swiss_table_remove(table, key);
+}
+
+static void bench_destroy(void *table)
+{
+    destroy_swiss_table(table);
+}
+
+int main(int argc, char *argv[])
+{
+    BenchEngine engine = {"swiss_table", 1, bench_create, bench_insert, bench_retrieve, bench_remove, bench_destroy, NULL};
+    return bench_main(argc, argv, &engine);
+}
@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "concurrent_hashtable.h"
+
+/*
+  Thread safe chained hash table with lock striping.
+
+  Buckets are guarded by `stripe_count` reader/writer locks, bucket i by
+  stripe i % stripe_count. Capacity and stripe count are both powers of
+  two with stripe_count <= capacity, so a key's stripe only depends on
+  the low bits of its hash and stays the same across resizes.
+
+  Retrieves take their stripe for reading and inserts and removes take it
+  for writing, so operations on different stripes never wait for each
+  other. A resize takes every stripe for writing, always in ascending
+  order, so two threads resizing at once cannot deadlock, and holding
+  any one stripe is enough to keep `capacity` and `storage` stable.
+ */
+
+#define CONCURRENT_HASH_TABLE_MAX_LOAD 0.7
+
+static int concurrent_round_pow2(int n)
+{
+  int rounded = 1;
+  while (rounded < n)
+  {
+    rounded <<= 1;
+  }
+  return rounded;
+}
+
+static ConcurrentStripe *concurrent_stripe(ConcurrentHashTable *cht, uint64_t keyHash)
+{
+  return &cht->stripes[keyHash & (uint64_t)(cht->stripe_count - 1)];
+}
+
+static LinkedPair **concurrent_bucket(ConcurrentHashTable *cht, uint64_t keyHash)
+{
+  return &cht->storage[keyHash & (uint64_t)(cht->capacity - 1)];
+}
+
+static LinkedPair *concurrent_create_pair(char *key, size_t key_len, char *value, uint64_t keyHash)
+{
+  // zeroed: no timer, no inline bytes, nothing for shared LinkedPair code to misread
+  LinkedPair *pair = calloc(1, sizeof(LinkedPair));
+  pair->key = strdup(key);
+  pair->key_len = key_len;
+  pair->value = strdup(value);
+  pair->value_len = strlen(value);
+  pair->hash = keyHash;
+  pair->next = NULL;
+  return pair;
+}
+
+static void concurrent_destroy_pair(LinkedPair *pair)
+{
+  free(pair->key);
+  free(pair->value);
+  free(pair);
+}
+
+/*
+  Walk a chain for key, comparing the cached hash and length before the bytes.
+ */
+static LinkedPair **concurrent_find(LinkedPair **bucket, uint64_t keyHash, char *key, size_t key_len)
+{
+  LinkedPair **link = bucket;
+  while (*link != NULL && ((*link)->hash != keyHash || (*link)->key_len != key_len || memcmp((*link)->key, key, key_len) != 0))
+  {
+    link = &(*link)->next;
+  }
+  return link;
+}
+
+/*
+  Take every stripe for writing, in ascending order.
+ */
+static void concurrent_lock_all(ConcurrentHashTable *cht)
+{
+  for (int i = 0; i < cht->stripe_count; i++)
+  {
+    pthread_rwlock_wrlock(&cht->stripes[i].lock);
+  }
+}
+
+static void concurrent_unlock_all(ConcurrentHashTable *cht)
+{
+  for (int i = cht->stripe_count - 1; i >= 0; i--)
+  {
+    pthread_rwlock_unlock(&cht->stripes[i].lock);
+  }
+}
+
+/*
+  Total number of pairs, summed over the stripes without taking them, so
+  only exact while no other thread is writing.
+ */
+int concurrent_hash_table_count(ConcurrentHashTable *cht)
+{
+  int count = 0;
+  for (int i = 0; i < cht->stripe_count; i++)
+  {
+    count += atomic_load_explicit(&cht->stripes[i].count, memory_order_relaxed);
+  }
+  return count;
+}
+
+/*
+  Double the bucket array with every stripe held. When only_if_full is
+  set, another thread may have grown the table while we waited for the
+  stripes, so the load is checked again first.
+ */
+static void concurrent_grow(ConcurrentHashTable *cht, int only_if_full)
+{
+  concurrent_lock_all(cht);
+  if (!only_if_full || concurrent_hash_table_count(cht) > cht->capacity * cht->max_load)
+  {
+    int new_capacity = cht->capacity * 2;
+    LinkedPair **new_storage = calloc(new_capacity, sizeof(LinkedPair *));
+    for (int i = 0; i < cht->capacity; i++)
+    {
+      LinkedPair *current_pair = cht->storage[i];
+      while (current_pair != NULL)
+      {
+        LinkedPair *next_pair = current_pair->next;
+        LinkedPair **bucket = &new_storage[current_pair->hash & (uint64_t)(new_capacity - 1)];
+        current_pair->next = *bucket;
+        *bucket = current_pair;
+        current_pair = next_pair;
+      }
+    }
+    free(cht->storage);
+    cht->storage = new_storage;
+    cht->capacity = new_capacity;
+  }
+  concurrent_unlock_all(cht);
+}
+
+/*
+  stripe_count is rounded up to a power of two and capped at capacity.
+ */
+ConcurrentHashTable *create_concurrent_hash_table(int capacity, int stripe_count)
+{
+  ConcurrentHashTable *cht = malloc(sizeof(ConcurrentHashTable));
+  cht->capacity = concurrent_round_pow2(capacity);
+  cht->storage = calloc(cht->capacity, sizeof(LinkedPair *));
+  cht->max_load = CONCURRENT_HASH_TABLE_MAX_LOAD;
+  cht->stripe_count = concurrent_round_pow2(stripe_count);
+  if (cht->stripe_count > cht->capacity)
+  {
+    cht->stripe_count = cht->capacity;
+  }
+  // each stripe sits on its own cache line, so stripes do not false share
+  cht->stripes = aligned_alloc(_Alignof(ConcurrentStripe), cht->stripe_count * sizeof(ConcurrentStripe));
+  for (int i = 0; i < cht->stripe_count; i++)
+  {
+    pthread_rwlock_init(&cht->stripes[i].lock, NULL);
+    atomic_init(&cht->stripes[i].count, 0);
+  }
+  cht->hash_function = hash_djb2;
+  cht->seed = 0;
+  return cht;
+}
+
+/*
+  Inserting an existing key overwrites its value. The table grows once
+  it passes its max load, after the stripe has been released.
+ */
+void concurrent_hash_table_insert(ConcurrentHashTable *cht, char *key, char *value)
+{
+  size_t key_len = strlen(key);
+  uint64_t keyHash = cht->hash_function(key, key_len, cht->seed);
+  ConcurrentStripe *stripe = concurrent_stripe(cht, keyHash);
+  int grow = 0;
+  pthread_rwlock_wrlock(&stripe->lock);
+  LinkedPair **link = concurrent_find(concurrent_bucket(cht, keyHash), keyHash, key, key_len);
+  if (*link != NULL)
+  {
+    // existing key, swap in a copy of the new value
+    free((*link)->value);
+    (*link)->value = strdup(value);
+    (*link)->value_len = strlen(value);
+  }
+  else
+  {
+    // new keys go to the end of the chain, link already points there
+    *link = concurrent_create_pair(key, key_len, value, keyHash);
+    int count = atomic_fetch_add_explicit(&stripe->count, 1, memory_order_relaxed) + 1;
+    // capacity cannot change while we hold a stripe. Keys spread evenly
+    // over the stripes, so only one past its share sums up the others
+    double max_count = cht->capacity * cht->max_load;
+    grow = count > max_count / cht->stripe_count && concurrent_hash_table_count(cht) > max_count;
+  }
+  pthread_rwlock_unlock(&stripe->lock);
+  if (grow)
+  {
+    concurrent_grow(cht, 1);
+  }
+}
+
+void concurrent_hash_table_remove(ConcurrentHashTable *cht, char *key)
+{
+  size_t key_len = strlen(key);
+  uint64_t keyHash = cht->hash_function(key, key_len, cht->seed);
+  ConcurrentStripe *stripe = concurrent_stripe(cht, keyHash);
+  pthread_rwlock_wrlock(&stripe->lock);
+  LinkedPair **link = concurrent_find(concurrent_bucket(cht, keyHash), keyHash, key, key_len);
+  if (*link != NULL)
+  {
+    LinkedPair *found = *link;
+    *link = found->next;
+    concurrent_destroy_pair(found);
+    atomic_fetch_sub_explicit(&stripe->count, 1, memory_order_relaxed);
+  }
+  pthread_rwlock_unlock(&stripe->lock);
+}
+
+/*
+  Another thread may remove or overwrite the pair as soon as the stripe
+  is released, so the value is copied out into the caller's buffer of
+  size bytes (always NUL terminated when size > 0) instead of returned.
+
+  Returns the length of the value, which is larger than size - 1 when it
+  was cut short, or -1 if the key is not found.
+ */
+long concurrent_hash_table_retrieve(ConcurrentHashTable *cht, char *key, char *value, size_t size)
+{
+  size_t key_len = strlen(key);
+  uint64_t keyHash = cht->hash_function(key, key_len, cht->seed);
+  ConcurrentStripe *stripe = concurrent_stripe(cht, keyHash);
+  long value_len = -1;
+  pthread_rwlock_rdlock(&stripe->lock);
+  LinkedPair *found = *concurrent_find(concurrent_bucket(cht, keyHash), keyHash, key, key_len);
+  if (found != NULL)
+  {
+    value_len = (long)found->value_len;
+    if (size > 0)
+    {
+      size_t copied = found->value_len < size - 1 ? found->value_len : size - 1;
+      memcpy(value, found->value, copied);
+      value[copied] = '\0';
+    }
+  }
+  pthread_rwlock_unlock(&stripe->lock);
+  return value_len;
+}
+
+/*
+  No other thread may still be using the table.
+ */
+void destroy_concurrent_hash_table(ConcurrentHashTable *cht)
+{
+  for (int i = 0; i < cht->capacity; i++)
+  {
+    LinkedPair *current_pair = cht->storage[i];
+    while (current_pair != NULL)
+    {
+      LinkedPair *next_pair = current_pair->next;
+      concurrent_destroy_pair(current_pair);
+      current_pair = next_pair;
+    }
+  }
+  for (int i = 0; i < cht->stripe_count; i++)
+  {
+    pthread_rwlock_destroy(&cht->stripes[i].lock);
+  }
+  free(cht->stripes);
+  free(cht->storage);
+  free(cht);
+}
+
+/*
+  Double the capacity. Safe to call while other threads use the table.
+ */
+void concurrent_hash_table_resize(ConcurrentHashTable *cht)
+{
+  concurrent_grow(cht, 0);
+}
@@ -0,0 +1,46 @@
+#ifndef concurrent_hashtable_h
+#define concurrent_hashtable_h
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "hashtables.h"
+
+/*
+  `count` is the number of pairs in the stripe's buckets. It changes with
+  the stripe held for writing, and shares the lock's cache line, so
+  writers on different stripes never touch the same counter.
+ */
+typedef struct ConcurrentStripe {
+  _Alignas(64) pthread_rwlock_t lock;
+  atomic_int count;
+} ConcurrentStripe;
+
+typedef struct ConcurrentHashTable {
+  int capacity;
+  LinkedPair **storage;
+  double max_load;
+  int stripe_count;
+  ConcurrentStripe *stripes;
+  HashFunction hash_function;
+  uint64_t seed;
+} ConcurrentHashTable;
+
+
+ConcurrentHashTable *create_concurrent_hash_table(int capacity, int stripe_count);
+
+void concurrent_hash_table_insert(ConcurrentHashTable *cht, char *key, char *value);
+
+void concurrent_hash_table_remove(ConcurrentHashTable *cht, char *key);
+
+long concurrent_hash_table_retrieve(ConcurrentHashTable *cht, char *key, char *value, size_t size);
+
+void destroy_concurrent_hash_table(ConcurrentHashTable *cht);
+
+void concurrent_hash_table_resize(ConcurrentHashTable *cht);
+
+int concurrent_hash_table_count(ConcurrentHashTable *cht);
+
+
+#endif
@@ -0,0 +1,703 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "durable_hashtable.h"
+#include "snapshot.h"
+#include "../utils/dbg.h"
+
+/*
+  HashTable whose inserts and removes survive a crash.
+
+  Every mutation is applied to the table and appended to a write-ahead
+  log under one lock, so the log holds them in the order they were
+  applied. The caller then waits until its record is on disk.
+
+  A mutation is visible to retrieves from the moment it is applied, not
+  from when it is durable, and it is not rolled back if the log write
+  fails: later writers may already have built on it. Instead the table
+  fails, every insert and remove from then on returns -1, and reopening
+  the directory recovers exactly what reached the disk.
+
+  Waiting writers share fsyncs (group commit): the first writer to find
+  no flush running takes every record appended so far, writes and syncs
+  them with the lock released, and wakes everyone those records covered.
+  Writers that arrive meanwhile append behind it and are covered by the
+  next flush, so under load one fsync commits many mutations.
+
+  The directory holds snapshots (see snapshot.h) and log segments:
+
+    snapshot.N  the table after replaying every segment below N
+    wal.N       log records written while generation N was current
+
+  On open the newest snapshot is loaded and every segment from its
+  generation on is replayed, stopping at the first torn or corrupt
+  record. Compaction runs on its own thread: the current segment is
+  closed and a new one started, then the old snapshot and closed
+  segments are folded into a new snapshot and deleted. Writers keep
+  going the whole time, they only ever touch the newest segment.
+
+  Records are a type byte, the key length and (for inserts) the value
+  length as varints, the key and value bytes, and a 32 bit checksum of
+  all of that.
+ */
+
+#define DURABLE_RECORD_INSERT 'I'
+#define DURABLE_RECORD_REMOVE 'R'
+
+// segment size that starts a background compaction
+#define DURABLE_COMPACT_BYTES (64 * 1024 * 1024)
+
+#define DURABLE_CHECKSUM_SEED 0x77616c2d6c6f6721ULL
+
+typedef struct DurableCompaction {
+  DurableHashTable *dht;
+  uint64_t base;
+  uint64_t upto;
+  int has_previous;
+  pthread_t previous;
+} DurableCompaction;
+
+static char *durable_path(const char *dir, const char *name, uint64_t generation)
+{
+  char *path = malloc(strlen(dir) + strlen(name) + 24);
+  sprintf(path, "%s/%s.%llu", dir, name, (unsigned long long)generation);
+  return path;
+}
+
+static int durable_file_exists(const char *path)
+{
+  return access(path, F_OK) == 0;
+}
+
+/*
+  Renames, creates and unlinks only last once the directory is synced.
+ */
+static int durable_sync_dir(const char *dir)
+{
+  int fd = open(dir, O_RDONLY);
+  if (fd < 0)
+  {
+    return -1;
+  }
+  int rc = fsync(fd);
+  close(fd);
+  return rc;
+}
+
+static size_t durable_put_varint(char *out, uint64_t value)
+{
+  size_t n = 0;
+  while (value >= 0x80)
+  {
+    out[n++] = (char)(value | 0x80);
+    value >>= 7;
+  }
+  out[n++] = (char)value;
+  return n;
+}
+
+/*
+  Returns the number of bytes read, or 0 if the varint runs past end.
+ */
+static size_t durable_get_varint(const char *bytes, const char *end, uint64_t *value)
+{
+  *value = 0;
+  for (size_t n = 0; n < 10 && bytes + n < end; n++)
+  {
+    *value |= (uint64_t)(bytes[n] & 0x7f) << (7 * n);
+    if ((bytes[n] & 0x80) == 0)
+    {
+      return n + 1;
+    }
+  }
+  return 0;
+}
+
+static uint32_t durable_checksum(const char *bytes, size_t len)
+{
+  return (uint32_t)hash_wyhash(bytes, len, DURABLE_CHECKSUM_SEED);
+}
+
+/*
+  Append one record to the buffer, with the lock held.
+ */
+static void durable_append(DurableHashTable *dht, char type, const void *key, size_t key_len, const void *value, size_t value_len)
+{
+  DurableLogBuffer *buffer = &dht->buffer;
+  size_t needed = buffer->length + 1 + 20 + key_len + value_len + sizeof(uint32_t);
+  if (needed > buffer->capacity)
+  {
+    buffer->capacity = needed > 2 * buffer->capacity ? needed : 2 * buffer->capacity;
+    buffer->bytes = realloc(buffer->bytes, buffer->capacity);
+  }
+  char *record = buffer->bytes + buffer->length;
+  size_t n = 0;
+  record[n++] = type;
+  n += durable_put_varint(record + n, key_len);
+  if (type == DURABLE_RECORD_INSERT)
+  {
+    n += durable_put_varint(record + n, value_len);
+  }
+  memcpy(record + n, key, key_len);
+  n += key_len;
+  if (type == DURABLE_RECORD_INSERT)
+  {
+    memcpy(record + n, value, value_len);
+    n += value_len;
+  }
+  uint32_t checksum = durable_checksum(record, n);
+  memcpy(record + n, &checksum, sizeof(checksum));
+  n += sizeof(checksum);
+  buffer->length += n;
+  dht->appended_lsn += n;
+  dht->segment_bytes += n;
+}
+
+static int durable_write_all(int fd, const char *bytes, size_t len)
+{
+  while (len > 0)
+  {
+    ssize_t written = write(fd, bytes, len);
+    if (written < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (written <= 0)
+    {
+      return -1;
+    }
+    bytes += written;
+    len -= written;
+  }
+  return 0;
+}
+
+/*
+  Wait, with the lock held, until the log is on disk up to lsn, leading
+  a flush when none is running. Returns 0, or -1 once the log has failed.
+ */
+static int durable_wait(DurableHashTable *dht, uint64_t lsn)
+{
+  while (dht->durable_lsn < lsn && !dht->failed)
+  {
+    if (dht->flushing)
+    {
+      pthread_cond_wait(&dht->synced, &dht->lock);
+      continue;
+    }
+    // take everything appended so far, later writers append to the other buffer
+    DurableLogBuffer flushed = dht->buffer;
+    dht->buffer = dht->flush_buffer;
+    dht->buffer.length = 0;
+    uint64_t target = dht->appended_lsn;
+    int fd = dht->log_fd;
+    dht->flushing = 1;
+    pthread_mutex_unlock(&dht->lock);
+
+    int rc = durable_write_all(fd, flushed.bytes, flushed.length);
+    if (rc == 0)
+    {
+      rc = fdatasync(fd);
+    }
+
+    pthread_mutex_lock(&dht->lock);
+    dht->flush_buffer = flushed;
+    dht->flushing = 0;
+    dht->syncs++;
+    if (rc == 0)
+    {
+      dht->durable_lsn = target;
+    }
+    else
+    {
+      log_err("Could not write the log in %s.", dht->dir);
+      dht->failed = 1;
+    }
+    pthread_cond_broadcast(&dht->synced);
+  }
+  return dht->failed ? -1 : 0;
+}
+
+static int durable_open_segment(DurableHashTable *dht)
+{
+  char *path = durable_path(dht->dir, "wal", dht->generation);
+  dht->log_fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+  free(path);
+  if (dht->log_fd < 0 || durable_sync_dir(dht->dir) != 0)
+  {
+    return -1;
+  }
+  dht->segment_bytes = 0;
+  return 0;
+}
+
+/*
+  With the lock held: put everything appended so far on disk, then close
+  the current segment and start the next generation. A flush leader
+  writes to the fd it took with the lock dropped, so the segment is only
+  closed once no flush is running and nothing is left to flush.
+ */
+static int durable_rotate(DurableHashTable *dht)
+{
+  while (dht->flushing || dht->durable_lsn < dht->appended_lsn)
+  {
+    if (durable_wait(dht, dht->appended_lsn) != 0)
+    {
+      return -1;
+    }
+    if (dht->flushing)
+    {
+      pthread_cond_wait(&dht->synced, &dht->lock);
+    }
+  }
+  if (dht->failed)
+  {
+    return -1;
+  }
+  close(dht->log_fd);
+  dht->generation++;
+  if (durable_open_segment(dht) != 0)
+  {
+    dht->failed = 1;
+    return -1;
+  }
+  return 0;
+}
+
+/*
+  Apply the records of one segment to ht. A missing segment is empty.
+  Replay stops at the first record that is cut short or fails its
+  checksum: that is where a crash interrupted the last write.
+ */
+static void durable_replay(HashTable *ht, const char *path)
+{
+  FILE *file = fopen(path, "rb");
+  if (file == NULL)
+  {
+    return;
+  }
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  char *bytes = malloc(size > 0 ? size : 1);
+  size = (long)fread(bytes, 1, size, file);
+  fclose(file);
+
+  const char *end = bytes + size;
+  const char *record = bytes;
+  while (record < end)
+  {
+    const char *p = record + 1;
+    char type = record[0];
+    uint64_t key_len = 0, value_len = 0;
+    size_t n;
+    if (type != DURABLE_RECORD_INSERT && type != DURABLE_RECORD_REMOVE)
+    {
+      break;
+    }
+    if ((n = durable_get_varint(p, end, &key_len)) == 0)
+    {
+      break;
+    }
+    p += n;
+    if (type == DURABLE_RECORD_INSERT)
+    {
+      if ((n = durable_get_varint(p, end, &value_len)) == 0)
+      {
+        break;
+      }
+      p += n;
+    }
+    if (key_len > (uint64_t)(end - p) || value_len > (uint64_t)(end - p) - key_len ||
+        (uint64_t)(end - p) - key_len - value_len < sizeof(uint32_t))
+    {
+      break;
+    }
+    uint32_t checksum;
+    memcpy(&checksum, p + key_len + value_len, sizeof(checksum));
+    if (checksum != durable_checksum(record, p + key_len + value_len - record))
+    {
+      break;
+    }
+    if (type == DURABLE_RECORD_INSERT)
+    {
+      hash_table_insert_bytes(ht, p, key_len, p + key_len, value_len);
+    }
+    else
+    {
+      hash_table_remove_bytes(ht, p, key_len);
+    }
+    record = p + key_len + value_len + sizeof(uint32_t);
+  }
+  free(bytes);
+}
+
+/*
+  Load snapshot.base, or an empty table when there is none yet.
+ */
+static HashTable *durable_load_base(const char *dir, uint64_t base)
+{
+  char *path = durable_path(dir, "snapshot", base);
+  HashTable *ht = durable_file_exists(path) ? hash_table_load(path) : create_hash_table(8);
+  free(path);
+  return ht;
+}
+
+/*
+  Delete snapshots below keep_snapshot, segments below keep_wal and any
+  snapshot a crash left half written.
+ */
+static void durable_remove_stale(const char *dir, uint64_t keep_snapshot, uint64_t keep_wal)
+{
+  DIR *d = opendir(dir);
+  if (d == NULL)
+  {
+    return;
+  }
+  struct dirent *entry;
+  while ((entry = readdir(d)) != NULL)
+  {
+    unsigned long long generation;
+    int end = 0;
+    int stale = 0;
+    if (sscanf(entry->d_name, "snapshot.%llu%n", &generation, &end) == 1)
+    {
+      stale = entry->d_name[end] != '\0' || generation < keep_snapshot;
+    }
+    else if (sscanf(entry->d_name, "wal.%llu%n", &generation, &end) == 1)
+    {
+      stale = entry->d_name[end] == '\0' && generation < keep_wal;
+    }
+    if (stale)
+    {
+      char *path = malloc(strlen(dir) + strlen(entry->d_name) + 2);
+      sprintf(path, "%s/%s", dir, entry->d_name);
+      unlink(path);
+      free(path);
+    }
+  }
+  closedir(d);
+}
+
+/*
+  Fold snapshot.base and segments base up to upto - 1 into snapshot.upto.
+ */
+static void *durable_compact(void *arg)
+{
+  DurableCompaction *compaction = arg;
+  DurableHashTable *dht = compaction->dht;
+  char *path = NULL;
+  // the previous compaction is done with dht, it may still be freeing its own table
+  if (compaction->has_previous)
+  {
+    pthread_join(compaction->previous, NULL);
+  }
+  HashTable *ht = durable_load_base(dht->dir, compaction->base);
+  check(ht != NULL, "Could not load the snapshot for compaction in %s.", dht->dir);
+  for (uint64_t generation = compaction->base; generation < compaction->upto; generation++)
+  {
+    path = durable_path(dht->dir, "wal", generation);
+    durable_replay(ht, path);
+    free(path);
+  }
+  path = durable_path(dht->dir, "snapshot", compaction->upto);
+  check(hash_table_save(ht, path) == 0, "Could not save %s.", path);
+  check(durable_sync_dir(dht->dir) == 0, "Could not sync %s.", dht->dir);
+  // the new snapshot is durable, everything it replaces can go
+  durable_remove_stale(dht->dir, compaction->upto, compaction->upto);
+  durable_sync_dir(dht->dir);
+
+  pthread_mutex_lock(&dht->lock);
+  dht->base_generation = compaction->upto;
+  dht->compacting = 0;
+  pthread_mutex_unlock(&dht->lock);
+  free(path);
+  destroy_hash_table(ht);
+  free(compaction);
+  return NULL;
+
+error:
+  // the old snapshot and segments are still in place, nothing is lost
+  pthread_mutex_lock(&dht->lock);
+  dht->compacting = 0;
+  pthread_mutex_unlock(&dht->lock);
+  free(path);
+  if (ht != NULL)
+  {
+    destroy_hash_table(ht);
+  }
+  free(compaction);
+  return NULL;
+}
+
+/*
+  With the lock held and every segment below the current one closed,
+  start folding them into a snapshot in the background. The previous
+  compaction thread is joined by the new one rather than here, so a
+  writer never waits on it with the lock held; joining the newest
+  thread joins them all.
+ */
+static void durable_spawn_compaction(DurableHashTable *dht)
+{
+  DurableCompaction *compaction = malloc(sizeof(DurableCompaction));
+  *compaction = (DurableCompaction){dht, dht->base_generation, dht->generation, dht->compaction_started, dht->compaction_thread};
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, durable_compact, compaction) != 0)
+  {
+    // the segments stay as they are, the next compaction picks them up
+    log_err("Could not start a compaction in %s.", dht->dir);
+    dht->compacting = 0;
+    free(compaction);
+    return;
+  }
+  dht->compacting = 1;
+  dht->compaction_started = 1;
+  dht->compaction_thread = thread;
+}
+
+/*
+  Find the newest snapshot and newest segment in dir, -1 when none.
+ */
+static void durable_scan(const char *dir, long long *snapshot, long long *wal)
+{
+  *snapshot = -1;
+  *wal = -1;
+  DIR *d = opendir(dir);
+  if (d == NULL)
+  {
+    return;
+  }
+  struct dirent *entry;
+  while ((entry = readdir(d)) != NULL)
+  {
+    unsigned long long generation;
+    int end = 0;
+    if (sscanf(entry->d_name, "snapshot.%llu%n", &generation, &end) == 1 && entry->d_name[end] == '\0')
+    {
+      *snapshot = (long long)generation > *snapshot ? (long long)generation : *snapshot;
+    }
+    else if (sscanf(entry->d_name, "wal.%llu%n", &generation, &end) == 1 && entry->d_name[end] == '\0')
+    {
+      *wal = (long long)generation > *wal ? (long long)generation : *wal;
+    }
+  }
+  closedir(d);
+}
+
+/*
+  Open the durable table kept in dir, creating dir if needed, and
+  recover its contents from the newest snapshot and the segments after
+  it. If any segment was replayed, a compaction is started right away.
+
+  Returns NULL if the directory or its snapshot cannot be read.
+ */
+DurableHashTable *open_durable_hash_table(const char *dir)
+{
+  DurableHashTable *dht = NULL;
+  int synced = 0;
+  check(mkdir(dir, 0755) == 0 || errno == EEXIST, "Could not create %s.", dir);
+  long long snapshot, wal;
+  durable_scan(dir, &snapshot, &wal);
+  uint64_t base = snapshot < 0 ? 0 : (uint64_t)snapshot;
+
+  dht = calloc(1, sizeof(DurableHashTable));
+  dht->dir = strdup(dir);
+  dht->log_fd = -1;
+  dht->ht = durable_load_base(dir, base);
+  check(dht->ht != NULL, "Could not load the snapshot in %s.", dir);
+  for (long long generation = base; generation <= wal; generation++)
+  {
+    char *path = durable_path(dir, "wal", generation);
+    durable_replay(dht->ht, path);
+    free(path);
+  }
+  durable_remove_stale(dir, base, base);
+
+  pthread_mutex_init(&dht->lock, NULL);
+  pthread_cond_init(&dht->synced, NULL);
+  synced = 1;
+  dht->compact_bytes = DURABLE_COMPACT_BYTES;
+  dht->base_generation = base;
+  // never append to a segment that was replayed, it may end in a torn record
+  dht->generation = wal >= (long long)base ? (uint64_t)wal + 1 : base;
+  check(durable_open_segment(dht) == 0, "Could not open a log segment in %s.", dir);
+  if (dht->generation > base)
+  {
+    pthread_mutex_lock(&dht->lock);
+    durable_spawn_compaction(dht);
+    pthread_mutex_unlock(&dht->lock);
+  }
+  return dht;
+
+error:
+  if (dht != NULL)
+  {
+    if (dht->ht != NULL)
+    {
+      destroy_hash_table(dht->ht);
+    }
+    if (dht->log_fd >= 0)
+    {
+      close(dht->log_fd);
+    }
+    if (synced)
+    {
+      pthread_cond_destroy(&dht->synced);
+      pthread_mutex_destroy(&dht->lock);
+    }
+    free(dht->dir);
+    free(dht);
+  }
+  return NULL;
+}
+
+/*
+  With the lock held and no compaction running: close the current
+  segment and fold everything before it into a snapshot. Rotating
+  releases the lock while it flushes, so the compaction is claimed
+  first and no other writer starts a second one meanwhile.
+ */
+static int durable_start_compaction(DurableHashTable *dht)
+{
+  dht->compacting = 1;
+  if (durable_rotate(dht) != 0)
+  {
+    dht->compacting = 0;
+    return -1;
+  }
+  durable_spawn_compaction(dht);
+  return 0;
+}
+
+/*
+  With the lock held: start a compaction once the segment is big enough.
+ */
+static void durable_maybe_compact(DurableHashTable *dht)
+{
+  if (dht->segment_bytes >= dht->compact_bytes && !dht->compacting)
+  {
+    durable_start_compaction(dht);
+  }
+}
+
+/*
+  Insert key with value and return once the insert is on disk. Returns 0,
+  or -1 if the log could not be written. The insert stays in memory
+  after a -1, see the top of this file.
+ */
+int durable_hash_table_insert(DurableHashTable *dht, char *key, char *value)
+{
+  size_t key_len = strlen(key);
+  size_t value_len = strlen(value);
+  pthread_mutex_lock(&dht->lock);
+  if (dht->failed)
+  {
+    pthread_mutex_unlock(&dht->lock);
+    return -1;
+  }
+  durable_append(dht, DURABLE_RECORD_INSERT, key, key_len, value, value_len);
+  hash_table_insert_bytes(dht->ht, key, key_len, value, value_len);
+  int rc = durable_wait(dht, dht->appended_lsn);
+  if (rc == 0)
+  {
+    durable_maybe_compact(dht);
+  }
+  pthread_mutex_unlock(&dht->lock);
+  return rc;
+}
+
+/*
+  Remove key and return once the remove is on disk. Returns 0, or -1 if
+  the log could not be written. As for inserts, a failed remove is not
+  undone in memory.
+ */
+int durable_hash_table_remove(DurableHashTable *dht, char *key)
+{
+  size_t key_len = strlen(key);
+  pthread_mutex_lock(&dht->lock);
+  if (dht->failed)
+  {
+    pthread_mutex_unlock(&dht->lock);
+    return -1;
+  }
+  durable_append(dht, DURABLE_RECORD_REMOVE, key, key_len, NULL, 0);
+  hash_table_remove_bytes(dht->ht, key, key_len);
+  int rc = durable_wait(dht, dht->appended_lsn);
+  if (rc == 0)
+  {
+    durable_maybe_compact(dht);
+  }
+  pthread_mutex_unlock(&dht->lock);
+  return rc;
+}
+
+/*
+  Copy the value of key into the caller's buffer of size bytes (always
+  NUL terminated when size > 0). Returns the length of the value, or -1
+  if the key is not found.
+ */
+long durable_hash_table_retrieve(DurableHashTable *dht, char *key, char *value, size_t size)
+{
+  size_t key_len = strlen(key);
+  long found_len = -1;
+  pthread_mutex_lock(&dht->lock);
+  size_t value_len;
+  char *found = hash_table_retrieve_bytes(dht->ht, key, key_len, &value_len);
+  if (found != NULL)
+  {
+    found_len = (long)value_len;
+    if (size > 0)
+    {
+      size_t copied = value_len < size - 1 ? value_len : size - 1;
+      memcpy(value, found, copied);
+      value[copied] = '\0';
+    }
+  }
+  pthread_mutex_unlock(&dht->lock);
+  return found_len;
+}
+
+/*
+  Start a background compaction now, whatever the segment size. Returns
+  0, or -1 if one is already running or the log has failed.
+ */
+int durable_hash_table_compact(DurableHashTable *dht)
+{
+  int rc = -1;
+  pthread_mutex_lock(&dht->lock);
+  if (!dht->compacting)
+  {
+    rc = durable_start_compaction(dht);
+  }
+  pthread_mutex_unlock(&dht->lock);
+  return rc;
+}
+
+/*
+  Waits for a running compaction. No other thread may still be using the
+  table.
+ */
+void destroy_durable_hash_table(DurableHashTable *dht)
+{
+  pthread_mutex_lock(&dht->lock);
+  durable_wait(dht, dht->appended_lsn);
+  pthread_mutex_unlock(&dht->lock);
+  if (dht->compaction_started)
+  {
+    pthread_join(dht->compaction_thread, NULL);
+  }
+  close(dht->log_fd);
+  destroy_hash_table(dht->ht);
+  pthread_mutex_destroy(&dht->lock);
+  pthread_cond_destroy(&dht->synced);
+  free(dht->buffer.bytes);
+  free(dht->flush_buffer.bytes);
+  free(dht->dir);
+  free(dht);
+}
@@ -0,0 +1,55 @@
+#ifndef durable_hashtable_h
+#define durable_hashtable_h
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hashtables.h"
+
+/*
+  Log records appended but not written to the segment file yet.
+ */
+typedef struct DurableLogBuffer {
+  char *bytes;
+  size_t length;
+  size_t capacity;
+} DurableLogBuffer;
+
+typedef struct DurableHashTable {
+  char *dir;
+  HashTable *ht;
+  pthread_mutex_t lock;
+  pthread_cond_t synced;
+  int log_fd;
+  uint64_t generation;
+  uint64_t base_generation;
+  DurableLogBuffer buffer;
+  DurableLogBuffer flush_buffer;
+  uint64_t appended_lsn;
+  uint64_t durable_lsn;
+  int flushing;
+  int failed;
+  long syncs;
+  size_t segment_bytes;
+  size_t compact_bytes;
+  int compacting;
+  int compaction_started;
+  pthread_t compaction_thread;
+} DurableHashTable;
+
+
+DurableHashTable *open_durable_hash_table(const char *dir);
+
+int durable_hash_table_insert(DurableHashTable *dht, char *key, char *value);
+
+int durable_hash_table_remove(DurableHashTable *dht, char *key);
+
+long durable_hash_table_retrieve(DurableHashTable *dht, char *key, char *value, size_t size);
+
+int durable_hash_table_compact(DurableHashTable *dht);
+
+void destroy_durable_hash_table(DurableHashTable *dht);
+
+
+#endif
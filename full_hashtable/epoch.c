@@ -0,0 +1,183 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "epoch.h"
+
+/*
+  Epoch based reclamation.
+
+  Readers bracket every access to shared nodes with epoch_enter() and
+  epoch_exit(). Entering copies the global epoch into the thread's own
+  record, which sits on its own cache line, so readers never write a
+  cache line another thread writes.
+
+  Writers unlink a node first and then hand it to epoch_retire(), which
+  stamps it with the current global epoch. The global epoch only moves
+  forward once every thread inside a read section has seen its current
+  value, so two steps after a node was retired no reader can still hold
+  a pointer to it and it is freed.
+
+  There is one epoch domain per process, shared by every table. Each
+  writer keeps its own retire list and serializes access to it itself.
+ */
+
+// retired nodes a list collects before it tries to free some of them
+#define EPOCH_RECLAIM_THRESHOLD 64
+
+static atomic_uint_fast64_t epoch_global = 1;
+static _Atomic(EpochRecord *) epoch_records = NULL;
+static __thread EpochRecord *epoch_self = NULL;
+static pthread_key_t epoch_key;
+static pthread_once_t epoch_key_once = PTHREAD_ONCE_INIT;
+
+/*
+  Runs when a thread exits, its record can then be taken by a new thread.
+ */
+static void epoch_release_record(void *arg)
+{
+  EpochRecord *record = arg;
+  atomic_store(&record->state, 0);
+  atomic_store(&record->in_use, 0);
+}
+
+static void epoch_create_key(void)
+{
+  pthread_key_create(&epoch_key, epoch_release_record);
+}
+
+/*
+  Give the calling thread a record, reusing one of an exited thread when
+  there is one. Records are never freed, so the list only ever grows.
+ */
+static EpochRecord *epoch_register(void)
+{
+  pthread_once(&epoch_key_once, epoch_create_key);
+  EpochRecord *record;
+  for (record = atomic_load(&epoch_records); record != NULL; record = record->next)
+  {
+    int expected = 0;
+    if (atomic_compare_exchange_strong(&record->in_use, &expected, 1))
+    {
+      break;
+    }
+  }
+  if (record == NULL)
+  {
+    record = aligned_alloc(_Alignof(EpochRecord), sizeof(EpochRecord));
+    memset(record, 0, sizeof(EpochRecord));
+    atomic_init(&record->state, 0);
+    atomic_init(&record->in_use, 1);
+    // push onto the record list, next never changes once published
+    record->next = atomic_load(&epoch_records);
+    while (!atomic_compare_exchange_weak(&epoch_records, &record->next, record))
+    {
+    }
+  }
+  record->depth = 0;
+  pthread_setspecific(epoch_key, record);
+  epoch_self = record;
+  return record;
+}
+
+/*
+  Start a read section. Sections may nest, only the outermost one counts.
+ */
+void epoch_enter(void)
+{
+  EpochRecord *record = epoch_self != NULL ? epoch_self : epoch_register();
+  if (record->depth++ == 0)
+  {
+    atomic_store(&record->state, (atomic_load(&epoch_global) << 1) | 1);
+    // a store may still be passed by the acquire and relaxed loads of the
+    // section, only a full fence keeps them from reading a node before the
+    // reclaimer can see this reader
+    atomic_thread_fence(memory_order_seq_cst);
+  }
+}
+
+void epoch_exit(void)
+{
+  EpochRecord *record = epoch_self;
+  if (--record->depth == 0)
+  {
+    atomic_store_explicit(&record->state, 0, memory_order_release);
+  }
+}
+
+/*
+  Move the global epoch on by one if every active reader has seen it.
+  Returns the global epoch afterwards.
+ */
+static uint64_t epoch_try_advance(void)
+{
+  uint_fast64_t global = atomic_load(&epoch_global);
+  for (EpochRecord *record = atomic_load(&epoch_records); record != NULL; record = record->next)
+  {
+    uint_fast64_t state = atomic_load(&record->state);
+    if ((state & 1) && (state >> 1) != global)
+    {
+      return global;
+    }
+  }
+  atomic_compare_exchange_strong(&epoch_global, &global, global + 1);
+  return atomic_load(&epoch_global);
+}
+
+/*
+  Hand over an unlinked node, free_fn(ptr) runs once no reader can see it.
+ */
+void epoch_retire(EpochRetireList *list, void *ptr, void (*free_fn)(void *ptr))
+{
+  EpochRetired *retired = malloc(sizeof(EpochRetired));
+  retired->ptr = ptr;
+  retired->free_fn = free_fn;
+  retired->epoch = atomic_load(&epoch_global);
+  retired->next = list->head;
+  list->head = retired;
+  if (++list->pending >= EPOCH_RECLAIM_THRESHOLD)
+  {
+    epoch_reclaim(list);
+  }
+}
+
+/*
+  Free every node on the list that was retired two or more epochs ago.
+ */
+void epoch_reclaim(EpochRetireList *list)
+{
+  uint64_t global = epoch_try_advance();
+  EpochRetired **link = &list->head;
+  while (*link != NULL)
+  {
+    EpochRetired *retired = *link;
+    if (retired->epoch + 2 <= global)
+    {
+      *link = retired->next;
+      retired->free_fn(retired->ptr);
+      free(retired);
+      list->pending--;
+    }
+    else
+    {
+      link = &retired->next;
+    }
+  }
+}
+
+/*
+  Free everything on the list right away. Only safe once no reader can
+  reach any of the nodes, e.g. when the structure itself is destroyed.
+ */
+void epoch_drain(EpochRetireList *list)
+{
+  while (list->head != NULL)
+  {
+    EpochRetired *retired = list->head;
+    list->head = retired->next;
+    retired->free_fn(retired->ptr);
+    free(retired);
+  }
+  list->pending = 0;
+}
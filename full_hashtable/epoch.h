@@ -0,0 +1,38 @@
+#ifndef epoch_h
+#define epoch_h
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+typedef struct EpochRecord {
+  _Alignas(64) atomic_uint_fast64_t state;
+  atomic_int in_use;
+  int depth;
+  struct EpochRecord *next;
+} EpochRecord;
+
+typedef struct EpochRetired {
+  void *ptr;
+  void (*free_fn)(void *ptr);
+  uint64_t epoch;
+  struct EpochRetired *next;
+} EpochRetired;
+
+typedef struct EpochRetireList {
+  EpochRetired *head;
+  int pending;
+} EpochRetireList;
+
+
+void epoch_enter(void);
+
+void epoch_exit(void);
+
+void epoch_retire(EpochRetireList *list, void *ptr, void (*free_fn)(void *ptr));
+
+void epoch_reclaim(EpochRetireList *list);
+
+void epoch_drain(EpochRetireList *list);
+
+
+#endif
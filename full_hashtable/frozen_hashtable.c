@@ -0,0 +1,357 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "frozen_hashtable.h"
+#include "../utils/dbg.h"
+
+/*
+  Minimal perfect hash build, PTHash style.
+
+  Keys are spread over about count / FROZEN_BUCKET_SIZE buckets. Buckets
+  are placed largest first: for each one the builder tries pilots 0, 1,
+  2, ... until the pilot sends every key of the bucket to a slot nobody
+  has yet. Big buckets go first while most slots are free, the single
+  key buckets at the end then find a free slot after a few tries.
+
+  The table has count / FROZEN_LOAD slots, the slack keeps the last
+  searches short. Slots past count are remapped into the holes left
+  below count, so the result is minimal.
+
+  Pilots are stored with as many bits as the largest one needs, which
+  with these settings comes to about 3 bits per key in all.
+ */
+
+#define FROZEN_BUCKET_SIZE 4.5
+#define FROZEN_DENSE_BUCKETS 0.3
+#define FROZEN_LOAD 0.99
+#define FROZEN_MAX_PILOT ((uint64_t)1 << 24)
+#define FROZEN_ATTEMPTS 8
+
+typedef struct FrozenBuild {
+  uint64_t count;
+  uint64_t bucket_count;
+  uint64_t dense_buckets;
+  uint64_t table_size;
+  uint64_t *hashes;
+  uint64_t *slots;
+  uint64_t *pilots;
+  uint64_t *taken;
+  uint64_t max_pilot;
+} FrozenBuild;
+
+static int frozen_taken(uint64_t *taken, uint64_t slot)
+{
+  return (taken[slot >> 6] >> (slot & 63)) & 1;
+}
+
+/*
+  Find a pilot for every bucket. Returns 0, or -1 when the hashes of
+  this seed cannot be placed (two equal hashes, or a pilot search that
+  ran past FROZEN_MAX_PILOT).
+ */
+static int frozen_find_pilots(FrozenBuild *build)
+{
+  uint64_t n = build->count, buckets = build->bucket_count;
+  uint64_t *starts = calloc(buckets + 2, sizeof(uint64_t));
+  uint64_t *order = malloc((n + 1) * sizeof(uint64_t));
+  uint64_t *hashes = malloc((n + 1) * sizeof(uint64_t));
+  uint64_t *by_size = malloc(buckets * sizeof(uint64_t));
+  uint64_t *positions = NULL;
+  int rc = -1;
+
+  // counting sort of the keys by bucket
+  for (uint64_t i = 0; i < n; i++)
+  {
+    starts[snapshot_perfect_bucket(build->hashes[i], build->dense_buckets, buckets) + 2]++;
+  }
+  for (uint64_t b = 0; b < buckets; b++)
+  {
+    starts[b + 2] += starts[b + 1];
+  }
+  for (uint64_t i = 0; i < n; i++)
+  {
+    uint64_t e = starts[snapshot_perfect_bucket(build->hashes[i], build->dense_buckets, buckets) + 1]++;
+    order[e] = i;
+    hashes[e] = build->hashes[i];
+  }
+  // starts[b] now is where bucket b starts, then the buckets sorted by size, largest first
+  uint64_t max_size = 0;
+  for (uint64_t b = 0; b < buckets; b++)
+  {
+    uint64_t size = starts[b + 1] - starts[b];
+    max_size = size > max_size ? size : max_size;
+  }
+  uint64_t *size_starts = calloc(max_size + 2, sizeof(uint64_t));
+  for (uint64_t b = 0; b < buckets; b++)
+  {
+    size_starts[max_size - (starts[b + 1] - starts[b]) + 1]++;
+  }
+  for (uint64_t s = 0; s < max_size; s++)
+  {
+    size_starts[s + 1] += size_starts[s];
+  }
+  for (uint64_t b = 0; b < buckets; b++)
+  {
+    by_size[size_starts[max_size - (starts[b + 1] - starts[b])]++] = b;
+  }
+  free(size_starts);
+
+  positions = malloc((max_size + 1) * sizeof(uint64_t));
+  build->max_pilot = 0;
+  for (uint64_t k = 0; k < buckets; k++)
+  {
+    uint64_t b = by_size[k], first = starts[b], size = starts[b + 1] - starts[b];
+    if (size == 0)
+    {
+      // every bucket after this one is empty as well
+      break;
+    }
+    for (uint64_t i = first; i < first + size; i++)
+    {
+      for (uint64_t j = first; j < i; j++)
+      {
+        check_debug(hashes[i] != hashes[j], "Two keys share a hash.");
+      }
+    }
+    uint64_t pilot = 0;
+    for (;; pilot++)
+    {
+      check_debug(pilot < FROZEN_MAX_PILOT, "No pilot found for bucket %llu.", (unsigned long long)b);
+      uint64_t pilot_mix = snapshot_perfect_pilot_mix(pilot);
+      uint64_t placed = 0;
+      for (; placed < size; placed++)
+      {
+        uint64_t slot = snapshot_perfect_position(hashes[first + placed], pilot_mix, build->table_size);
+        if (frozen_taken(build->taken, slot))
+        {
+          break;
+        }
+        uint64_t j = 0;
+        while (j < placed && positions[j] != slot)
+        {
+          j++;
+        }
+        if (j < placed)
+        {
+          break;
+        }
+        positions[placed] = slot;
+      }
+      if (placed == size)
+      {
+        break;
+      }
+    }
+    for (uint64_t j = 0; j < size; j++)
+    {
+      build->taken[positions[j] >> 6] |= (uint64_t)1 << (positions[j] & 63);
+      build->slots[order[first + j]] = positions[j];
+    }
+    build->pilots[b] = pilot;
+    build->max_pilot = pilot > build->max_pilot ? pilot : build->max_pilot;
+  }
+  rc = 0;
+
+error:
+  free(starts);
+  free(order);
+  free(hashes);
+  free(by_size);
+  free(positions);
+  return rc;
+}
+
+/*
+  Build a frozen copy of the table's current pairs. The table itself is
+  not changed and can be destroyed right after. Returns NULL if no
+  perfect hash was found for any of the seeds tried, which takes keys
+  with colliding 64 bit hashes under every one of them.
+ */
+FrozenHashTable *hash_table_freeze(HashTable *ht)
+{
+  FrozenBuild build;
+  memset(&build, 0, sizeof(build));
+  LinkedPair **pairs = snapshot_collect_pairs(ht, &build.count);
+  // at least one dense and one sparse bucket, even when empty
+  build.bucket_count = (uint64_t)(build.count / FROZEN_BUCKET_SIZE) + 2;
+  build.dense_buckets = (uint64_t)(build.bucket_count * FROZEN_DENSE_BUCKETS);
+  build.dense_buckets = build.dense_buckets == 0 ? 1 : build.dense_buckets;
+  build.table_size = build.count == 0 ? 0 : (uint64_t)(build.count / FROZEN_LOAD) + 1;
+  build.hashes = malloc((build.count + 1) * sizeof(uint64_t));
+  build.slots = malloc((build.count + 1) * sizeof(uint64_t));
+  build.pilots = calloc(build.bucket_count, sizeof(uint64_t));
+  build.taken = malloc((build.table_size / 64 + 1) * sizeof(uint64_t));
+  char *image = NULL;
+  FrozenHashTable *fht = NULL;
+
+  uint64_t seed = ht->seed;
+  int attempt = 0;
+  for (;; attempt++)
+  {
+    check(attempt < FROZEN_ATTEMPTS, "No perfect hash found for %llu keys.", (unsigned long long)build.count);
+    for (uint64_t i = 0; i < build.count; i++)
+    {
+      build.hashes[i] = hash_wyhash(pairs[i]->key, pairs[i]->key_len, seed);
+    }
+    memset(build.taken, 0, (build.table_size / 64 + 1) * sizeof(uint64_t));
+    memset(build.pilots, 0, build.bucket_count * sizeof(uint64_t));
+    if (frozen_find_pilots(&build) == 0)
+    {
+      break;
+    }
+    seed = hash_wy_mix(seed ^ 0x9e3779b97f4a7c15ull, attempt + 1);
+  }
+
+  // sections of the image, laid out as in snapshot.h
+  uint64_t pilot_bits = 0;
+  while (pilot_bits < 64 && (build.max_pilot >> pilot_bits) != 0)
+  {
+    pilot_bits++;
+  }
+  uint64_t pilot_words = (build.bucket_count * pilot_bits + 63) / 64 + 1;
+  uint64_t remap_count = build.table_size - build.count;
+  uint64_t remap_bytes = (remap_count * sizeof(uint32_t) + 7) / 8 * 8;
+  uint64_t heap_size = 0;
+  for (uint64_t i = 0; i < build.count; i++)
+  {
+    heap_size += pairs[i]->key_len + pairs[i]->value_len + 2;
+  }
+  SnapshotHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = SNAPSHOT_VERSION;
+  header.flags = SNAPSHOT_PERFECT_HASH;
+  header.seed = seed;
+  header.count = build.count;
+  header.bucket_count = build.bucket_count;
+  header.buckets_offset = sizeof(SnapshotHeader);
+  header.entries_offset = header.buckets_offset + sizeof(SnapshotPerfectHash) + pilot_words * sizeof(uint64_t) + remap_bytes;
+  header.heap_offset = header.entries_offset + build.count * sizeof(SnapshotEntry);
+  header.heap_size = heap_size;
+  header.file_size = header.heap_offset + (heap_size + 7) / 8 * 8;
+
+  image = calloc(1, header.file_size);
+  check_mem(image);
+  memcpy(image, &header, sizeof(header));
+  SnapshotPerfectHash *perfect = (SnapshotPerfectHash *)(image + header.buckets_offset);
+  perfect->table_size = build.table_size;
+  perfect->dense_buckets = build.dense_buckets;
+  perfect->pilot_bits = pilot_bits;
+  perfect->pilot_words = pilot_words;
+  perfect->remap_count = remap_count;
+  uint64_t *pilots = (uint64_t *)(perfect + 1);
+  for (uint64_t b = 0; b < build.bucket_count && pilot_bits > 0; b++)
+  {
+    uint64_t bit = b * pilot_bits;
+    pilots[bit >> 6] |= build.pilots[b] << (bit & 63);
+    if ((bit & 63) + pilot_bits > 64)
+    {
+      pilots[(bit >> 6) + 1] |= build.pilots[b] >> (64 - (bit & 63));
+    }
+  }
+  // fill the holes below count with the slots past it, in order
+  uint32_t *remap = (uint32_t *)(pilots + pilot_words);
+  uint64_t hole = 0;
+  for (uint64_t slot = build.count; slot < build.table_size; slot++)
+  {
+    if (frozen_taken(build.taken, slot))
+    {
+      while (frozen_taken(build.taken, hole))
+      {
+        hole++;
+      }
+      remap[slot - build.count] = (uint32_t)hole++;
+    }
+  }
+  // the entries and the heap, in entry order
+  SnapshotEntry *entries = (SnapshotEntry *)(image + header.entries_offset);
+  for (uint64_t i = 0; i < build.count; i++)
+  {
+    uint64_t slot = build.slots[i];
+    uint64_t e = slot < build.count ? slot : remap[slot - build.count];
+    entries[e].hash = build.hashes[i];
+    entries[e].key_len = pairs[i]->key_len;
+    entries[e].value_len = pairs[i]->value_len;
+    build.slots[i] = e;
+  }
+  char *heap = image + header.heap_offset;
+  uint64_t offset = 0;
+  for (uint64_t e = 0; e < build.count; e++)
+  {
+    entries[e].offset = offset;
+    offset += entries[e].key_len + entries[e].value_len + 2;
+  }
+  for (uint64_t i = 0; i < build.count; i++)
+  {
+    SnapshotEntry *entry = &entries[build.slots[i]];
+    memcpy(heap + entry->offset, pairs[i]->key, pairs[i]->key_len);
+    memcpy(heap + entry->offset + entry->key_len + 1, pairs[i]->value, pairs[i]->value_len);
+  }
+
+  fht = snapshot_attach(image, header.file_size, 1);
+  check(fht != NULL, "Frozen table image is invalid.");
+
+error:
+  if (fht == NULL)
+  {
+    free(image);
+  }
+  free(pairs);
+  free(build.hashes);
+  free(build.slots);
+  free(build.pilots);
+  free(build.taken);
+  return fht;
+}
+
+char *frozen_hash_table_retrieve(FrozenHashTable *fht, char *key)
+{
+  return mapped_hash_table_retrieve(fht, key);
+}
+
+/*
+  Return the value stored under the key_len bytes at key, or NULL if the
+  key is not found. One probe: the perfect hash names the only entry the
+  key can be, whose hash tag rejects other keys.
+ */
+void *frozen_hash_table_retrieve_bytes(FrozenHashTable *fht, const void *key, size_t key_len, size_t *value_len)
+{
+  return mapped_hash_table_retrieve_bytes(fht, key, key_len, value_len);
+}
+
+/*
+  Write the frozen table to path as a snapshot, which
+  hash_table_open_mapped maps with its perfect hash. Like
+  hash_table_save, the file only appears at path once complete.
+  Returns 0, or -1 if the file could not be written.
+ */
+int frozen_hash_table_save(FrozenHashTable *fht, const char *path)
+{
+  char *tmp_path = malloc(strlen(path) + 5);
+  sprintf(tmp_path, "%s.tmp", path);
+  FILE *file = fopen(tmp_path, "wb");
+  check(file != NULL, "Could not open %s for writing.", tmp_path);
+  check(fwrite(fht->base, 1, fht->size, file) == fht->size, "Could not write %s.", tmp_path);
+  check(fflush(file) == 0 && fsync(fileno(file)) == 0, "Could not flush %s.", tmp_path);
+  check(fclose(file) == 0, "Could not close %s.", tmp_path);
+  file = NULL;
+  check(rename(tmp_path, path) == 0, "Could not rename %s to %s.", tmp_path, path);
+  free(tmp_path);
+  return 0;
+
+error:
+  if (file != NULL)
+  {
+    fclose(file);
+  }
+  unlink(tmp_path);
+  free(tmp_path);
+  return -1;
+}
+
+void destroy_frozen_hash_table(FrozenHashTable *fht)
+{
+  destroy_mapped_hash_table(fht);
+}
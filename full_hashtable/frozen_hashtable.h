@@ -0,0 +1,32 @@
+#ifndef frozen_hashtable_h
+#define frozen_hashtable_h
+
+#include "snapshot.h"
+
+/*
+  Immutable table built once from a HashTable and then only read.
+
+  A frozen table is a perfect hash snapshot image (see snapshot.h) held
+  in memory: a minimal perfect hash sends every key to exactly one of
+  `count` dense entries, so a lookup is one probe with no chain to walk
+  and no empty buckets, and the hash itself costs a few bits per key.
+
+  It is the same type as a mapped snapshot, so the mapped_hash_table_*
+  functions work on both, and a saved frozen table comes back from
+  hash_table_open_mapped with the same one probe lookups.
+ */
+typedef MappedHashTable FrozenHashTable;
+
+
+FrozenHashTable *hash_table_freeze(HashTable *ht);
+
+char *frozen_hash_table_retrieve(FrozenHashTable *fht, char *key);
+
+void *frozen_hash_table_retrieve_bytes(FrozenHashTable *fht, const void *key, size_t key_len, size_t *value_len);
+
+int frozen_hash_table_save(FrozenHashTable *fht, const char *path);
+
+void destroy_frozen_hash_table(FrozenHashTable *fht);
+
+
+#endif
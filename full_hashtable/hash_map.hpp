@@ -0,0 +1,537 @@
+#ifndef hash_map_hpp
+#define hash_map_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../utils/hash.h"
+
+/*
+  Header only C++17 counterpart of HashTable.
+
+  Same engine: separate chaining into a power of two bucket array, new
+  pairs pushed onto the front of their chain, the table doubling once it
+  holds more than `max_load` pairs per bucket and halving below
+  `min_load`, never below the capacity it was created with.
+
+  Unlike HashTable the key and value types, the hash and the equality
+  are template parameters, so every call is resolved and inlined at
+  compile time. Keys and values are moved into the map, never copied,
+  and lookups take any type the hash and equality functors accept when
+  both are transparent (e.g. a std::string_view for std::string keys).
+
+  Nodes come out of chunks owned by the map and go back onto a free
+  list, so after warm up inserts and removes do not allocate. Pointers
+  and references to values stay valid until their key is removed.
+ */
+namespace hashtables
+{
+
+/*
+  Default hash: one wyhash mix for integers and enums, wyhash over the
+  bytes for anything that converts to a std::string_view. Transparent,
+  std::string, std::string_view and C strings of the same bytes hash the
+  same.
+ */
+struct HashMapHash
+{
+  using is_transparent = void;
+
+  template <class T, std::enable_if_t<std::is_integral_v<T> || std::is_enum_v<T>, int> = 0>
+  uint64_t operator()(T key) const noexcept
+  {
+    return hash_wy_mix(static_cast<uint64_t>(key) ^ 0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull);
+  }
+
+  uint64_t operator()(std::string_view key) const noexcept
+  {
+    return hash_wyhash(key.data(), key.size(), 0);
+  }
+};
+
+/*
+  Default equality, the match of HashMapHash: anything that converts to
+  a std::string_view is compared by its bytes, so C string keys match
+  equal strings at other addresses, and everything else with ==.
+  Transparent, like the hash.
+ */
+struct HashMapEqual
+{
+  using is_transparent = void;
+
+  template <class A, class B>
+  bool operator()(const A &a, const B &b) const
+  {
+    if constexpr (std::is_convertible_v<const A &, std::string_view> && std::is_convertible_v<const B &, std::string_view>)
+    {
+      return std::string_view(a) == std::string_view(b);
+    }
+    else
+    {
+      return a == b;
+    }
+  }
+};
+
+namespace detail
+{
+
+template <class T, class = void>
+struct HashMapTransparent : std::false_type
+{
+};
+
+template <class T>
+struct HashMapTransparent<T, std::void_t<typename T::is_transparent>> : std::true_type
+{
+};
+
+// the full hash, cached in nodes whose key is not cheaper to rehash than to store
+template <bool Cached>
+struct HashMapCachedHash
+{
+  uint64_t hash;
+};
+
+template <>
+struct HashMapCachedHash<false>
+{
+};
+
+} // namespace detail
+
+template <class K, class V, class Hash = HashMapHash, class Eq = HashMapEqual>
+class HashMap
+{
+  // keys like uint64_t: passed by value and cheap to rehash
+  static constexpr bool kSmallKey = std::is_trivially_copyable_v<K> && sizeof(K) <= sizeof(uint64_t);
+  // the hash is cached unless the key is small, C strings are small but their bytes are not
+  static constexpr bool kCachedHash = !kSmallKey || std::is_convertible_v<const K &, std::string_view>;
+  static constexpr bool kSmallValue = std::is_trivially_copyable_v<V> && sizeof(V) <= sizeof(uint64_t);
+  static constexpr bool kTrivialEntries = std::is_trivially_destructible_v<K> && std::is_trivially_destructible_v<V>;
+  static constexpr double kMaxLoad = 0.7;
+  static constexpr double kMinLoad = 0.2;
+  static constexpr std::size_t kMinChunk = 16;
+  static constexpr std::size_t kMaxChunk = 4096;
+
+  template <class Q>
+  static constexpr bool kLookup = std::is_same_v<Q, K> ||
+                                  (detail::HashMapTransparent<Hash>::value && detail::HashMapTransparent<Eq>::value);
+
+  struct Entry
+  {
+    K key;
+    V value;
+
+    template <class... Args>
+    Entry(K &&key, Args &&...args) : key(std::move(key)), value(std::forward<Args>(args)...)
+    {
+    }
+  };
+
+  // the entry is constructed and destroyed by hand, free nodes only use next
+  struct Node : detail::HashMapCachedHash<kCachedHash>
+  {
+    Node *next;
+    union
+    {
+      Entry entry;
+    };
+
+    Node() {}
+    ~Node() {}
+  };
+
+public:
+  using key_type = K;
+  using mapped_type = V;
+  // small trivially copyable keys and values are copied, a copy is a move
+  using key_param = std::conditional_t<kSmallKey, K, K &&>;
+  using value_param = std::conditional_t<kSmallValue, V, V &&>;
+
+  explicit HashMap(std::size_t capacity = 8, Hash hash = Hash(), Eq eq = Eq())
+      : hash_(std::move(hash)), eq_(std::move(eq))
+  {
+    initial_capacity_ = round_pow2(capacity);
+    rehash_to(initial_capacity_);
+  }
+
+  HashMap(const HashMap &) = delete;
+  HashMap &operator=(const HashMap &) = delete;
+
+  /*
+    A moved from map is empty and still usable.
+   */
+  HashMap(HashMap &&other) noexcept
+      : hash_(std::move(other.hash_)), eq_(std::move(other.eq_))
+  {
+    take(other);
+  }
+
+  HashMap &operator=(HashMap &&other) noexcept
+  {
+    if (this != &other)
+    {
+      destroy_entries();
+      hash_ = std::move(other.hash_);
+      eq_ = std::move(other.eq_);
+      take(other);
+    }
+    return *this;
+  }
+
+  ~HashMap()
+  {
+    destroy_entries();
+  }
+
+  /*
+    Insert key with value, replacing the value if key is already there.
+    Returns the stored value.
+   */
+  V &insert(key_param key, value_param value)
+  {
+    return emplace(std::move(key), std::move(value));
+  }
+
+  /*
+    Like insert, with the value constructed in place from args.
+   */
+  template <class... Args>
+  V &emplace(key_param key, Args &&...args)
+  {
+    uint64_t keyHash = hash_(key);
+    if (capacity_ == 0)
+    {
+      rehash_to(initial_capacity_);
+    }
+    Node **bucket = &buckets_[keyHash & (capacity_ - 1)];
+    for (Node *current = *bucket; current != nullptr; current = current->next)
+    {
+      if (node_has_key(current, keyHash, key))
+      {
+        current->entry.value = V(std::forward<Args>(args)...);
+        return current->entry.value;
+      }
+    }
+    Node *node = alloc_node();
+    try
+    {
+      new (&node->entry) Entry(std::move(key), std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+      node->next = free_;
+      free_ = node;
+      throw;
+    }
+    if constexpr (kCachedHash)
+    {
+      node->hash = keyHash;
+    }
+    node->next = *bucket;
+    *bucket = node;
+    count_++;
+    // double the table once it gets too full
+    if (max_load_ > 0 && count_ > capacity_ * max_load_)
+    {
+      rehash_to(capacity_ * 2);
+    }
+    return node->entry.value;
+  }
+
+  /*
+    The value stored for key, or nullptr if it is not there.
+   */
+  template <class Q, std::enable_if_t<kLookup<Q>, int> = 0>
+  V *find(const Q &key)
+  {
+    Node *node = find_node(key);
+    return node != nullptr ? &node->entry.value : nullptr;
+  }
+
+  template <class Q, std::enable_if_t<kLookup<Q>, int> = 0>
+  const V *find(const Q &key) const
+  {
+    Node *node = find_node(key);
+    return node != nullptr ? &node->entry.value : nullptr;
+  }
+
+  template <class Q, std::enable_if_t<kLookup<Q>, int> = 0>
+  bool contains(const Q &key) const
+  {
+    return find_node(key) != nullptr;
+  }
+
+  /*
+    Remove key and destroy its key and value. Returns whether it was there.
+   */
+  template <class Q, std::enable_if_t<kLookup<Q>, int> = 0>
+  bool remove(const Q &key)
+  {
+    if (count_ == 0)
+    {
+      return false;
+    }
+    uint64_t keyHash = hash_(key);
+    Node **link = &buckets_[keyHash & (capacity_ - 1)];
+    while (*link != nullptr && !node_has_key(*link, keyHash, key))
+    {
+      link = &(*link)->next;
+    }
+    if (*link == nullptr)
+    {
+      return false;
+    }
+    Node *node = *link;
+    *link = node->next;
+    free_node(node);
+    count_--;
+    // halve the table once it gets too empty, see hash_table_remove
+    if (min_load_ > 0 && capacity_ / 2 >= initial_capacity_ && count_ < capacity_ * min_load_)
+    {
+      rehash_to(capacity_ / 2);
+    }
+    return true;
+  }
+
+  /*
+    Call fn(key, value) for every pair, in bucket order.
+   */
+  template <class F>
+  void for_each(F &&fn)
+  {
+    for (std::size_t i = 0; i < capacity_; i++)
+    {
+      for (Node *current = buckets_[i]; current != nullptr; current = current->next)
+      {
+        fn(static_cast<const K &>(current->entry.key), current->entry.value);
+      }
+    }
+  }
+
+  /*
+    Grow so that n pairs fit without another resize.
+   */
+  void reserve(std::size_t n)
+  {
+    std::size_t capacity = capacity_ > 0 ? capacity_ : initial_capacity_;
+    while (max_load_ > 0 && n > capacity * max_load_)
+    {
+      capacity *= 2;
+    }
+    if (capacity != capacity_)
+    {
+      rehash_to(capacity);
+    }
+  }
+
+  /*
+    Change the load factors that trigger automatic resizes, as
+    hash_table_set_load_factors. A factor of 0 turns that direction off.
+    Returns false and keeps the old factors if either is negative or NaN,
+    or min_load is not under half of max_load.
+   */
+  bool set_load_factors(double max_load, double min_load)
+  {
+    // written so NaN fails too
+    if (!(max_load >= 0) || !(min_load >= 0) || (max_load > 0 && !(min_load < max_load / 2)))
+    {
+      return false;
+    }
+    max_load_ = max_load;
+    min_load_ = min_load;
+    return true;
+  }
+
+  /*
+    Remove every pair. The capacity and the node chunks are kept.
+   */
+  void clear()
+  {
+    for (std::size_t i = 0; i < capacity_; i++)
+    {
+      Node *current = buckets_[i];
+      while (current != nullptr)
+      {
+        Node *next = current->next;
+        free_node(current);
+        current = next;
+      }
+      buckets_[i] = nullptr;
+    }
+    count_ = 0;
+  }
+
+  std::size_t size() const
+  {
+    return count_;
+  }
+
+  bool empty() const
+  {
+    return count_ == 0;
+  }
+
+  std::size_t capacity() const
+  {
+    return capacity_;
+  }
+
+private:
+  static std::size_t round_pow2(std::size_t n)
+  {
+    std::size_t rounded = 1;
+    while (rounded < n)
+    {
+      rounded <<= 1;
+    }
+    return rounded;
+  }
+
+  template <class Q>
+  bool node_has_key(const Node *node, uint64_t keyHash, const Q &key) const
+  {
+    // the cached hash settles most mismatches without touching the key
+    if constexpr (kCachedHash)
+    {
+      if (node->hash != keyHash)
+      {
+        return false;
+      }
+    }
+    (void)keyHash;
+    return eq_(node->entry.key, key);
+  }
+
+  uint64_t node_hash(const Node *node) const
+  {
+    if constexpr (kCachedHash)
+    {
+      return node->hash;
+    }
+    else
+    {
+      return hash_(node->entry.key);
+    }
+  }
+
+  template <class Q>
+  Node *find_node(const Q &key) const
+  {
+    if (count_ == 0)
+    {
+      return nullptr;
+    }
+    uint64_t keyHash = hash_(key);
+    Node *current = buckets_[keyHash & (capacity_ - 1)];
+    while (current != nullptr && !node_has_key(current, keyHash, key))
+    {
+      current = current->next;
+    }
+    return current;
+  }
+
+  /*
+    Relink every node into a new bucket array of capacity buckets. Nodes
+    are not moved, so values keep their addresses.
+   */
+  void rehash_to(std::size_t capacity)
+  {
+    std::unique_ptr<Node *[]> buckets(new Node *[capacity]());
+    for (std::size_t i = 0; i < capacity_; i++)
+    {
+      Node *current = buckets_[i];
+      while (current != nullptr)
+      {
+        Node *next = current->next;
+        Node **bucket = &buckets[node_hash(current) & (capacity - 1)];
+        current->next = *bucket;
+        *bucket = current;
+        current = next;
+      }
+    }
+    buckets_ = std::move(buckets);
+    capacity_ = capacity;
+  }
+
+  /*
+    Take a node off the free list, adding a chunk of nodes when it is
+    empty. Chunks grow with the map, so a map of n pairs allocated
+    O(log n) of them.
+   */
+  Node *alloc_node()
+  {
+    if (free_ == nullptr)
+    {
+      std::size_t size = count_ < kMinChunk ? kMinChunk : (count_ > kMaxChunk ? kMaxChunk : count_);
+      chunks_.emplace_back(new Node[size]);
+      Node *chunk = chunks_.back().get();
+      for (std::size_t i = 0; i < size; i++)
+      {
+        chunk[i].next = i + 1 < size ? &chunk[i + 1] : nullptr;
+      }
+      free_ = chunk;
+    }
+    Node *node = free_;
+    free_ = node->next;
+    return node;
+  }
+
+  void free_node(Node *node)
+  {
+    if constexpr (!std::is_trivially_destructible_v<Entry>)
+    {
+      node->entry.~Entry();
+    }
+    node->next = free_;
+    free_ = node;
+  }
+
+  void destroy_entries()
+  {
+    if constexpr (!kTrivialEntries)
+    {
+      clear();
+    }
+  }
+
+  void take(HashMap &other)
+  {
+    buckets_ = std::move(other.buckets_);
+    chunks_ = std::move(other.chunks_);
+    free_ = other.free_;
+    capacity_ = other.capacity_;
+    initial_capacity_ = other.initial_capacity_;
+    count_ = other.count_;
+    max_load_ = other.max_load_;
+    min_load_ = other.min_load_;
+    // the moved from map gets a bucket array again on its next insert
+    other.buckets_.reset();
+    other.chunks_.clear();
+    other.free_ = nullptr;
+    other.capacity_ = 0;
+    other.count_ = 0;
+  }
+
+  Hash hash_;
+  Eq eq_;
+  std::unique_ptr<Node *[]> buckets_;
+  std::vector<std::unique_ptr<Node[]>> chunks_;
+  Node *free_ = nullptr;
+  std::size_t capacity_ = 0;
+  std::size_t initial_capacity_ = 8;
+  std::size_t count_ = 0;
+  double max_load_ = kMaxLoad;
+  double min_load_ = kMinLoad;
+};
+
+} // namespace hashtables
+
+#endif
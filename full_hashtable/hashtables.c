@@ -1,69 +1,366 @@
+#include <pthread.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hashtables.h"
+
+// number of old buckets an incremental resize moves on each insert, remove or retrieve
+#define HASH_TABLE_REHASH_STEP 4
+
+// keys a batched call keeps in flight at once, each stage runs over all of them
+#define HASH_TABLE_BATCH 32
+
+// expired pairs one insert, remove or retrieve reclaims at most
+#define HASH_TABLE_EXPIRE_BATCH 64
+
+// build with -DHASH_TABLE_NO_STATS to compile the counters out, they then stay 0
+#ifdef HASH_TABLE_NO_STATS
+#define HASH_TABLE_COUNT(ht, counter)
+#else
+#define HASH_TABLE_COUNT(ht, counter) ((ht)->counters.counter++)
+#endif
+
+/*
+  Copy len bytes into memory from the table's bytes allocator.
+
+  The copy is always followed by a NUL byte, so keys and values stored
+  through the `char *` API can be handed back as plain strings.
+ */
+static char *hash_table_copy_bytes(HashTable *ht, const void *bytes, size_t len)
+{
+  char *copy = ht->bytes_allocator.alloc(ht->bytes_allocator.ctx, len + 1);
+  memcpy(copy, bytes, len);
+  copy[len] = '\0';
+  return copy;
+}
+
+/*
+  Give bytes copied by hash_table_copy_bytes back to their allocator.
+ */
+static void hash_table_free_bytes(HashTable *ht, char *bytes, size_t len)
+{
+  ht->bytes_allocator.free(ht->bytes_allocator.ctx, bytes, len + 1);
+}
 
 /*
-  Hash table key/value pair with linked list pointer.
+  The table is done with a key or value it holds under the given
+  ownership: free a copy, leave borrowed bytes alone, hand moved bytes
+  to the destructor.
+ */
+static void hash_table_release(HashTable *ht, HashTableOwnership ownership, char *bytes, size_t len)
+{
+  if (ownership == HASH_TABLE_COPY)
+  {
+    hash_table_free_bytes(ht, bytes, len);
+  }
+  else if (ownership == HASH_TABLE_MOVE && ht->destructor != NULL)
+  {
+    ht->destructor(bytes, len);
+  }
+}
 
-  Note that an instance of `LinkedPair` is also a node in a linked list.
-  More specifically, the `next` field is a pointer pointing to the the 
-  next `LinkedPair` in the list of `LinkedPair` nodes. 
+/*
+  Inline space taken by a key of key_len bytes and its NUL, rounded up so
+  the value behind it starts 8 byte aligned like a heap block would.
  */
-typedef struct LinkedPair
+static size_t hash_table_inline_key_size(size_t key_len)
 {
-  // pointer to key string
-  char *key;
-  // pointer to value string
-  char *value;
-  // struct LinkedPair next value which points to next node of the LinkedPair linked list
-  struct LinkedPair *next;
-  // LinkedPair
-} LinkedPair;
+  return (key_len + 1 + 7) & ~(size_t)7;
+}
 
 /*
-  Hash table with linked pairs.
+  Copy len bytes into the pair's inline space at offset, followed by a NUL.
  */
-typedef struct HashTable
+static char *hash_table_copy_inline(LinkedPair *pair, size_t offset, const void *bytes, size_t len)
 {
-  // hash table with int type capacity
-  int capacity;
-  // Linked pair struct type with pointer to array storage which is an array of key value pairs
-  LinkedPair **storage;
-  // full hash table, that can handle collisions, which is when two distinct piece of data have the same hash value,
-  // it handles what to do, so things don't get overwritten unnecessarily
-} HashTable;
+  char *copy = pair->inline_bytes + offset;
+  memcpy(copy, bytes, len);
+  copy[len] = '\0';
+  return copy;
+}
+
+// inline keys must start in the pair's first cache line, next to its hash
+_Static_assert(offsetof(LinkedPair, inline_bytes) < 64, "LinkedPair header spills past a cache line");
 
 /*
   Create a key/value linked pair to be stored in the hash table.
+
+  The pair and its copies of key and value come from the table's allocators.
+  A key or value shorter than HASH_TABLE_INLINE_MAX bytes is stored in
+  the pair's own allocation, right behind its fields, instead of in a
+  block of its own. Borrowed and moved keys and values are not copied at
+  all, the pair points at the caller's bytes.
  */
-LinkedPair *create_pair(char *key, char *value)
+LinkedPair *create_pair(HashTable *ht, const void *key, size_t key_len, const void *value, size_t value_len)
 {
-  // initialize linkedpair struct type pointer pair to have memory allocation of linkedpair size bytes
-  LinkedPair *pair = malloc(sizeof(LinkedPair));
-  // assign pair key with string duplicate func, pass in key's value
-  pair->key = strdup(key);
-  // assign pair value with string duplicate func, pass in value's value
-  pair->value = strdup(value);
+  size_t key_inline = ht->key_ownership == HASH_TABLE_COPY && key_len < HASH_TABLE_INLINE_MAX ? hash_table_inline_key_size(key_len) : 0;
+  size_t value_inline = ht->value_ownership == HASH_TABLE_COPY && value_len < HASH_TABLE_INLINE_MAX ? value_len + 1 : 0;
+  // initialize linkedpair struct type pointer pair with room for the short strings behind it
+  LinkedPair *pair = ht->node_allocator.alloc(ht->node_allocator.ctx, sizeof(LinkedPair) + key_inline + value_inline);
+  pair->inline_size = key_inline + value_inline;
+  pair->flags = 0;
+  // assign pair key with a copy of key's bytes
+  if (key_inline)
+  {
+    pair->key = hash_table_copy_inline(pair, 0, key, key_len);
+    pair->flags |= LINKED_PAIR_KEY_INLINE;
+  }
+  else if (ht->key_ownership == HASH_TABLE_COPY)
+  {
+    pair->key = hash_table_copy_bytes(ht, key, key_len);
+  }
+  else
+  {
+    pair->key = (char *)key;
+  }
+  pair->key_len = key_len;
+  // assign pair value with a copy of value's bytes
+  if (value_inline)
+  {
+    pair->value = hash_table_copy_inline(pair, key_inline, value, value_len);
+    pair->flags |= LINKED_PAIR_VALUE_INLINE;
+  }
+  else if (ht->value_ownership == HASH_TABLE_COPY)
+  {
+    pair->value = hash_table_copy_bytes(ht, value, value_len);
+  }
+  else
+  {
+    pair->value = (char *)value;
+  }
+  pair->value_len = value_len;
   // assign pair next with initialization of NULL
   pair->next = NULL;
   // return pair
   return pair;
 }
 
+/*
+  Replace the value of a pair. A copied value stays inline when it fits
+  in the inline space the old value was given.
+ */
+static void hash_table_set_value(HashTable *ht, LinkedPair *pair, const void *value, size_t value_len)
+{
+  size_t key_inline = pair->flags & LINKED_PAIR_KEY_INLINE ? hash_table_inline_key_size(pair->key_len) : 0;
+  if (!(pair->flags & LINKED_PAIR_VALUE_INLINE))
+  {
+    hash_table_release(ht, ht->value_ownership, pair->value, pair->value_len);
+  }
+  if (ht->value_ownership != HASH_TABLE_COPY)
+  {
+    pair->value = (char *)value;
+  }
+  else if (value_len + 1 <= pair->inline_size - key_inline)
+  {
+    pair->value = hash_table_copy_inline(pair, key_inline, value, value_len);
+    pair->flags |= LINKED_PAIR_VALUE_INLINE;
+  }
+  else
+  {
+    pair->value = hash_table_copy_bytes(ht, value, value_len);
+    pair->flags &= ~LINKED_PAIR_VALUE_INLINE;
+  }
+  pair->value_len = value_len;
+}
+
+/*
+  Bytes a pair takes, as counted in entry_bytes and by hash_table_stats.
+ */
+static size_t hash_table_pair_bytes(HashTable *ht, LinkedPair *pair)
+{
+  size_t bytes = sizeof(LinkedPair) + pair->inline_size;
+  if (pair->flags & LINKED_PAIR_TIMER)
+  {
+    bytes += sizeof(HashTableTimer);
+  }
+  if (!(pair->flags & LINKED_PAIR_KEY_INLINE) && ht->key_ownership != HASH_TABLE_BORROW)
+  {
+    bytes += pair->key_len + 1;
+  }
+  if (!(pair->flags & LINKED_PAIR_VALUE_INLINE) && ht->value_ownership != HASH_TABLE_BORROW)
+  {
+    bytes += pair->value_len + 1;
+  }
+  return bytes;
+}
+
+/*
+  Default TTL clock, milliseconds that never go backwards.
+ */
+static uint64_t hash_table_clock_ms(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*
+  Take a timer out of its wheel slot, if it is in one.
+ */
+static void hash_table_wheel_unlink(HashTableWheel *wheel, HashTableTimer *timer)
+{
+  if (timer->pprev == NULL)
+  {
+    return;
+  }
+  *timer->pprev = timer->next;
+  if (timer->next != NULL)
+  {
+    timer->next->pprev = timer->pprev;
+  }
+  if (wheel->slots[timer->level][timer->slot] == NULL)
+  {
+    wheel->occupied[timer->level] &= ~((uint64_t)1 << timer->slot);
+  }
+  timer->next = NULL;
+  timer->pprev = NULL;
+}
+
+// smallest timer map, the wheel starts with it and never shrinks below it
+#define HASH_TABLE_TIMER_MAP_MIN 16
+
+/*
+  Home slot of a pair in the wheel's timer map.
+ */
+static size_t hash_table_timer_home(HashTableWheel *wheel, const LinkedPair *pair)
+{
+  return (size_t)hash_wy_mix((uint64_t)(uintptr_t)pair, 0x9e3779b97f4a7c15ull) & (wheel->timer_capacity - 1);
+}
+
+/*
+  The timer of a pair with LINKED_PAIR_TIMER set.
+ */
+static HashTableTimer *hash_table_timer_find(HashTableWheel *wheel, const LinkedPair *pair)
+{
+  size_t mask = wheel->timer_capacity - 1;
+  size_t i = hash_table_timer_home(wheel, pair);
+  while (wheel->timers[i]->pair != pair)
+  {
+    i = (i + 1) & mask;
+  }
+  return wheel->timers[i];
+}
+
+static void hash_table_timer_place(HashTableWheel *wheel, HashTableTimer *timer)
+{
+  size_t mask = wheel->timer_capacity - 1;
+  size_t i = hash_table_timer_home(wheel, timer->pair);
+  while (wheel->timers[i] != NULL)
+  {
+    i = (i + 1) & mask;
+  }
+  wheel->timers[i] = timer;
+}
+
+static void hash_table_timer_map_resize(HashTableWheel *wheel, size_t capacity)
+{
+  HashTableTimer **old_timers = wheel->timers;
+  size_t old_capacity = wheel->timer_capacity;
+  wheel->timers = calloc(capacity, sizeof(HashTableTimer *));
+  wheel->timer_capacity = capacity;
+  for (size_t i = 0; i < old_capacity; i++)
+  {
+    if (old_timers[i] != NULL)
+    {
+      hash_table_timer_place(wheel, old_timers[i]);
+    }
+  }
+  free(old_timers);
+}
+
+/*
+  Map a new timer's pair to it, keeping the map at most half full.
+ */
+static void hash_table_timer_map_add(HashTableWheel *wheel, HashTableTimer *timer)
+{
+  if ((wheel->timer_count + 1) * 2 > wheel->timer_capacity)
+  {
+    hash_table_timer_map_resize(wheel, wheel->timer_capacity * 2);
+  }
+  hash_table_timer_place(wheel, timer);
+  wheel->timer_count++;
+}
+
+/*
+  Unmap a pair's timer. The entries after it in the run move back into
+  the hole unless that would put them before their home slot, so
+  lookups never need tombstones.
+ */
+static void hash_table_timer_map_remove(HashTableWheel *wheel, const LinkedPair *pair)
+{
+  size_t mask = wheel->timer_capacity - 1;
+  size_t hole = hash_table_timer_home(wheel, pair);
+  while (wheel->timers[hole]->pair != pair)
+  {
+    hole = (hole + 1) & mask;
+  }
+  for (size_t i = (hole + 1) & mask; wheel->timers[i] != NULL; i = (i + 1) & mask)
+  {
+    size_t home = hash_table_timer_home(wheel, wheel->timers[i]->pair);
+    if (((i - home) & mask) >= ((i - hole) & mask))
+    {
+      wheel->timers[hole] = wheel->timers[i];
+      hole = i;
+    }
+  }
+  wheel->timers[hole] = NULL;
+  wheel->timer_count--;
+  if (wheel->timer_capacity > HASH_TABLE_TIMER_MAP_MIN && wheel->timer_count * 8 < wheel->timer_capacity)
+  {
+    hash_table_timer_map_resize(wheel, wheel->timer_capacity / 2);
+  }
+}
+
+/*
+  Drop the TTL of a pair: its timer leaves the wheel and is freed.
+ */
+static void hash_table_cancel_timer(HashTable *ht, LinkedPair *pair)
+{
+  HashTableTimer *timer = hash_table_timer_find(ht->wheel, pair);
+  hash_table_wheel_unlink(ht->wheel, timer);
+  hash_table_timer_map_remove(ht->wheel, pair);
+  ht->node_allocator.free(ht->node_allocator.ctx, timer, sizeof(HashTableTimer));
+  pair->flags &= ~LINKED_PAIR_TIMER;
+}
+
+/*
+  Whether a pair's TTL ran out by now, in clock milliseconds. Expired
+  pairs stay in their chain until the timer wheel gets round to them,
+  so anything walking the chains has to skip them itself.
+ */
+int hash_table_pair_expired(HashTable *ht, LinkedPair *pair, uint64_t now)
+{
+  return (pair->flags & LINKED_PAIR_TIMER) && hash_table_timer_find(ht->wheel, pair)->expires <= now;
+}
+
 /*
   Use this function to safely destroy a hashtable pair.
  */
-void destroy_pair(LinkedPair *pair)
+void destroy_pair(HashTable *ht, LinkedPair *pair)
 {
   // if pair is not NULL
   if (pair != NULL)
   {
-    // free mem of pair key
-    free(pair->key);
-    // free mem of pair value
-    free(pair->value);
+    if (pair->flags & LINKED_PAIR_TIMER)
+    {
+      hash_table_cancel_timer(ht, pair);
+    }
+    // release pair key, unless it lives inside the pair
+    if (!(pair->flags & LINKED_PAIR_KEY_INLINE))
+    {
+      hash_table_release(ht, ht->key_ownership, pair->key, pair->key_len);
+    }
+    // release pair value, likewise
+    if (!(pair->flags & LINKED_PAIR_VALUE_INLINE))
+    {
+      hash_table_release(ht, ht->value_ownership, pair->value, pair->value_len);
+    }
     // free mem of pair
-    free(pair);
+    ht->node_allocator.free(ht->node_allocator.ctx, pair, sizeof(LinkedPair) + pair->inline_size);
   }
 }
 
@@ -92,189 +389,1427 @@ unsigned int hash(char *str, int max)
 }
 
 /*
-  Fill this in.
+  Full hash of len bytes of key, with the table's hash function and seed.
 
-  All values in storage should be initialized to NULL
+  The default is djb2 (`hash_djb2` in utils/hash.h), the same function as
+  `hash` above: capacities are powers of two, so masking the full hash
+  picks the same bucket as `hash(key, capacity)` would.
  */
-HashTable *create_hash_table(int capacity)
+static uint64_t hash_key(HashTable *ht, const void *key, size_t len)
 {
-  // from HashTable struct, create new ht pointer, allocate enough mem for hashtable type
-  HashTable *ht = malloc(sizeof(HashTable));
-  // assign int type capacity to capcity of ht struct
-  ht->capacity = capacity;
-  // use calloc an initialize allocated mem block to null
-  // pass in capacity as num of blocks, and linkedpair type pointer
-  ht->storage = calloc(capacity, sizeof(LinkedPair *));
-  // return new ht
-  return ht;
+  return ht->hash_function(key, len, ht->seed);
 }
 
 /*
-  Fill this in.
-
-  Inserting values to the same index with different keys should be
-  added to the corresponding LinkedPair list.
+  Reduce a full hash to a bucket of a power of two sized bucket array,
+  a mask instead of a divide.
+ */
+static unsigned int hash_index(uint64_t keyHash, int capacity)
+{
+  return (unsigned int)(keyHash & (uint64_t)(capacity - 1));
+}
 
-  Inserting values to the same index with existing keys can overwrite
-  the value in th existing LinkedPair list.
+/*
+  Capacities are rounded up to the next power of two.
  */
-void hash_table_insert(HashTable *ht, char *key, char *value)
+static int hash_table_round_capacity(int capacity)
 {
-  // assign hashIndex , two args, key, max (capacity)
-  unsigned int hashIndex = hash(key, ht->capacity);
-  // check if the bucket at that index is occupied, if something in bucket, linkedpair, if not null
-  // assign the current_pair pointer to storage at hash index
-  LinkedPair *current_pair = ht->storage[hashIndex];
-  // create pointer to last pair
-  LinkedPair *last_pair;
-  // if it is occupied, walk through the linkedpairs to see if you find a pair with same key
-  // due to the && wont do a string comparison if current pair is null,
-  // if current pair is not null, exits while loop right away
-  // check if current pair and key passed in is not same
-  while (current_pair != NULL && strcmp(current_pair->key, key) != 0)
-  {
-    // set last pair to current pair
-    last_pair = current_pair;
-    // set current pair to last pair next
-    current_pair = last_pair->next;
-  }
-  if (current_pair != NULL)
+  int rounded = 1;
+  while (rounded < capacity)
   {
-    // if current pair is occupied
-    current_pair->value = value;
+    rounded <<= 1;
   }
-  else
+  return rounded;
+}
+
+/*
+  Two keys are equal when their hashes, lengths and bytes all match. The
+  hash and length rule out almost every other pair in the chain before
+  any key memory is touched.
+ */
+static int pair_has_key(LinkedPair *pair, uint64_t keyHash, const void *key, size_t key_len)
+{
+  return pair->hash == keyHash && pair->key_len == key_len && memcmp(pair->key, key, key_len) == 0;
+}
+
+/*
+  Move every pair of a chain into the buckets of `storage`, relinking the
+  existing nodes. Nothing is copied or freed.
+ */
+static void hash_table_move_chain(HashTable *ht, LinkedPair *current_pair)
+{
+  while (current_pair != NULL)
   {
-    // if its not occupied, add a new linkedpair to bucket
-    LinkedPair *new_pair = create_pair(key, value);
-    // assign the storage at hash index to the new pair next
-    new_pair->next = ht->storage[hashIndex];
-    // assign the new pair to storage at hash index
-    ht->storage[hashIndex] = new_pair;
+    // remember the rest of the chain before we relink this pair
+    LinkedPair *next_pair = current_pair->next;
+    // the cached hash picks the new bucket, the key itself is never read
+    unsigned int hashIndex = hash_index(current_pair->hash, ht->capacity);
+    current_pair->next = ht->storage[hashIndex];
+    ht->storage[hashIndex] = current_pair;
+    current_pair = next_pair;
   }
 }
 
 /*
-  Fill this in.
+  Finish an incremental resize once every old bucket has been moved.
+ */
+static void hash_table_finish_rehash(HashTable *ht)
+{
+  free(ht->old_storage);
+  ht->old_storage = NULL;
+  ht->old_capacity = 0;
+  ht->rehash_index = 0;
+}
 
-  Should search the entire list of LinkedPairs for existing
-  keys and remove matching LinkedPairs safely.
+/*
+  Move up to HASH_TABLE_REHASH_STEP old buckets into the new storage.
 
-  Don't forget to free any malloc'ed memory!
+  Empty buckets are cheap to skip but still bounded, so a sparse old
+  array cannot turn one call into a full scan.
  */
-void hash_table_remove(HashTable *ht, char *key)
+static void hash_table_rehash_step(HashTable *ht)
 {
-  // assign hashIndex , two args, key, max (capacity)
-  unsigned int hashIndex = hash(key, ht->capacity);
-  // check if bucket at index is occupied, if it is it is a linkedpair, if not it is null
-  // assign current_pair pointer to storage at hash index
-  LinkedPair *current_pair = ht->storage[hashIndex];
-  // create pointer to last pair
-  LinkedPair *last_pair;
-  // if occupied, walk through until you find pair with same key,
-  while (current_pair != NULL && strcmp(current_pair->key, key) != 0)
+  int moved = 0;
+  int empty_visits = HASH_TABLE_REHASH_STEP * 10;
+  while (moved < HASH_TABLE_REHASH_STEP && ht->rehash_index < ht->old_capacity)
   {
-    // assign the storage at current hash index to the current pair next
-    ht->storage[hashIndex] = current_pair->next;
-    // set last pair to current pair
-    last_pair = current_pair;
-    // set current pair to last pair next
-    current_pair = last_pair->next;
+    LinkedPair *chain = ht->old_storage[ht->rehash_index];
+    if (chain == NULL && --empty_visits == 0)
+    {
+      break;
+    }
+    if (chain != NULL)
+    {
+      ht->old_storage[ht->rehash_index] = NULL;
+      hash_table_move_chain(ht, chain);
+      moved++;
+    }
+    ht->rehash_index++;
+  }
+  if (ht->rehash_index >= ht->old_capacity)
+  {
+    hash_table_finish_rehash(ht);
   }
-  // assign the last pair next to current pair next
-  last_pair->next = current_pair->next;
-  destroy_pair(ht->storage[hashIndex]);
-  // current_pair = NULL;
 }
 
 /*
-  Fill this in.
-
-  Should search the entire list of LinkedPairs for existing
-  keys.
-
-  Return NULL if the key is not found.
+  Called at the start of every keyed operation while an incremental resize
+  is running. Besides the bounded step, the old bucket the key would live
+  in is moved right away, so the operation itself only ever has to look
+  at the new storage.
  */
-char *hash_table_retrieve(HashTable *ht, char *key)
+static void hash_table_rehash_touch(HashTable *ht, uint64_t keyHash)
 {
-  // assign hashIndex , two args, key, max (capacity)
-  unsigned int hashIndex = hash(key, ht->capacity);
-  LinkedPair *current_pair = ht->storage[hashIndex];
-  LinkedPair *last_pair;
-  while (current_pair != NULL && strcmp(current_pair->key, key) != 0)
+  if (ht->old_storage == NULL)
   {
-    last_pair = current_pair;
-    current_pair = last_pair->next;
+    return;
   }
-  if (current_pair != NULL)
+  unsigned int oldIndex = hash_index(keyHash, ht->old_capacity);
+  LinkedPair *chain = ht->old_storage[oldIndex];
+  if (chain != NULL)
   {
-    return current_pair->value;
+    ht->old_storage[oldIndex] = NULL;
+    hash_table_move_chain(ht, chain);
   }
-  // if no value at storage at hash index, return null
-  return NULL;
+  hash_table_rehash_step(ht);
 }
 
 /*
-  Fill this in.
+  Relink every pair into a bucket array of new_capacity.
 
-  Don't forget to free any malloc'ed memory!
+  With incremental resize enabled, only the new bucket array is
+  allocated here. The old one is drained a few buckets at a time by the
+  following inserts, removes and retrieves.
  */
-void destroy_hash_table(HashTable *ht)
+static void hash_table_rehash_to(HashTable *ht, int new_capacity)
 {
-  // loop through capacity
-  for (int i = 0; i < ht->capacity; i++)
+  // a resize that is still running has to finish before the next one starts
+  while (ht->old_storage != NULL)
+  {
+    hash_table_rehash_step(ht);
+  }
+  HASH_TABLE_COUNT(ht, resizes);
+  // keep the current buckets around as the old storage
+  LinkedPair **old_storage = ht->storage;
+  int old_capacity = ht->capacity;
+  ht->capacity = new_capacity;
+  ht->storage = calloc(new_capacity, sizeof(LinkedPair *));
+  ht->old_storage = old_storage;
+  ht->old_capacity = old_capacity;
+  ht->rehash_index = 0;
+  if (!ht->incremental)
   {
-    // if storage at index i does not equal null
-    if (ht->storage[i] != NULL)
+    // stop-the-world: move every old bucket now
+    for (int i = 0; i < old_capacity; i++)
     {
-      // invoke destroy pair, pass in storage at index i
-      destroy_pair(ht->storage[i]);
+      hash_table_move_chain(ht, old_storage[i]);
     }
+    hash_table_finish_rehash(ht);
   }
-  // free ht storage
-  free(ht->storage);
-  // free ht
-  free(ht);
 }
 
 /*
-  Fill this in.
+  Free every pair in a bucket array, following each chain to its end.
 
-  Should create a new hash table with double the capacity
-  of the original and copy all elements into the new hash table.
-
-  Don't forget to free any malloc'ed memory!
+  When both allocators can release everything in one go, the chains are
+  not walked at all, the allocators are destroyed after this instead.
  */
-HashTable *hash_table_resize(HashTable *ht)
+static void hash_table_destroy_storage(HashTable *ht, LinkedPair **storage, int capacity)
 {
-  // create new hash table
-  HashTable *new_ht;
-  // allocate enough mem for new hash table
-  new_ht = malloc(sizeof(HashTable));
-  // capacity is double the size of ht capacity
-  new_ht->capacity = 2 * ht->capacity;
-  // pass in double ht capacity as num of blocks and linked pair type pointer
-  new_ht->storage = calloc(2 * ht->capacity, sizeof(LinkedPair *));
-  // loop through original capacity to store in new ht
-  for (int i = 0; i < ht->capacity; i++)
+  // moved keys and values still have to go through the destructor one by one
+  int bulk = ht->node_allocator.destroy != NULL && ht->bytes_allocator.destroy != NULL &&
+             ht->key_ownership != HASH_TABLE_MOVE && ht->value_ownership != HASH_TABLE_MOVE;
+  for (int i = 0; i < capacity && !bulk; i++)
   {
-    // assign Linkedpair current_pair pointer to storage at index i
-    LinkedPair *current_pair = ht->storage[i];
-    // loop while current pair exists, occupied
+    LinkedPair *current_pair = storage[i];
     while (current_pair != NULL)
     {
-      // invoke hash table insert function and pass in new hash table, key of current pair and value of current pair
-      hash_table_insert(new_ht, current_pair->key, current_pair->value);
-      // assign current pair next to current pair and continue loop
-      current_pair = current_pair->next;
+      LinkedPair *next_pair = current_pair->next;
+      destroy_pair(ht, current_pair);
+      current_pair = next_pair;
     }
   }
-  // free old ht storage
-  free(ht->storage);
-  // free old ht
-  free(ht);
+  free(storage);
+}
+
+/*
+  Release whatever the allocators still hold, for those that can.
+ */
+static void hash_table_destroy_allocators(HashTable *ht)
+{
+  if (ht->node_allocator.destroy != NULL)
+  {
+    ht->node_allocator.destroy(ht->node_allocator.ctx);
+  }
+  if (ht->bytes_allocator.destroy != NULL)
+  {
+    ht->bytes_allocator.destroy(ht->bytes_allocator.ctx);
+  }
+}
+
+/*
+  Fill this in.
+
+  All values in storage should be initialized to NULL
+ */
+HashTable *create_hash_table(int capacity)
+{
+  // from HashTable struct, create new ht pointer, allocate enough mem for hashtable type
+  HashTable *ht = malloc(sizeof(HashTable));
+  // assign int type capacity, rounded up to a power of two, to capcity of ht struct
+  ht->capacity = hash_table_round_capacity(capacity);
+  // use calloc an initialize allocated mem block to null
+  // pass in capacity as num of blocks, and linkedpair type pointer
+  ht->storage = calloc(ht->capacity, sizeof(LinkedPair *));
+  // the table starts empty and never shrinks below the size it was created with
+  ht->count = 0;
+  ht->initial_capacity = ht->capacity;
+  ht->max_load = HASH_TABLE_MAX_LOAD;
+  ht->min_load = HASH_TABLE_MIN_LOAD;
+  // djb2 until the caller picks another hash function
+  ht->hash_function = hash_djb2;
+  ht->seed = 0;
+  // pairs and strings come from malloc until the caller picks other allocators
+  ht->node_allocator = malloc_allocator();
+  ht->bytes_allocator = malloc_allocator();
+  // resizes are stop-the-world until the caller asks for incremental ones
+  ht->incremental = 0;
+  ht->old_capacity = 0;
+  ht->old_storage = NULL;
+  ht->rehash_index = 0;
+  memset(&ht->counters, 0, sizeof(ht->counters));
+  // keys and values are copied until the caller picks another ownership
+  ht->key_ownership = HASH_TABLE_COPY;
+  ht->value_ownership = HASH_TABLE_COPY;
+  ht->destructor = NULL;
+  ht->entry_bytes = 0;
+  ht->cache_bytes = 0;
+  ht->clock_hand = 0;
+  // no TTLs until the first hash_table_insert_ttl
+  ht->wheel = NULL;
+  ht->clock = hash_table_clock_ms;
   // return new ht
-  return new_ht;
+  return ht;
+}
+
+/*
+  Free a pair already unlinked from its chain, and shrink the table if
+  that left it too empty.
+ */
+static void hash_table_drop_pair(HashTable *ht, LinkedPair *pair)
+{
+  ht->entry_bytes -= hash_table_pair_bytes(ht, pair);
+  destroy_pair(ht, pair);
+  ht->count--;
+  // halve the table once it gets too empty, halving leaves it at twice
+  // min_load which is still well below max_load, so it cannot thrash
+  if (ht->min_load > 0 && ht->capacity / 2 >= ht->initial_capacity && ht->count < ht->capacity * ht->min_load)
+  {
+    hash_table_rehash_to(ht, ht->capacity / 2);
+  }
+}
+
+/*
+  Unlink a pair from whichever chain holds it, the new storage or, while
+  a resize is running, the old one.
+ */
+static void hash_table_unlink_pair(HashTable *ht, LinkedPair *pair)
+{
+  LinkedPair **link = &ht->storage[hash_index(pair->hash, ht->capacity)];
+  while (*link != NULL && *link != pair)
+  {
+    link = &(*link)->next;
+  }
+  if (*link == NULL && ht->old_storage != NULL)
+  {
+    link = &ht->old_storage[hash_index(pair->hash, ht->old_capacity)];
+    while (*link != pair)
+    {
+      link = &(*link)->next;
+    }
+  }
+  *link = pair->next;
+}
+
+/*
+  Put a timer into the wheel, counting from tick from: level l takes
+  timers due 64^l to 64^(l+1) ticks away, in the slot of the tick it is
+  due. Timers already due go into the slot of tick from itself, and
+  timers further away than the top level reaches wait in its last slot
+  to be put back further down when it comes round.
+ */
+static void hash_table_wheel_add(HashTableWheel *wheel, HashTableTimer *timer, uint64_t from)
+{
+  uint64_t when = timer->expires > from ? timer->expires : from;
+  int level = 0;
+  while (level < HASH_TABLE_WHEEL_LEVELS - 1 && when - from >= (uint64_t)1 << (6 * (level + 1)))
+  {
+    level++;
+  }
+  if (when - from >= (uint64_t)1 << (6 * HASH_TABLE_WHEEL_LEVELS))
+  {
+    when = from + ((uint64_t)1 << (6 * HASH_TABLE_WHEEL_LEVELS)) - 1;
+  }
+  int slot = (when >> (6 * level)) & (HASH_TABLE_WHEEL_SLOTS - 1);
+  HashTableTimer **head = &wheel->slots[level][slot];
+  timer->level = level;
+  timer->slot = slot;
+  timer->next = *head;
+  timer->pprev = head;
+  if (*head != NULL)
+  {
+    (*head)->pprev = &timer->next;
+  }
+  *head = timer;
+  wheel->occupied[level] |= (uint64_t)1 << slot;
+}
+
+/*
+  The first tick after now at which some occupied slot comes round, or
+  target if that is sooner. Ticks in between have nothing to do and are
+  skipped, however long the table sat idle.
+ */
+static uint64_t hash_table_wheel_next(HashTableWheel *wheel, uint64_t target)
+{
+  uint64_t next = target;
+  for (int level = 0; level < HASH_TABLE_WHEEL_LEVELS; level++)
+  {
+    if (wheel->occupied[level] == 0)
+    {
+      continue;
+    }
+    int shift = 6 * level;
+    uint64_t base = wheel->now >> shift;
+    // rotate so bit 0 is the slot after the current one
+    unsigned int rotate = (base + 1) & (HASH_TABLE_WHEEL_SLOTS - 1);
+    uint64_t bits = rotate == 0 ? wheel->occupied[level] : (wheel->occupied[level] >> rotate) | (wheel->occupied[level] << (64 - rotate));
+    uint64_t tick = (base + 1 + __builtin_ctzll(bits)) << shift;
+    if (tick < next)
+    {
+      next = tick;
+    }
+  }
+  return next;
+}
+
+/*
+  Run the wheel up to tick target: at every tick with work, slots of the
+  upper levels that come round move their timers further down, then the
+  level 0 slot of the tick expires its pairs.
+
+  Stops after HASH_TABLE_EXPIRE_BATCH expirations, at the tick it was
+  on. The next call does that tick again, which only moves timers that
+  are already in the right place back into it.
+ */
+static void hash_table_wheel_advance(HashTable *ht, uint64_t target)
+{
+  HashTableWheel *wheel = ht->wheel;
+  int expired = 0;
+  while (wheel->now < target)
+  {
+    uint64_t tick = hash_table_wheel_next(wheel, target);
+    wheel->now = tick;
+    for (int level = HASH_TABLE_WHEEL_LEVELS - 1; level > 0; level--)
+    {
+      int shift = 6 * level;
+      if ((tick & (((uint64_t)1 << shift) - 1)) != 0)
+      {
+        continue;
+      }
+      int slot = (tick >> shift) & (HASH_TABLE_WHEEL_SLOTS - 1);
+      HashTableTimer *timer = wheel->slots[level][slot];
+      wheel->slots[level][slot] = NULL;
+      wheel->occupied[level] &= ~((uint64_t)1 << slot);
+      while (timer != NULL)
+      {
+        HashTableTimer *next_timer = timer->next;
+        hash_table_wheel_add(wheel, timer, tick);
+        timer = next_timer;
+      }
+    }
+    HashTableTimer **head = &wheel->slots[0][tick & (HASH_TABLE_WHEEL_SLOTS - 1)];
+    while (*head != NULL)
+    {
+      if (expired == HASH_TABLE_EXPIRE_BATCH)
+      {
+        wheel->now = tick - 1;
+        return;
+      }
+      LinkedPair *pair = (*head)->pair;
+      hash_table_unlink_pair(ht, pair);
+      hash_table_drop_pair(ht, pair);
+      HASH_TABLE_COUNT(ht, expirations);
+      expired++;
+    }
+  }
+}
+
+/*
+  Bring the wheel up to the clock, once at the start of every insert,
+  remove and retrieve. Returns the clock, or 0 if no pair ever had a TTL.
+ */
+static uint64_t hash_table_expire_tick(HashTable *ht)
+{
+  if (ht->wheel == NULL)
+  {
+    return 0;
+  }
+  uint64_t now = ht->clock();
+  hash_table_wheel_advance(ht, now);
+  return now;
+}
+
+/*
+  Mark a pair as used for the CLOCK hand. Only in cache mode, and only
+  when the bit is not set yet, so repeated hits read the pair without
+  writing it.
+ */
+static void hash_table_reference(HashTable *ht, LinkedPair *pair)
+{
+  if (ht->cache_bytes > 0 && !(pair->flags & LINKED_PAIR_REFERENCED))
+  {
+    pair->flags |= LINKED_PAIR_REFERENCED;
+  }
+}
+
+/*
+  Evict pairs until entry_bytes fits in cache_bytes, never evicting keep.
+
+  CLOCK over the buckets: the hand moves a bucket at a time, a pair hit
+  since the hand last passed loses its referenced bit and stays, any
+  other pair is evicted. The hand stops as soon as the pairs fit, so a
+  pair is only evicted once every newer hit had a chance to save it.
+ */
+static void hash_table_evict(HashTable *ht, LinkedPair *keep)
+{
+  // the hand only sweeps storage, so a running resize is finished first
+  while (ht->old_storage != NULL)
+  {
+    hash_table_rehash_step(ht);
+  }
+  while (ht->entry_bytes > ht->cache_bytes && ht->count > (keep != NULL ? 1 : 0))
+  {
+    int bucket = ht->clock_hand & (ht->capacity - 1);
+    LinkedPair **link = &ht->storage[bucket];
+    while (*link != NULL && ht->entry_bytes > ht->cache_bytes)
+    {
+      LinkedPair *current_pair = *link;
+      if (current_pair == keep || current_pair->flags & LINKED_PAIR_REFERENCED)
+      {
+        current_pair->flags &= ~LINKED_PAIR_REFERENCED;
+        link = &current_pair->next;
+        continue;
+      }
+      *link = current_pair->next;
+      ht->entry_bytes -= hash_table_pair_bytes(ht, current_pair);
+      destroy_pair(ht, current_pair);
+      ht->count--;
+      HASH_TABLE_COUNT(ht, evictions);
+    }
+    ht->clock_hand = (bucket + 1) & (ht->capacity - 1);
+  }
+}
+
+/*
+  Insert a key whose full hash the caller already computed. Returns the
+  pair now holding the key. A TTL it had is kept, callers decide.
+ */
+static LinkedPair *hash_table_insert_hashed(HashTable *ht, uint64_t keyHash, const void *key, size_t key_len, const void *value, size_t value_len)
+{
+  hash_table_expire_tick(ht);
+  // move a little more of a running resize along, including this key's old bucket
+  hash_table_rehash_touch(ht, keyHash);
+  // reduce the hash to the bucket index
+  unsigned int hashIndex = hash_index(keyHash, ht->capacity);
+  // check if the bucket at that index is occupied, if something in bucket, linkedpair, if not null
+  // assign the current_pair pointer to storage at hash index
+  LinkedPair *current_pair = ht->storage[hashIndex];
+  // create pointer to last pair
+  LinkedPair *last_pair;
+  // if it is occupied, walk through the linkedpairs to see if you find a pair with same key
+  // due to the && wont do a string comparison if current pair is null,
+  // if current pair is not null, exits while loop right away
+  // check if current pair and key passed in is not same
+  while (current_pair != NULL && !pair_has_key(current_pair, keyHash, key, key_len))
+  {
+    // set last pair to current pair
+    last_pair = current_pair;
+    // set current pair to last pair next
+    current_pair = last_pair->next;
+  }
+  if (current_pair != NULL)
+  {
+    // if current pair is occupied, replace its value with the new one
+    ht->entry_bytes -= hash_table_pair_bytes(ht, current_pair);
+    hash_table_set_value(ht, current_pair, value, value_len);
+    ht->entry_bytes += hash_table_pair_bytes(ht, current_pair);
+    hash_table_reference(ht, current_pair);
+    // the pair keeps its own key, a key moved in with this insert is not needed
+    if (ht->key_ownership == HASH_TABLE_MOVE)
+    {
+      hash_table_release(ht, HASH_TABLE_MOVE, (char *)key, key_len);
+    }
+    HASH_TABLE_COUNT(ht, overwrites);
+    // a bigger value can push a cache over its budget as well
+    if (ht->cache_bytes > 0 && ht->entry_bytes > ht->cache_bytes)
+    {
+      hash_table_evict(ht, current_pair);
+    }
+    return current_pair;
+  }
+  else
+  {
+    // if its not occupied, add a new linkedpair to bucket
+    LinkedPair *new_pair = create_pair(ht, key, key_len, value, value_len);
+    // cache the full hash so later compares and resizes can skip the key
+    new_pair->hash = keyHash;
+    // assign the storage at hash index to the new pair next
+    new_pair->next = ht->storage[hashIndex];
+    // assign the new pair to storage at hash index
+    ht->storage[hashIndex] = new_pair;
+    ht->count++;
+    ht->entry_bytes += hash_table_pair_bytes(ht, new_pair);
+    HASH_TABLE_COUNT(ht, inserts);
+    // a cache makes room by evicting, before the table thinks about growing
+    if (ht->cache_bytes > 0 && ht->entry_bytes > ht->cache_bytes)
+    {
+      hash_table_evict(ht, new_pair);
+    }
+    // double the table once it gets too full
+    if (ht->max_load > 0 && ht->count > ht->capacity * ht->max_load)
+    {
+      hash_table_rehash_to(ht, ht->capacity * 2);
+    }
+    return new_pair;
+  }
+}
+
+/*
+  A plain insert over a key with a TTL makes it permanent again.
+ */
+static void hash_table_clear_ttl(HashTable *ht, LinkedPair *pair)
+{
+  if (pair->flags & LINKED_PAIR_TIMER)
+  {
+    ht->entry_bytes -= sizeof(HashTableTimer);
+    hash_table_cancel_timer(ht, pair);
+  }
+}
+
+/*
+  Fill this in.
+
+  Inserting values to the same index with different keys should be
+  added to the corresponding LinkedPair list.
+
+  Inserting values to the same index with existing keys can overwrite
+  the value in th existing LinkedPair list.
+ */
+void hash_table_insert(HashTable *ht, char *key, char *value)
+{
+  hash_table_insert_bytes(ht, key, strlen(key), value, strlen(value));
+}
+
+/*
+  Insert key_len bytes of key with value_len bytes of value.
+
+  Keys are compared by length and bytes, so they can hold any binary
+  data, NUL bytes included. Both are copied into the table, unless
+  `hash_table_set_ownership` said otherwise.
+ */
+void hash_table_insert_bytes(HashTable *ht, const void *key, size_t key_len, const void *value, size_t value_len)
+{
+  // hash the key once, the full hash is compared and cached along the way
+  hash_table_insert_prehashed(ht, hash_key(ht, key, key_len), key, key_len, value, value_len);
+}
+
+/*
+  hash_table_insert_bytes for a caller that already has the key's full
+  hash, from the table's hash function and seed. Front ends that hash
+  the key for their own purposes, like picking a shard, pass it on
+  instead of having the table hash it again.
+ */
+void hash_table_insert_prehashed(HashTable *ht, uint64_t keyHash, const void *key, size_t key_len, const void *value, size_t value_len)
+{
+  LinkedPair *pair = hash_table_insert_hashed(ht, keyHash, key, key_len, value, value_len);
+  hash_table_clear_ttl(ht, pair);
+}
+
+/*
+  Insert key with value like hash_table_insert, and have the pair expire
+  ttl milliseconds from now. Inserting the key again replaces the TTL,
+  with hash_table_insert it is dropped.
+
+  Expired pairs are never returned. They are reclaimed by a timer wheel
+  that every insert, remove and retrieve moves up to the clock, a few
+  at a time, so no operation ever sweeps the whole table.
+ */
+void hash_table_insert_ttl(HashTable *ht, char *key, char *value, uint64_t ttl)
+{
+  if (ht->wheel == NULL)
+  {
+    ht->wheel = calloc(1, sizeof(HashTableWheel));
+    ht->wheel->now = ht->clock();
+    ht->wheel->timers = calloc(HASH_TABLE_TIMER_MAP_MIN, sizeof(HashTableTimer *));
+    ht->wheel->timer_capacity = HASH_TABLE_TIMER_MAP_MIN;
+  }
+  size_t key_len = strlen(key);
+  LinkedPair *pair = hash_table_insert_hashed(ht, hash_key(ht, key, key_len), key, key_len, value, strlen(value));
+  HashTableTimer *timer;
+  if (pair->flags & LINKED_PAIR_TIMER)
+  {
+    timer = hash_table_timer_find(ht->wheel, pair);
+    hash_table_wheel_unlink(ht->wheel, timer);
+  }
+  else
+  {
+    timer = ht->node_allocator.alloc(ht->node_allocator.ctx, sizeof(HashTableTimer));
+    timer->pair = pair;
+    timer->pprev = NULL;
+    hash_table_timer_map_add(ht->wheel, timer);
+    pair->flags |= LINKED_PAIR_TIMER;
+    ht->entry_bytes += sizeof(HashTableTimer);
+  }
+  timer->expires = ht->clock() + ttl;
+  hash_table_wheel_add(ht->wheel, timer, ht->wheel->now + 1);
+  // the timer's bytes may push a cache over its budget, the pair itself stays
+  if (ht->cache_bytes > 0 && ht->entry_bytes > ht->cache_bytes)
+  {
+    hash_table_evict(ht, pair);
+  }
+}
+
+/*
+  Fill this in.
+
+  Should search the entire list of LinkedPairs for existing
+  keys and remove matching LinkedPairs safely.
+
+  Don't forget to free any malloc'ed memory!
+ */
+void hash_table_remove(HashTable *ht, char *key)
+{
+  hash_table_remove_bytes(ht, key, strlen(key));
+}
+
+/*
+  Remove the pair whose key is the key_len bytes at key, if there is one.
+ */
+void hash_table_remove_bytes(HashTable *ht, const void *key, size_t key_len)
+{
+  // hash the key once, the full hash is compared and cached along the way
+  hash_table_remove_prehashed(ht, hash_key(ht, key, key_len), key, key_len);
+}
+
+/*
+  hash_table_remove_bytes with the key's full hash, as
+  hash_table_insert_prehashed.
+ */
+void hash_table_remove_prehashed(HashTable *ht, uint64_t keyHash, const void *key, size_t key_len)
+{
+  hash_table_expire_tick(ht);
+  // move a little more of a running resize along, including this key's old bucket
+  hash_table_rehash_touch(ht, keyHash);
+  // reduce the hash to the bucket index
+  unsigned int hashIndex = hash_index(keyHash, ht->capacity);
+  // check if bucket at index is occupied, if it is it is a linkedpair, if not it is null
+  // assign current_pair pointer to storage at hash index
+  LinkedPair *current_pair = ht->storage[hashIndex];
+  // create pointer to last pair, NULL while we are still at the head of the bucket
+  LinkedPair *last_pair = NULL;
+  // if occupied, walk through until you find pair with same key,
+  while (current_pair != NULL && !pair_has_key(current_pair, keyHash, key, key_len))
+  {
+    // set last pair to current pair
+    last_pair = current_pair;
+    // set current pair to last pair next
+    current_pair = last_pair->next;
+  }
+  // if we walked off the end of the list, the key is not in the table
+  if (current_pair == NULL)
+  {
+    return;
+  }
+  if (last_pair == NULL)
+  {
+    // removing the head of the bucket, point the bucket at the next pair
+    ht->storage[hashIndex] = current_pair->next;
+  }
+  else
+  {
+    // unlink the current pair by pointing the last pair past it
+    last_pair->next = current_pair->next;
+  }
+  HASH_TABLE_COUNT(ht, removes);
+  // free the unlinked pair
+  hash_table_drop_pair(ht, current_pair);
+}
+
+/*
+  Fill this in.
+
+  Should search the entire list of LinkedPairs for existing
+  keys.
+
+  Return NULL if the key is not found.
+ */
+char *hash_table_retrieve(HashTable *ht, char *key)
+{
+  return hash_table_retrieve_bytes(ht, key, strlen(key), NULL);
+}
+
+/*
+  Return the value stored under the key_len bytes at key, or NULL if the
+  key is not found. When value_len is not NULL it is set to the length
+  of the value. The value is always followed by a NUL byte.
+ */
+void *hash_table_retrieve_bytes(HashTable *ht, const void *key, size_t key_len, size_t *value_len)
+{
+  // hash the key once, the full hash is compared and cached along the way
+  return hash_table_retrieve_prehashed(ht, hash_key(ht, key, key_len), key, key_len, value_len);
+}
+
+/*
+  hash_table_retrieve_bytes with the key's full hash, as
+  hash_table_insert_prehashed.
+ */
+void *hash_table_retrieve_prehashed(HashTable *ht, uint64_t keyHash, const void *key, size_t key_len, size_t *value_len)
+{
+  uint64_t now = hash_table_expire_tick(ht);
+  // move a little more of a running resize along, including this key's old bucket
+  hash_table_rehash_touch(ht, keyHash);
+  // reduce the hash to the bucket index
+  unsigned int hashIndex = hash_index(keyHash, ht->capacity);
+  LinkedPair *current_pair = ht->storage[hashIndex];
+  LinkedPair *last_pair;
+  while (current_pair != NULL && !pair_has_key(current_pair, keyHash, key, key_len))
+  {
+    last_pair = current_pair;
+    current_pair = last_pair->next;
+  }
+  if (current_pair != NULL && !hash_table_pair_expired(ht, current_pair, now))
+  {
+    HASH_TABLE_COUNT(ht, hits);
+    hash_table_reference(ht, current_pair);
+    if (value_len != NULL)
+    {
+      *value_len = current_pair->value_len;
+    }
+    return current_pair->value;
+  }
+  HASH_TABLE_COUNT(ht, misses);
+  // if no value at storage at hash index, return null
+  return NULL;
+}
+
+/*
+  Look up n keys at once, storing the value of keys[i] (or NULL) in
+  out_values[i].
+
+  A serial lookup waits on a cache miss for the bucket head and then on
+  another for the first pair before it can compare anything. Here each
+  group of keys is hashed first and the bucket heads prefetched, then
+  the first pairs are prefetched, and only then are the chains compared,
+  so the misses of independent keys overlap instead of queuing up.
+ */
+void hash_table_retrieve_batch(HashTable *ht, char **keys, int n, char **out_values)
+{
+  uint64_t hashes[HASH_TABLE_BATCH];
+  size_t lengths[HASH_TABLE_BATCH];
+  LinkedPair *heads[HASH_TABLE_BATCH];
+  // expire once up front, expiring in the middle could move the buckets
+  uint64_t now = hash_table_expire_tick(ht);
+  for (int start = 0; start < n; start += HASH_TABLE_BATCH)
+  {
+    int batch = n - start < HASH_TABLE_BATCH ? n - start : HASH_TABLE_BATCH;
+    // hash every key and prefetch its bucket head
+    for (int i = 0; i < batch; i++)
+    {
+      lengths[i] = strlen(keys[start + i]);
+      hashes[i] = hash_key(ht, keys[start + i], lengths[i]);
+      // capacity only changes on inserts and removes, so the buckets stay put
+      hash_table_rehash_touch(ht, hashes[i]);
+      __builtin_prefetch(&ht->storage[hash_index(hashes[i], ht->capacity)]);
+    }
+    // load the bucket heads and prefetch the first pair of each chain
+    for (int i = 0; i < batch; i++)
+    {
+      heads[i] = ht->storage[hash_index(hashes[i], ht->capacity)];
+      if (heads[i] != NULL)
+      {
+        __builtin_prefetch(heads[i]);
+      }
+    }
+    // walk and compare
+    for (int i = 0; i < batch; i++)
+    {
+      LinkedPair *current_pair = heads[i];
+      while (current_pair != NULL && !pair_has_key(current_pair, hashes[i], keys[start + i], lengths[i]))
+      {
+        current_pair = current_pair->next;
+      }
+      if (current_pair != NULL && !hash_table_pair_expired(ht, current_pair, now))
+      {
+        HASH_TABLE_COUNT(ht, hits);
+        hash_table_reference(ht, current_pair);
+        out_values[start + i] = current_pair->value;
+      }
+      else
+      {
+        HASH_TABLE_COUNT(ht, misses);
+        out_values[start + i] = NULL;
+      }
+    }
+  }
+}
+
+/*
+  Insert n pairs at once, keys[i] with values[i], in order.
+
+  Keys are hashed and their bucket heads and first pairs prefetched a
+  group at a time before any of them is inserted, as in
+  hash_table_retrieve_batch. An insert that grows the table moves the
+  buckets, the prefetches for the rest of the group are then wasted but
+  the inserts still land in the right place.
+ */
+void hash_table_insert_batch(HashTable *ht, char **keys, char **values, int n)
+{
+  uint64_t hashes[HASH_TABLE_BATCH];
+  size_t lengths[HASH_TABLE_BATCH];
+  for (int start = 0; start < n; start += HASH_TABLE_BATCH)
+  {
+    int batch = n - start < HASH_TABLE_BATCH ? n - start : HASH_TABLE_BATCH;
+    for (int i = 0; i < batch; i++)
+    {
+      lengths[i] = strlen(keys[start + i]);
+      hashes[i] = hash_key(ht, keys[start + i], lengths[i]);
+      __builtin_prefetch(&ht->storage[hash_index(hashes[i], ht->capacity)], 1);
+    }
+    for (int i = 0; i < batch; i++)
+    {
+      LinkedPair *head = ht->storage[hash_index(hashes[i], ht->capacity)];
+      if (head != NULL)
+      {
+        __builtin_prefetch(head);
+      }
+    }
+    for (int i = 0; i < batch; i++)
+    {
+      LinkedPair *pair = hash_table_insert_hashed(ht, hashes[i], keys[start + i], lengths[i], values[start + i], strlen(values[start + i]));
+      hash_table_clear_ttl(ht, pair);
+    }
+  }
+}
+
+/*
+  Fill this in.
+
+  Don't forget to free any malloc'ed memory!
+ */
+void destroy_hash_table(HashTable *ht)
+{
+  // free the timers first, an arena teardown would skip their pairs
+  for (int level = 0; ht->wheel != NULL && level < HASH_TABLE_WHEEL_LEVELS; level++)
+  {
+    for (int slot = 0; slot < HASH_TABLE_WHEEL_SLOTS; slot++)
+    {
+      while (ht->wheel->slots[level][slot] != NULL)
+      {
+        hash_table_cancel_timer(ht, ht->wheel->slots[level][slot]->pair);
+      }
+    }
+  }
+  if (ht->wheel != NULL)
+  {
+    free(ht->wheel->timers);
+    free(ht->wheel);
+  }
+  // free every chain in the storage, and in the old storage if a resize is running
+  hash_table_destroy_storage(ht, ht->storage, ht->capacity);
+  if (ht->old_storage != NULL)
+  {
+    hash_table_destroy_storage(ht, ht->old_storage, ht->old_capacity);
+  }
+  hash_table_destroy_allocators(ht);
+  // free ht
+  free(ht);
+}
+
+/*
+  Fill this in.
+
+  Should create a new hash table with double the capacity
+  of the original and copy all elements into the new hash table.
+
+  Don't forget to free any malloc'ed memory!
+
+  The table is resized in place: the existing pairs are relinked into a
+  bucket array of double the capacity and the same pointer is returned.
+  Inserts already do this on their own once the table passes max_load.
+ */
+HashTable *hash_table_resize(HashTable *ht)
+{
+  hash_table_rehash_to(ht, 2 * ht->capacity);
+  // return the resized ht
+  return ht;
+}
+
+/*
+  Change the load factors that trigger automatic resizes. A max_load or
+  min_load of 0 turns growing or shrinking off.
+
+  min_load has to stay under half of max_load, otherwise a shrink lands
+  the table right back above max_load and every insert/remove pair
+  resizes twice. Returns 0, or -1 and leaves the load factors alone if
+  either is negative or they are that close.
+ */
+int hash_table_set_load_factors(HashTable *ht, double max_load, double min_load)
+{
+  // written so NaN fails too
+  if (!(max_load >= 0) || !(min_load >= 0) || (max_load > 0 && !(min_load < max_load / 2)))
+  {
+    return -1;
+  }
+  ht->max_load = max_load;
+  ht->min_load = min_load;
+  return 0;
+}
+
+/*
+  Hash keys with hash_function keyed by seed, for example `hash_wyhash`
+  with `hash_random_seed()` from utils/hash.h.
+
+  Pairs already in the table are re-hashed and moved to their new buckets.
+ */
+void hash_table_set_hash_function(HashTable *ht, HashFunction hash_function, uint64_t seed)
+{
+  ht->hash_function = hash_function;
+  ht->seed = seed;
+  // no pair may be left in an old bucket array, it was placed with the old hash
+  while (ht->old_storage != NULL)
+  {
+    hash_table_rehash_step(ht);
+  }
+  for (int i = 0; i < ht->capacity; i++)
+  {
+    for (LinkedPair *pair = ht->storage[i]; pair != NULL; pair = pair->next)
+    {
+      pair->hash = hash_key(ht, pair->key, pair->key_len);
+    }
+  }
+  // the buckets no longer match the hashes, so this one move cannot be incremental
+  int incremental = ht->incremental;
+  ht->incremental = 0;
+  hash_table_rehash_to(ht, ht->capacity);
+  ht->incremental = incremental;
+}
+
+/*
+  Allocate pairs from node_allocator and key/value copies from
+  bytes_allocator. The table takes over both and destroys them along
+  with itself.
+
+  Only call this on an empty table, pairs that already exist were
+  allocated by the previous allocators, which are destroyed here.
+ */
+void hash_table_set_allocators(HashTable *ht, Allocator node_allocator, Allocator bytes_allocator)
+{
+  hash_table_destroy_allocators(ht);
+  ht->node_allocator = node_allocator;
+  ht->bytes_allocator = bytes_allocator;
+}
+
+/*
+  Give the table a slab for its pairs and an arena for its strings.
+
+  Pairs are allocated side by side, so the nodes of one chain tend to
+  share cache lines, removed pairs and strings are reused by later
+  inserts, and destroy_hash_table releases everything without walking
+  a single chain. Only call this on an empty table.
+ */
+void hash_table_use_arena(HashTable *ht)
+{
+  hash_table_set_allocators(ht, arena_allocator(), arena_allocator());
+}
+
+/*
+  Turn the table into a cache holding at most max_bytes of pairs, as
+  counted in entry_bytes, or back into a plain table with 0. Pairs over
+  the budget are evicted right away.
+
+  Inserts past the budget evict pairs not hit lately, by CLOCK (see
+  hash_table_evict). Recency is one bit in the pair, which a hit only
+  writes when it is not set yet, so there is no list to update and
+  lookups cost about what they do without a cache. The one pair never evicted is the one just inserted,
+  so a single pair bigger than the budget stays until the next insert.
+
+  Lookups set that bit, so in cache mode even they need the table to
+  themselves, like any write.
+ */
+void hash_table_set_cache(HashTable *ht, size_t max_bytes)
+{
+  ht->cache_bytes = max_bytes;
+  if (ht->cache_bytes > 0 && ht->entry_bytes > ht->cache_bytes)
+  {
+    hash_table_evict(ht, NULL);
+  }
+}
+
+/*
+  Use clock instead of the monotonic clock for TTLs, e.g. a cached or a
+  simulated one. Set it before the first hash_table_insert_ttl.
+ */
+void hash_table_set_clock(HashTable *ht, HashTableClock clock)
+{
+  ht->clock = clock;
+}
+
+/*
+  Choose who owns the keys and values handed to inserts:
+
+    HASH_TABLE_COPY    the table copies them (the default)
+    HASH_TABLE_BORROW  the table keeps the caller's pointers and never
+                       frees them, they must outlive their pairs
+    HASH_TABLE_MOVE    the table keeps the caller's pointers and calls
+                       destructor(bytes, len) once it is done with them:
+                       on overwrite, remove and destroy, and right away
+                       for a key that was already in the table
+
+  Borrowed and moved bytes are handed back by retrieve as they were
+  given, so they are only NUL terminated if the caller made them so.
+
+  Only call this on an empty table, existing pairs would be released as
+  if they had been inserted under the new modes.
+ */
+void hash_table_set_ownership(HashTable *ht, HashTableOwnership key_ownership, HashTableOwnership value_ownership, HashTableDestructor destructor)
+{
+  ht->key_ownership = key_ownership;
+  ht->value_ownership = value_ownership;
+  ht->destructor = destructor;
+}
+
+/*
+  Switch between stop-the-world and incremental resizes.
+
+  Turning incremental resizes off finishes any resize that is running.
+ */
+void hash_table_set_incremental_resize(HashTable *ht, int enabled)
+{
+  ht->incremental = enabled;
+  while (!enabled && ht->old_storage != NULL)
+  {
+    hash_table_rehash_step(ht);
+  }
+}
+
+/*
+  State shared by the threads of hash_table_build. Thread t reads the
+  input slice [t * n / threads, (t + 1) * n / threads) in the first two
+  passes and owns partition t of the buckets in the last one.
+
+  `counts[t * threads + p]` starts as the number of pairs in slice t
+  that hash into partition p and is turned into the position where
+  slice t writes its first partition p pair into `order`.
+ */
+typedef struct HashTableBuild {
+  HashTable *ht;
+  HashTablePair *pairs;
+  int n;
+  int threads;
+  uint64_t *hashes;
+  int *order;
+  int *counts;
+  int *partition_start;
+} HashTableBuild;
+
+typedef struct HashTableBuildWorker {
+  HashTableBuild *build;
+  int id;
+  int count;
+  size_t bytes;
+} HashTableBuildWorker;
+
+/*
+  Partitions are contiguous ranges of buckets, so a thread building one
+  never touches a bucket another thread builds.
+ */
+static int hash_table_build_partition(HashTableBuild *build, uint64_t keyHash)
+{
+  return (int)(((uint64_t)hash_index(keyHash, build->ht->capacity) * build->threads) / build->ht->capacity);
+}
+
+/*
+  Pass one: hash this thread's slice and count it per partition.
+ */
+static void *hash_table_build_hash(void *arg)
+{
+  HashTableBuildWorker *worker = arg;
+  HashTableBuild *build = worker->build;
+  int *counts = &build->counts[worker->id * build->threads];
+  int end = (int)((long)build->n * (worker->id + 1) / build->threads);
+  for (int i = (int)((long)build->n * worker->id / build->threads); i < end; i++)
+  {
+    char *key = build->pairs[i].key;
+    build->hashes[i] = hash_key(build->ht, key, strlen(key));
+    counts[hash_table_build_partition(build, build->hashes[i])]++;
+  }
+  return NULL;
+}
+
+/*
+  Pass two: write this thread's slice into `order`, grouped by
+  partition. Slices are written in order, so every partition keeps the
+  pairs in input order.
+ */
+static void *hash_table_build_scatter(void *arg)
+{
+  HashTableBuildWorker *worker = arg;
+  HashTableBuild *build = worker->build;
+  int *positions = &build->counts[worker->id * build->threads];
+  int end = (int)((long)build->n * (worker->id + 1) / build->threads);
+  for (int i = (int)((long)build->n * worker->id / build->threads); i < end; i++)
+  {
+    build->order[positions[hash_table_build_partition(build, build->hashes[i])]++] = i;
+  }
+  return NULL;
+}
+
+/*
+  Pass three: link the pairs of this thread's partition into their
+  buckets. A key given more than once keeps its last value, as it would
+  with repeated inserts.
+ */
+static void *hash_table_build_link(void *arg)
+{
+  HashTableBuildWorker *worker = arg;
+  HashTableBuild *build = worker->build;
+  HashTable *ht = build->ht;
+  for (int k = build->partition_start[worker->id]; k < build->partition_start[worker->id + 1]; k++)
+  {
+    int i = build->order[k];
+    uint64_t keyHash = build->hashes[i];
+    char *key = build->pairs[i].key;
+    char *value = build->pairs[i].value;
+    size_t key_len = strlen(key);
+    unsigned int hashIndex = hash_index(keyHash, ht->capacity);
+    LinkedPair *current_pair = ht->storage[hashIndex];
+    while (current_pair != NULL && !pair_has_key(current_pair, keyHash, key, key_len))
+    {
+      current_pair = current_pair->next;
+    }
+    if (current_pair != NULL)
+    {
+      worker->bytes -= hash_table_pair_bytes(ht, current_pair);
+      hash_table_set_value(ht, current_pair, value, strlen(value));
+      worker->bytes += hash_table_pair_bytes(ht, current_pair);
+      if (ht->key_ownership == HASH_TABLE_MOVE)
+      {
+        hash_table_release(ht, HASH_TABLE_MOVE, key, key_len);
+      }
+      continue;
+    }
+    LinkedPair *new_pair = create_pair(ht, key, key_len, value, strlen(value));
+    new_pair->hash = keyHash;
+    new_pair->next = ht->storage[hashIndex];
+    ht->storage[hashIndex] = new_pair;
+    worker->count++;
+    worker->bytes += hash_table_pair_bytes(ht, new_pair);
+  }
+  return NULL;
+}
+
+/*
+  Run fn on every worker, the calling thread doing worker 0 itself, and
+  any worker it could not start a thread for.
+ */
+static void hash_table_build_run(HashTableBuildWorker *workers, int threads, void *(*fn)(void *))
+{
+  pthread_t *ids = malloc(threads * sizeof(pthread_t));
+  char *started = calloc(threads, 1);
+  for (int t = 1; t < threads; t++)
+  {
+    started[t] = pthread_create(&ids[t], NULL, fn, &workers[t]) == 0;
+    if (!started[t])
+    {
+      fn(&workers[t]);
+    }
+  }
+  fn(&workers[0]);
+  for (int t = 1; t < threads; t++)
+  {
+    if (started[t])
+    {
+      pthread_join(ids[t], NULL);
+    }
+  }
+  free(started);
+  free(ids);
+}
+
+/*
+  Build a table holding the n pairs, using up to `threads` threads (all
+  online cores when threads <= 0). Keys and values are copied.
+
+  The table is sized for n pairs up front, so it never resizes while it
+  is built. The pairs are hashed in parallel and grouped by the range of
+  buckets they fall into, then every thread links one range on its own,
+  without any locks.
+ */
+HashTable *hash_table_build(HashTablePair *pairs, int n, int threads)
+{
+  HashTable *ht = create_hash_table((int)(n / HASH_TABLE_MAX_LOAD) + 1);
+  if (threads <= 0)
+  {
+    threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  // at least one pair per thread and no more partitions than buckets
+  if (threads > n)
+  {
+    threads = n;
+  }
+  if (threads > ht->capacity)
+  {
+    threads = ht->capacity;
+  }
+  if (threads < 1)
+  {
+    threads = 1;
+  }
+  HashTableBuild build = {ht, pairs, n, threads, malloc(n * sizeof(uint64_t)), malloc(n * sizeof(int)),
+                          calloc(threads * threads, sizeof(int)), malloc((threads + 1) * sizeof(int))};
+  HashTableBuildWorker *workers = malloc(threads * sizeof(HashTableBuildWorker));
+  for (int t = 0; t < threads; t++)
+  {
+    workers[t] = (HashTableBuildWorker){&build, t, 0, 0};
+  }
+
+  hash_table_build_run(workers, threads, hash_table_build_hash);
+  // turn the counts into write positions, partition by partition, slice by slice
+  int position = 0;
+  for (int p = 0; p < threads; p++)
+  {
+    build.partition_start[p] = position;
+    for (int t = 0; t < threads; t++)
+    {
+      int count = build.counts[t * threads + p];
+      build.counts[t * threads + p] = position;
+      position += count;
+    }
+  }
+  build.partition_start[threads] = position;
+  hash_table_build_run(workers, threads, hash_table_build_scatter);
+  hash_table_build_run(workers, threads, hash_table_build_link);
+
+  for (int t = 0; t < threads; t++)
+  {
+    ht->count += workers[t].count;
+    ht->entry_bytes += workers[t].bytes;
+  }
+#ifndef HASH_TABLE_NO_STATS
+  // every pair was either a new key or an overwrite of one
+  ht->counters.inserts += ht->count;
+  ht->counters.overwrites += n - ht->count;
+#endif
+  free(workers);
+  free(build.hashes);
+  free(build.order);
+  free(build.counts);
+  free(build.partition_start);
+  return ht;
+}
+
+/*
+  Reverse the bits of a scan cursor.
+ */
+static uint64_t hash_table_reverse_bits(uint64_t v)
+{
+  v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+  v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+  v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+  v = ((v >> 8) & 0x00FF00FF00FF00FFULL) | ((v & 0x00FF00FF00FF00FFULL) << 8);
+  v = ((v >> 16) & 0x0000FFFF0000FFFFULL) | ((v & 0x0000FFFF0000FFFFULL) << 16);
+  return (v >> 32) | (v << 32);
+}
+
+/*
+  Advance the cursor to the next bucket of a table with the given mask,
+  counting up in the reversed bits above the mask.
+ */
+static uint64_t hash_table_next_cursor(uint64_t cursor, uint64_t mask)
+{
+  cursor |= ~mask;
+  cursor = hash_table_reverse_bits(cursor);
+  cursor++;
+  return hash_table_reverse_bits(cursor);
+}
+
+static int hash_table_scan_bucket(HashTable *ht, LinkedPair *current_pair, uint64_t now, HashTableScanFunction fn, void *arg)
+{
+  int visited = 0;
+  while (current_pair != NULL)
+  {
+    if (!hash_table_pair_expired(ht, current_pair, now))
+    {
+      fn(current_pair, arg);
+      visited++;
+    }
+    current_pair = current_pair->next;
+  }
+  return visited;
+}
+
+/*
+  Visit the pairs of the table a few buckets at a time. Start with a
+  cursor of 0 and pass the returned cursor to the next call, the scan
+  is done when it returns 0. Each call visits whole buckets until at
+  least count pairs were passed to fn.
+
+  The cursor is the bucket index with its bits reversed, counted up
+  from the top bit. Capacities are powers of two, so when the table
+  doubles every bucket splits into two that come right after each other
+  in this order, and when it halves two buckets merge into one, so the
+  cursor never skips a bucket that was not visited yet. Every key that
+  is in the table for the whole scan is visited at least once, however
+  the table grows or shrinks between calls. A key may be visited more
+  than once after a shrink.
+
+  While an incremental resize is running, the bucket of the smaller
+  array is visited together with every bucket of the larger one it
+  maps to.
+
+  fn must not insert or remove. The table may be changed freely
+  between calls.
+ */
+uint64_t hash_table_scan(HashTable *ht, uint64_t cursor, int count, HashTableScanFunction fn, void *arg)
+{
+  int visited = 0;
+  // pairs past their TTL are skipped, not visited
+  uint64_t now = ht->wheel != NULL ? ht->clock() : 0;
+  do
+  {
+    if (ht->old_storage == NULL)
+    {
+      uint64_t mask = ht->capacity - 1;
+      visited += hash_table_scan_bucket(ht, ht->storage[cursor & mask], now, fn, arg);
+      cursor = hash_table_next_cursor(cursor, mask);
+      continue;
+    }
+    LinkedPair **small = ht->storage, **large = ht->old_storage;
+    uint64_t small_mask = ht->capacity - 1, large_mask = ht->old_capacity - 1;
+    if (small_mask > large_mask)
+    {
+      small = ht->old_storage;
+      large = ht->storage;
+      small_mask = ht->old_capacity - 1;
+      large_mask = ht->capacity - 1;
+    }
+    visited += hash_table_scan_bucket(ht, small[cursor & small_mask], now, fn, arg);
+    // then every bucket of the larger array the small bucket expands to
+    do
+    {
+      visited += hash_table_scan_bucket(ht, large[cursor & large_mask], now, fn, arg);
+      cursor = hash_table_next_cursor(cursor, large_mask);
+    } while (cursor & (small_mask ^ large_mask));
+  } while (cursor != 0 && visited < count);
+  return cursor;
+}
+
+/*
+  Add one chain to the stats: its length to the histogram, its pairs,
+  keys and values to the byte counts.
+ */
+static void hash_table_stats_chain(HashTable *ht, HashTableStats *stats, LinkedPair *current_pair)
+{
+  int count_keys = ht->key_ownership != HASH_TABLE_BORROW;
+  int count_values = ht->value_ownership != HASH_TABLE_BORROW;
+  int length = 0;
+  for (; current_pair != NULL; current_pair = current_pair->next)
+  {
+    length++;
+    stats->node_bytes += sizeof(LinkedPair) + current_pair->inline_size + (current_pair->flags & LINKED_PAIR_TIMER ? sizeof(HashTableTimer) : 0);
+    // inline strings are already counted in node_bytes
+    stats->key_bytes += current_pair->flags & LINKED_PAIR_KEY_INLINE || !count_keys ? 0 : current_pair->key_len + 1;
+    stats->value_bytes += current_pair->flags & LINKED_PAIR_VALUE_INLINE || !count_values ? 0 : current_pair->value_len + 1;
+  }
+  stats->chain_histogram[length < HASH_TABLE_STATS_HISTOGRAM ? length : HASH_TABLE_STATS_HISTOGRAM - 1]++;
+  if (length > stats->longest_chain)
+  {
+    stats->longest_chain = length;
+  }
+}
+
+/*
+  Fill stats with a picture of the table: size, load, how long the
+  chains are and how many bytes everything takes, plus the counters
+  kept since the table was created.
+
+  Byte counts are what the table asked its allocators for, keys and
+  values including their trailing NUL. Borrowed keys and values are not
+  the table's memory and are left out. While an incremental resize is
+  running, the old buckets still waiting to be moved are included.
+
+  Walks every bucket, so it takes time in proportion to the capacity.
+ */
+void hash_table_stats(HashTable *ht, HashTableStats *stats)
+{
+  memset(stats, 0, sizeof(HashTableStats));
+  stats->count = ht->count;
+  stats->capacity = ht->capacity;
+  stats->load_factor = (double)ht->count / ht->capacity;
+  stats->bucket_bytes = ht->capacity * sizeof(LinkedPair *);
+  for (int i = 0; i < ht->capacity; i++)
+  {
+    hash_table_stats_chain(ht, stats, ht->storage[i]);
+  }
+  if (ht->old_storage != NULL)
+  {
+    stats->bucket_bytes += ht->old_capacity * sizeof(LinkedPair *);
+    for (int i = ht->rehash_index; i < ht->old_capacity; i++)
+    {
+      hash_table_stats_chain(ht, stats, ht->old_storage[i]);
+    }
+  }
+  stats->counters = ht->counters;
 }
 
 #ifndef TESTING
@@ -1,17 +1,217 @@
 #ifndef hashtables_h
 #define hashtables_h
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+#include "../utils/hash.h"
+
+/*
+  Hash table key/value pair with linked list pointer.
+
+  Note that an instance of `LinkedPair` is also a node in a linked list.
+  More specifically, the `next` field is a pointer pointing to the the
+  next `LinkedPair` in the list of `LinkedPair` nodes.
+
+  `hash` caches the full hash of the key. Chain walks compare it before
+  touching the key bytes, and resizes use it to pick the new bucket.
+
+  Keys and values are byte strings of `key_len` and `value_len` bytes,
+  each stored with a NUL byte after the last one when the table copied
+  them (borrowed and moved bytes are kept exactly as given).
+
+  Short keys and values are stored in `inline_bytes` at the end of the
+  pair itself, so comparing a short key reads no memory outside the
+  pair. `key` and `value` always point at the bytes, wherever they are,
+  and `flags` says which of them are inline, and whether the pair has
+  an expiry timer (see `hash_table_insert_ttl`). The header is kept
+  under a cache line, so short keys start in the same line as `hash`.
+ */
 typedef struct LinkedPair {
   char *key;
   char *value;
   struct LinkedPair *next;
+  uint64_t hash;
+  size_t key_len;
+  size_t value_len;
+  unsigned int inline_size;
+  unsigned int flags;
+  char inline_bytes[];
 } LinkedPair;
 
+// keys and values shorter than this many bytes are stored inline
+#define HASH_TABLE_INLINE_MAX 64
+
+#define LINKED_PAIR_KEY_INLINE 1
+#define LINKED_PAIR_VALUE_INLINE 2
+// set by hits in cache mode, cleared by the CLOCK hand
+#define LINKED_PAIR_REFERENCED 4
+// the pair was inserted with a TTL, its timer is in the table's wheel
+#define LINKED_PAIR_TIMER 8
+
+/*
+  Cumulative operation counts, see `hash_table_stats`. Tables built with
+  HASH_TABLE_NO_STATS defined never update them.
+ */
+typedef struct HashTableCounters {
+  unsigned long inserts;
+  unsigned long overwrites;
+  unsigned long removes;
+  unsigned long hits;
+  unsigned long misses;
+  unsigned long resizes;
+  unsigned long evictions;
+  unsigned long expirations;
+} HashTableCounters;
+
+#define HASH_TABLE_WHEEL_LEVELS 6
+#define HASH_TABLE_WHEEL_SLOTS 64
+
+/*
+  Expiry of one pair, `expires` in clock milliseconds. `pprev` points at
+  whatever points at the timer in its wheel slot, NULL while it is not
+  in one.
+ */
+typedef struct HashTableTimer {
+  struct LinkedPair *pair;
+  uint64_t expires;
+  struct HashTableTimer *next;
+  struct HashTableTimer **pprev;
+  int level;
+  int slot;
+} HashTableTimer;
+
+/*
+  Hierarchical timer wheel, one tick per millisecond. A slot of level l
+  spans 64^l ticks, so six levels of 64 slots reach past two years.
+  `now` is the last tick processed, and bit s of `occupied[l]` is set
+  while slot s of level l holds timers.
+
+  Pairs do not point at their timers, `timers` finds them by the pair's
+  address: an open addressed array of `timer_capacity` slots holding
+  `timer_count` timers.
+ */
+typedef struct HashTableWheel {
+  uint64_t now;
+  uint64_t occupied[HASH_TABLE_WHEEL_LEVELS];
+  HashTableTimer *slots[HASH_TABLE_WHEEL_LEVELS][HASH_TABLE_WHEEL_SLOTS];
+  HashTableTimer **timers;
+  size_t timer_capacity;
+  size_t timer_count;
+} HashTableWheel;
+
+// milliseconds from any fixed point, only ever moving forward
+typedef uint64_t (*HashTableClock)(void);
+
+// default load factors, grow past 0.7 pairs per bucket and shrink below 0.2
+#define HASH_TABLE_MAX_LOAD 0.7
+#define HASH_TABLE_MIN_LOAD 0.2
+
+/*
+  Who owns the keys and values given to inserts, see
+  `hash_table_set_ownership`.
+ */
+typedef enum HashTableOwnership {
+  HASH_TABLE_COPY,
+  HASH_TABLE_BORROW,
+  HASH_TABLE_MOVE
+} HashTableOwnership;
+
+typedef void (*HashTableDestructor)(void *bytes, size_t len);
+
+/*
+  Hash table with linked pairs.
+
+  `count` is the number of pairs stored. The table doubles once count
+  goes past `max_load` pairs per bucket and halves once it drops below
+  `min_load`, but never below the capacity it was created with.
+  Capacities are always powers of two, so a bucket index is the full
+  hash masked by `capacity - 1`.
+
+  Keys are hashed with `hash_function` keyed by `seed`, djb2 unless the
+  table was given another function with `hash_table_set_hash_function`.
+
+  Pairs are allocated through `node_allocator` and their key and value
+  strings through `bytes_allocator`, plain malloc unless the table was
+  switched to arenas with `hash_table_use_arena`.
+
+  While an incremental resize is running, `old_storage` still holds the
+  buckets below `old_capacity` that have not been moved into `storage`
+  yet, and `rehash_index` is the next old bucket to move.
+
+  `counters` counts operations since the table was created.
+
+  Keys and values are copied into the table unless it was told to
+  borrow or take over the caller's memory with `hash_table_set_ownership`.
+
+  `entry_bytes` is the memory the pairs take: nodes, inline space and
+  the key and value bytes the table owns. In cache mode (see
+  `hash_table_set_cache`) inserts keep it under `cache_bytes` by
+  evicting pairs, and `clock_hand` is the next bucket to sweep.
+
+  `wheel` holds the timers of pairs inserted with a TTL, see
+  `hash_table_insert_ttl`. It is only allocated by the first of them.
+ */
 typedef struct HashTable {
   int capacity;
   LinkedPair **storage;
+  int count;
+  int initial_capacity;
+  double max_load;
+  double min_load;
+  HashFunction hash_function;
+  uint64_t seed;
+  Allocator node_allocator;
+  Allocator bytes_allocator;
+  int incremental;
+  int old_capacity;
+  LinkedPair **old_storage;
+  int rehash_index;
+  HashTableCounters counters;
+  HashTableOwnership key_ownership;
+  HashTableOwnership value_ownership;
+  HashTableDestructor destructor;
+  size_t entry_bytes;
+  size_t cache_bytes;
+  int clock_hand;
+  HashTableWheel *wheel;
+  HashTableClock clock;
 } HashTable;
 
+/*
+  A key and value to load with `hash_table_build`.
+ */
+typedef struct HashTablePair {
+  char *key;
+  char *value;
+} HashTablePair;
+
+// chains of this many pairs or more share the last histogram slot
+#define HASH_TABLE_STATS_HISTOGRAM 16
+
+/*
+  Filled in by `hash_table_stats`. `chain_histogram[n]` is the number of
+  buckets holding n pairs.
+ */
+typedef struct HashTableStats {
+  int count;
+  int capacity;
+  double load_factor;
+  unsigned long chain_histogram[HASH_TABLE_STATS_HISTOGRAM];
+  int longest_chain;
+  size_t node_bytes;
+  size_t key_bytes;
+  size_t value_bytes;
+  size_t bucket_bytes;
+  HashTableCounters counters;
+} HashTableStats;
+
+/*
+  Called by `hash_table_scan` for every pair it visits.
+ */
+typedef void (*HashTableScanFunction)(LinkedPair *pair, void *arg);
+
 
 HashTable *create_hash_table(int capacity);
 
@@ -25,5 +225,47 @@ void destroy_hash_table(HashTable *ht);
 
 HashTable *hash_table_resize(HashTable *ht);
 
+void hash_table_insert_bytes(HashTable *ht, const void *key, size_t key_len, const void *value, size_t value_len);
+
+void hash_table_remove_bytes(HashTable *ht, const void *key, size_t key_len);
+
+void *hash_table_retrieve_bytes(HashTable *ht, const void *key, size_t key_len, size_t *value_len);
+
+void hash_table_insert_prehashed(HashTable *ht, uint64_t keyHash, const void *key, size_t key_len, const void *value, size_t value_len);
+
+void hash_table_remove_prehashed(HashTable *ht, uint64_t keyHash, const void *key, size_t key_len);
+
+void *hash_table_retrieve_prehashed(HashTable *ht, uint64_t keyHash, const void *key, size_t key_len, size_t *value_len);
+
+void hash_table_retrieve_batch(HashTable *ht, char **keys, int n, char **out_values);
+
+void hash_table_insert_batch(HashTable *ht, char **keys, char **values, int n);
+
+void hash_table_set_incremental_resize(HashTable *ht, int enabled);
+
+int hash_table_set_load_factors(HashTable *ht, double max_load, double min_load);
+
+void hash_table_set_hash_function(HashTable *ht, HashFunction hash_function, uint64_t seed);
+
+void hash_table_set_allocators(HashTable *ht, Allocator node_allocator, Allocator bytes_allocator);
+
+void hash_table_use_arena(HashTable *ht);
+
+void hash_table_set_cache(HashTable *ht, size_t max_bytes);
+
+void hash_table_insert_ttl(HashTable *ht, char *key, char *value, uint64_t ttl);
+
+void hash_table_set_clock(HashTable *ht, HashTableClock clock);
+
+int hash_table_pair_expired(HashTable *ht, LinkedPair *pair, uint64_t now);
+
+void hash_table_set_ownership(HashTable *ht, HashTableOwnership key_ownership, HashTableOwnership value_ownership, HashTableDestructor destructor);
+
+HashTable *hash_table_build(HashTablePair *pairs, int n, int threads);
+
+uint64_t hash_table_scan(HashTable *ht, uint64_t cursor, int count, HashTableScanFunction fn, void *arg);
+
+void hash_table_stats(HashTable *ht, HashTableStats *stats);
+
 
-#endif
\ No newline at end of file
+#endif
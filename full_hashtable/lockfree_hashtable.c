@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lockfree_hashtable.h"
+
+/*
+  Chained hash table whose readers never take a lock.
+
+  Readers only load: the bucket array pointer and every bucket head and
+  `next` link are read with acquire loads, inside an epoch read section
+  (see epoch.c). Writers are serialized by `write_lock` and publish every
+  link with a release store, so a reader that sees a pair also sees its
+  key, value and hash fully written.
+
+  A published pair is never changed. Overwriting a value links in a new
+  pair in place of the old one, and removing a pair unlinks it; either
+  way the old pair is retired and freed only after every reader that
+  could still be looking at it has left its read section.
+
+  A resize builds a complete new bucket array out of copies of the pairs
+  (sharing their key and value bytes) and publishes it with one atomic
+  store. Readers already walking the old array finish on it undisturbed.
+ */
+
+#define LOCKFREE_HASH_TABLE_MAX_LOAD 0.7
+
+static int lockfree_round_pow2(int n)
+{
+  int rounded = 1;
+  while (rounded < n)
+  {
+    rounded <<= 1;
+  }
+  return rounded;
+}
+
+static LockFreeBuckets *lockfree_create_buckets(int capacity)
+{
+  LockFreeBuckets *buckets = calloc(1, sizeof(LockFreeBuckets) + capacity * sizeof(LinkedPair *));
+  buckets->capacity = capacity;
+  return buckets;
+}
+
+static LinkedPair **lockfree_bucket(LockFreeBuckets *buckets, uint64_t keyHash)
+{
+  return &buckets->storage[keyHash & (uint64_t)(buckets->capacity - 1)];
+}
+
+static LinkedPair *lockfree_create_pair(char *key, size_t key_len, char *value, uint64_t keyHash)
+{
+  // zeroed: no timer, no inline bytes, nothing for shared LinkedPair code to misread
+  LinkedPair *pair = calloc(1, sizeof(LinkedPair));
+  pair->key = strdup(key);
+  pair->key_len = key_len;
+  pair->value = strdup(value);
+  pair->value_len = strlen(value);
+  pair->hash = keyHash;
+  pair->next = NULL;
+  return pair;
+}
+
+/*
+  Free a pair together with its key and value.
+ */
+static void lockfree_free_pair(void *ptr)
+{
+  LinkedPair *pair = ptr;
+  free(pair->key);
+  free(pair->value);
+  free(pair);
+}
+
+/*
+  Free a bucket array replaced by a resize. Its pairs were copied into
+  the new array, which now owns their key and value bytes, so only the
+  pair structs themselves are freed here.
+ */
+static void lockfree_free_old_buckets(void *ptr)
+{
+  LockFreeBuckets *buckets = ptr;
+  for (int i = 0; i < buckets->capacity; i++)
+  {
+    LinkedPair *current_pair = buckets->storage[i];
+    while (current_pair != NULL)
+    {
+      LinkedPair *next_pair = current_pair->next;
+      free(current_pair);
+      current_pair = next_pair;
+    }
+  }
+  free(buckets);
+}
+
+static int lockfree_pair_has_key(LinkedPair *pair, uint64_t keyHash, char *key, size_t key_len)
+{
+  return pair->hash == keyHash && pair->key_len == key_len && memcmp(pair->key, key, key_len) == 0;
+}
+
+/*
+  Reader side lookup, only valid inside an epoch read section.
+ */
+static LinkedPair *lockfree_find(LockFreeHashTable *lht, uint64_t keyHash, char *key, size_t key_len)
+{
+  LockFreeBuckets *buckets = atomic_load_explicit(&lht->buckets, memory_order_acquire);
+  LinkedPair *current_pair = __atomic_load_n(lockfree_bucket(buckets, keyHash), __ATOMIC_ACQUIRE);
+  while (current_pair != NULL && !lockfree_pair_has_key(current_pair, keyHash, key, key_len))
+  {
+    current_pair = __atomic_load_n(&current_pair->next, __ATOMIC_ACQUIRE);
+  }
+  return current_pair;
+}
+
+/*
+  Writer side lookup, with write_lock held. Returns the link pointing at
+  the pair with key, or at the NULL ending the chain.
+ */
+static LinkedPair **lockfree_find_link(LockFreeHashTable *lht, uint64_t keyHash, char *key, size_t key_len)
+{
+  LockFreeBuckets *buckets = atomic_load_explicit(&lht->buckets, memory_order_relaxed);
+  LinkedPair **link = lockfree_bucket(buckets, keyHash);
+  while (*link != NULL && !lockfree_pair_has_key(*link, keyHash, key, key_len))
+  {
+    link = &(*link)->next;
+  }
+  return link;
+}
+
+/*
+  Publish a copy of the bucket array at new_capacity, with write_lock held.
+ */
+static void lockfree_rehash(LockFreeHashTable *lht, int new_capacity)
+{
+  LockFreeBuckets *old_buckets = atomic_load_explicit(&lht->buckets, memory_order_relaxed);
+  LockFreeBuckets *new_buckets = lockfree_create_buckets(new_capacity);
+  for (int i = 0; i < old_buckets->capacity; i++)
+  {
+    for (LinkedPair *pair = old_buckets->storage[i]; pair != NULL; pair = pair->next)
+    {
+      // readers may still be walking the old pairs, so link copies instead
+      LinkedPair *copy = malloc(sizeof(LinkedPair));
+      *copy = *pair;
+      LinkedPair **bucket = lockfree_bucket(new_buckets, pair->hash);
+      copy->next = *bucket;
+      *bucket = copy;
+    }
+  }
+  // the new array is private until this store, plain writes above are enough
+  atomic_store_explicit(&lht->buckets, new_buckets, memory_order_release);
+  epoch_retire(&lht->retired, old_buckets, lockfree_free_old_buckets);
+}
+
+LockFreeHashTable *create_lockfree_hash_table(int capacity)
+{
+  LockFreeHashTable *lht = malloc(sizeof(LockFreeHashTable));
+  atomic_init(&lht->buckets, lockfree_create_buckets(lockfree_round_pow2(capacity)));
+  lht->count = 0;
+  lht->max_load = LOCKFREE_HASH_TABLE_MAX_LOAD;
+  pthread_mutex_init(&lht->write_lock, NULL);
+  lht->retired.head = NULL;
+  lht->retired.pending = 0;
+  lht->hash_function = hash_djb2;
+  lht->seed = 0;
+  return lht;
+}
+
+/*
+  Inserting an existing key replaces its pair with a new one holding the
+  new value, readers see either the old pair or the new one.
+ */
+void lockfree_hash_table_insert(LockFreeHashTable *lht, char *key, char *value)
+{
+  size_t key_len = strlen(key);
+  uint64_t keyHash = lht->hash_function(key, key_len, lht->seed);
+  LinkedPair *new_pair = lockfree_create_pair(key, key_len, value, keyHash);
+  pthread_mutex_lock(&lht->write_lock);
+  LinkedPair **link = lockfree_find_link(lht, keyHash, key, key_len);
+  LinkedPair *old_pair = *link;
+  if (old_pair != NULL)
+  {
+    new_pair->next = old_pair->next;
+    __atomic_store_n(link, new_pair, __ATOMIC_RELEASE);
+    epoch_retire(&lht->retired, old_pair, lockfree_free_pair);
+  }
+  else
+  {
+    __atomic_store_n(link, new_pair, __ATOMIC_RELEASE);
+    lht->count++;
+    LockFreeBuckets *buckets = atomic_load_explicit(&lht->buckets, memory_order_relaxed);
+    if (lht->count > buckets->capacity * lht->max_load)
+    {
+      lockfree_rehash(lht, buckets->capacity * 2);
+    }
+  }
+  pthread_mutex_unlock(&lht->write_lock);
+}
+
+void lockfree_hash_table_remove(LockFreeHashTable *lht, char *key)
+{
+  size_t key_len = strlen(key);
+  uint64_t keyHash = lht->hash_function(key, key_len, lht->seed);
+  pthread_mutex_lock(&lht->write_lock);
+  LinkedPair **link = lockfree_find_link(lht, keyHash, key, key_len);
+  LinkedPair *old_pair = *link;
+  if (old_pair != NULL)
+  {
+    // readers standing on old_pair still see its next link and carry on
+    __atomic_store_n(link, old_pair->next, __ATOMIC_RELEASE);
+    epoch_retire(&lht->retired, old_pair, lockfree_free_pair);
+    lht->count--;
+  }
+  pthread_mutex_unlock(&lht->write_lock);
+}
+
+/*
+  Copy the value of key into the caller's buffer of size bytes (always
+  NUL terminated when size > 0). Returns the length of the value, or -1
+  if the key is not found. Never blocks and never writes shared memory.
+ */
+long lockfree_hash_table_retrieve(LockFreeHashTable *lht, char *key, char *value, size_t size)
+{
+  size_t key_len = strlen(key);
+  uint64_t keyHash = lht->hash_function(key, key_len, lht->seed);
+  long value_len = -1;
+  epoch_enter();
+  LinkedPair *found = lockfree_find(lht, keyHash, key, key_len);
+  if (found != NULL)
+  {
+    value_len = (long)found->value_len;
+    if (size > 0)
+    {
+      size_t copied = found->value_len < size - 1 ? found->value_len : size - 1;
+      memcpy(value, found->value, copied);
+      value[copied] = '\0';
+    }
+  }
+  epoch_exit();
+  return value_len;
+}
+
+/*
+  Zero copy variant of retrieve. Must be called between epoch_enter()
+  and epoch_exit(), the returned value stays valid until epoch_exit().
+ */
+char *lockfree_hash_table_lookup(LockFreeHashTable *lht, char *key)
+{
+  size_t key_len = strlen(key);
+  LinkedPair *found = lockfree_find(lht, lht->hash_function(key, key_len, lht->seed), key, key_len);
+  return found != NULL ? found->value : NULL;
+}
+
+/*
+  No other thread may still be using the table.
+ */
+void destroy_lockfree_hash_table(LockFreeHashTable *lht)
+{
+  LockFreeBuckets *buckets = atomic_load(&lht->buckets);
+  for (int i = 0; i < buckets->capacity; i++)
+  {
+    LinkedPair *current_pair = buckets->storage[i];
+    while (current_pair != NULL)
+    {
+      LinkedPair *next_pair = current_pair->next;
+      lockfree_free_pair(current_pair);
+      current_pair = next_pair;
+    }
+  }
+  free(buckets);
+  epoch_drain(&lht->retired);
+  pthread_mutex_destroy(&lht->write_lock);
+  free(lht);
+}
+
+/*
+  Double the capacity. Readers keep running while it happens.
+ */
+void lockfree_hash_table_resize(LockFreeHashTable *lht)
+{
+  pthread_mutex_lock(&lht->write_lock);
+  LockFreeBuckets *buckets = atomic_load_explicit(&lht->buckets, memory_order_relaxed);
+  lockfree_rehash(lht, buckets->capacity * 2);
+  pthread_mutex_unlock(&lht->write_lock);
+}
@@ -0,0 +1,42 @@
+#ifndef lockfree_hashtable_h
+#define lockfree_hashtable_h
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "epoch.h"
+#include "hashtables.h"
+
+typedef struct LockFreeBuckets {
+  int capacity;
+  LinkedPair *storage[];
+} LockFreeBuckets;
+
+typedef struct LockFreeHashTable {
+  _Atomic(LockFreeBuckets *) buckets;
+  int count;
+  double max_load;
+  pthread_mutex_t write_lock;
+  EpochRetireList retired;
+  HashFunction hash_function;
+  uint64_t seed;
+} LockFreeHashTable;
+
+
+LockFreeHashTable *create_lockfree_hash_table(int capacity);
+
+void lockfree_hash_table_insert(LockFreeHashTable *lht, char *key, char *value);
+
+void lockfree_hash_table_remove(LockFreeHashTable *lht, char *key);
+
+long lockfree_hash_table_retrieve(LockFreeHashTable *lht, char *key, char *value, size_t size);
+
+char *lockfree_hash_table_lookup(LockFreeHashTable *lht, char *key);
+
+void destroy_lockfree_hash_table(LockFreeHashTable *lht);
+
+void lockfree_hash_table_resize(LockFreeHashTable *lht);
+
+
+#endif
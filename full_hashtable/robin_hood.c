@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "robin_hood.h"
+
+/*
+  Open addressed hash table with Robin Hood displacement.
+
+  Every entry lives directly in the flat `slots` array, so a lookup walks
+  neighbouring slots in one or two cache lines instead of chasing a chain
+  of separately malloc'd `LinkedPair` nodes.
+
+  `dist` is the probe sequence length of the entry plus one, so a zeroed
+  slot (dist == 0) is empty. On insert an entry that has travelled further
+  from its home slot steals the slot of a "richer" entry, which keeps the
+  probe lengths short and evenly spread. Removal shifts the following
+  entries back by one slot instead of leaving tombstones behind.
+ */
+
+// grow once the table is more than 7/8 full, probe lengths blow up past that
+#define RH_MAX_LOAD_NUM 7
+#define RH_MAX_LOAD_DEN 8
+
+/*
+  Full hash of key with the table's hash function and seed. The full
+  value is kept around so probes can rule out a slot without comparing
+  the keys, and so a resize never has to re-hash a key.
+ */
+static uint64_t rh_hash(RHTable *rh, char *key)
+{
+  return rh->hash_function(key, strlen(key), rh->seed);
+}
+
+/*
+  Round capacity up to a power of two so the home slot is a mask, not a divide.
+ */
+static int rh_round_capacity(int capacity)
+{
+  int rounded = 2;
+  while (rounded < capacity)
+  {
+    rounded <<= 1;
+  }
+  return rounded;
+}
+
+/*
+  Place an entry we already own into the slot array, without checking for
+  an existing key. Used by insert for new keys and by resize.
+ */
+static void rh_place(RHSlot *slots, int capacity, RHSlot entry)
+{
+  unsigned long mask = (unsigned long)capacity - 1;
+  unsigned long index = (unsigned long)(entry.hash & mask);
+  entry.dist = 1;
+  while (slots[index].dist != 0)
+  {
+    // the resident is closer to home than we are, take its slot and carry it on
+    if (slots[index].dist < entry.dist)
+    {
+      RHSlot displaced = slots[index];
+      slots[index] = entry;
+      entry = displaced;
+    }
+    index = (index + 1) & mask;
+    entry.dist++;
+  }
+  slots[index] = entry;
+}
+
+/*
+  Find the slot index holding key, or -1 if it is not in the table.
+
+  The search stops as soon as we reach a slot whose entry is closer to
+  its home than we would be: had our key been inserted, it would have
+  displaced that entry.
+ */
+static long rh_find(RHTable *rh, char *key, uint64_t hash)
+{
+  unsigned long mask = (unsigned long)rh->capacity - 1;
+  unsigned long index = (unsigned long)(hash & mask);
+  unsigned int dist = 1;
+  while (rh->slots[index].dist >= dist)
+  {
+    RHSlot *slot = &rh->slots[index];
+    if (slot->hash == hash && strcmp(slot->key, key) == 0)
+    {
+      return (long)index;
+    }
+    index = (index + 1) & mask;
+    dist++;
+  }
+  return -1;
+}
+
+/*
+  Move every entry into a slot array of new_capacity. Entries are moved,
+  not copied, so no key or value is duplicated or re-hashed.
+ */
+static void rh_rehash(RHTable *rh, int new_capacity)
+{
+  RHSlot *new_slots = calloc(new_capacity, sizeof(RHSlot));
+  for (int i = 0; i < rh->capacity; i++)
+  {
+    if (rh->slots[i].dist != 0)
+    {
+      rh_place(new_slots, new_capacity, rh->slots[i]);
+    }
+  }
+  free(rh->slots);
+  rh->slots = new_slots;
+  rh->capacity = new_capacity;
+}
+
+/*
+  All slots start out empty (dist == 0), which is what calloc gives us.
+
+  Keys are hashed with wyhash under a random seed: a weak hash masked
+  straight into an open addressed table turns runs of similar keys into
+  long clusters, and every probe of the run pays for them.
+ */
+RHTable *create_rh_table(int capacity)
+{
+  RHTable *rh = malloc(sizeof(RHTable));
+  rh->capacity = rh_round_capacity(capacity);
+  rh->count = 0;
+  rh->slots = calloc(rh->capacity, sizeof(RHSlot));
+  rh->hash_function = hash_wyhash;
+  rh->seed = hash_random_seed();
+  return rh;
+}
+
+/*
+  Inserting an existing key overwrites its value.
+
+  The table grows by itself before it gets too full, an open addressed
+  table cannot hold more entries than it has slots.
+ */
+void rh_table_insert(RHTable *rh, char *key, char *value)
+{
+  uint64_t hash = rh_hash(rh, key);
+  long index = rh_find(rh, key, hash);
+  if (index >= 0)
+  {
+    // existing key, swap in a copy of the new value
+    free(rh->slots[index].value);
+    rh->slots[index].value = strdup(value);
+    return;
+  }
+  if ((long)(rh->count + 1) * RH_MAX_LOAD_DEN > (long)rh->capacity * RH_MAX_LOAD_NUM)
+  {
+    rh_rehash(rh, rh->capacity * 2);
+  }
+  RHSlot entry = {strdup(key), strdup(value), hash, 0};
+  rh_place(rh->slots, rh->capacity, entry);
+  rh->count++;
+}
+
+/*
+  Backward shift deletion: every entry after the removed one that is not
+  in its home slot moves back by one, so no tombstones are needed.
+ */
+void rh_table_remove(RHTable *rh, char *key)
+{
+  long found = rh_find(rh, key, rh_hash(rh, key));
+  if (found < 0)
+  {
+    return;
+  }
+  unsigned long mask = (unsigned long)rh->capacity - 1;
+  unsigned long index = (unsigned long)found;
+  free(rh->slots[index].key);
+  free(rh->slots[index].value);
+  unsigned long next = (index + 1) & mask;
+  // shift back until we hit an empty slot or an entry already at home
+  while (rh->slots[next].dist > 1)
+  {
+    rh->slots[index] = rh->slots[next];
+    rh->slots[index].dist--;
+    index = next;
+    next = (next + 1) & mask;
+  }
+  memset(&rh->slots[index], 0, sizeof(RHSlot));
+  rh->count--;
+}
+
+/*
+  Return NULL if the key is not found.
+ */
+char *rh_table_retrieve(RHTable *rh, char *key)
+{
+  long index = rh_find(rh, key, rh_hash(rh, key));
+  if (index < 0)
+  {
+    return NULL;
+  }
+  return rh->slots[index].value;
+}
+
+void destroy_rh_table(RHTable *rh)
+{
+  for (int i = 0; i < rh->capacity; i++)
+  {
+    if (rh->slots[i].dist != 0)
+    {
+      free(rh->slots[i].key);
+      free(rh->slots[i].value);
+    }
+  }
+  free(rh->slots);
+  free(rh);
+}
+
+/*
+  Double the capacity, moving every entry into the new slot array.
+
+  The table is resized in place, the same pointer is returned so callers
+  can use it exactly like `hash_table_resize`.
+ */
+RHTable *rh_table_resize(RHTable *rh)
+{
+  rh_rehash(rh, rh->capacity * 2);
+  return rh;
+}
+
+/*
+  Hash keys with hash_function keyed by seed instead of the default
+  seeded wyhash, see utils/hash.h.
+
+  Only call this on an empty table, stored entries are not moved.
+ */
+void rh_table_set_hash_function(RHTable *rh, HashFunction hash_function, uint64_t seed)
+{
+  rh->hash_function = hash_function;
+  rh->seed = seed;
+}
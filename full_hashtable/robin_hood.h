@@ -0,0 +1,39 @@
+#ifndef robin_hood_h
+#define robin_hood_h
+
+#include <stdint.h>
+
+#include "../utils/hash.h"
+
+typedef struct RHSlot {
+  char *key;
+  char *value;
+  uint64_t hash;
+  unsigned int dist;
+} RHSlot;
+
+typedef struct RHTable {
+  int capacity;
+  int count;
+  RHSlot *slots;
+  HashFunction hash_function;
+  uint64_t seed;
+} RHTable;
+
+
+RHTable *create_rh_table(int capacity);
+
+void rh_table_insert(RHTable *rh, char *key, char *value);
+
+void rh_table_remove(RHTable *rh, char *key);
+
+char *rh_table_retrieve(RHTable *rh, char *key);
+
+void destroy_rh_table(RHTable *rh);
+
+RHTable *rh_table_resize(RHTable *rh);
+
+void rh_table_set_hash_function(RHTable *rh, HashFunction hash_function, uint64_t seed);
+
+
+#endif
@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sharded_hashtable.h"
+
+/*
+  Thread safe front end that splits the keyspace over `shard_count`
+  independent `HashTable`s.
+
+  A key goes to the shard picked by the top `shard_bits` bits of its
+  hash. Inside a shard the bucket index comes from the low bits of the
+  same hash, so the two never overlap and every shard sees an evenly
+  spread share of the keys.
+
+  Each shard has its own lock, load factors and capacity. When one shard
+  passes its max load it doubles (or halves, when it empties out) while
+  holding only its own lock, so the other shards keep serving requests
+  and a resize stalls just 1/shard_count of the keys.
+
+  The top bits of djb2 are zero for short keys, so the shards hash with
+  seeded wyhash instead.
+ */
+
+static int sharded_round_pow2(int n)
+{
+  int rounded = 1;
+  while (rounded < n)
+  {
+    rounded <<= 1;
+  }
+  return rounded;
+}
+
+/*
+  The shard of a key with full hash keyHash. Every shard hashes with the
+  same function and seed, so the hash is handed on to the shard's table
+  and each key is hashed once per call.
+ */
+static HashTableShard *sharded_shard(ShardedHashTable *sht, uint64_t keyHash)
+{
+  if (sht->shard_bits == 0)
+  {
+    return &sht->shards[0];
+  }
+  return &sht->shards[keyHash >> (64 - sht->shard_bits)];
+}
+
+/*
+  Create a table of shard_count shards (rounded up to a power of two),
+  each starting with room for shard_capacity buckets.
+ */
+ShardedHashTable *create_sharded_hash_table(int shard_count, int shard_capacity)
+{
+  ShardedHashTable *sht = malloc(sizeof(ShardedHashTable));
+  sht->shard_count = sharded_round_pow2(shard_count);
+  sht->shard_bits = 0;
+  while ((1 << sht->shard_bits) < sht->shard_count)
+  {
+    sht->shard_bits++;
+  }
+  sht->hash_function = hash_wyhash;
+  sht->seed = hash_random_seed();
+  sht->shards = aligned_alloc(_Alignof(HashTableShard), sht->shard_count * sizeof(HashTableShard));
+  for (int i = 0; i < sht->shard_count; i++)
+  {
+    pthread_mutex_init(&sht->shards[i].lock, NULL);
+    sht->shards[i].table = create_hash_table(shard_capacity);
+    hash_table_set_hash_function(sht->shards[i].table, sht->hash_function, sht->seed);
+  }
+  return sht;
+}
+
+void sharded_hash_table_insert(ShardedHashTable *sht, char *key, char *value)
+{
+  size_t key_len = strlen(key);
+  uint64_t keyHash = sht->hash_function(key, key_len, sht->seed);
+  HashTableShard *shard = sharded_shard(sht, keyHash);
+  pthread_mutex_lock(&shard->lock);
+  hash_table_insert_prehashed(shard->table, keyHash, key, key_len, value, strlen(value));
+  pthread_mutex_unlock(&shard->lock);
+}
+
+void sharded_hash_table_remove(ShardedHashTable *sht, char *key)
+{
+  size_t key_len = strlen(key);
+  uint64_t keyHash = sht->hash_function(key, key_len, sht->seed);
+  HashTableShard *shard = sharded_shard(sht, keyHash);
+  pthread_mutex_lock(&shard->lock);
+  hash_table_remove_prehashed(shard->table, keyHash, key, key_len);
+  pthread_mutex_unlock(&shard->lock);
+}
+
+/*
+  Copy the value of key into the caller's buffer of size bytes (always
+  NUL terminated when size > 0). Returns the length of the value, or -1
+  if the key is not found.
+
+  Retrieves take the shard lock too: a retrieve can move part of a
+  running incremental resize along.
+ */
+long sharded_hash_table_retrieve(ShardedHashTable *sht, char *key, char *value, size_t size)
+{
+  size_t key_len = strlen(key);
+  uint64_t keyHash = sht->hash_function(key, key_len, sht->seed);
+  HashTableShard *shard = sharded_shard(sht, keyHash);
+  long found_len = -1;
+  pthread_mutex_lock(&shard->lock);
+  size_t value_len;
+  char *found = hash_table_retrieve_prehashed(shard->table, keyHash, key, key_len, &value_len);
+  if (found != NULL)
+  {
+    found_len = (long)value_len;
+    if (size > 0)
+    {
+      size_t copied = value_len < size - 1 ? value_len : size - 1;
+      memcpy(value, found, copied);
+      value[copied] = '\0';
+    }
+  }
+  pthread_mutex_unlock(&shard->lock);
+  return found_len;
+}
+
+/*
+  No other thread may still be using the table.
+ */
+void destroy_sharded_hash_table(ShardedHashTable *sht)
+{
+  for (int i = 0; i < sht->shard_count; i++)
+  {
+    destroy_hash_table(sht->shards[i].table);
+    pthread_mutex_destroy(&sht->shards[i].lock);
+  }
+  free(sht->shards);
+  free(sht);
+}
+
+/*
+  Double the capacity of one shard, the others are not touched.
+ */
+void sharded_hash_table_resize_shard(ShardedHashTable *sht, int shard)
+{
+  pthread_mutex_lock(&sht->shards[shard].lock);
+  hash_table_resize(sht->shards[shard].table);
+  pthread_mutex_unlock(&sht->shards[shard].lock);
+}
+
+/*
+  Total number of pairs. Shards are counted one after the other, so the
+  result is only exact while no other thread is writing.
+ */
+int sharded_hash_table_count(ShardedHashTable *sht)
+{
+  int count = 0;
+  for (int i = 0; i < sht->shard_count; i++)
+  {
+    pthread_mutex_lock(&sht->shards[i].lock);
+    count += sht->shards[i].table->count;
+    pthread_mutex_unlock(&sht->shards[i].lock);
+  }
+  return count;
+}
@@ -0,0 +1,38 @@
+#ifndef sharded_hashtable_h
+#define sharded_hashtable_h
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "hashtables.h"
+
+typedef struct HashTableShard {
+  _Alignas(64) pthread_mutex_t lock;
+  HashTable *table;
+} HashTableShard;
+
+typedef struct ShardedHashTable {
+  int shard_count;
+  int shard_bits;
+  HashTableShard *shards;
+  HashFunction hash_function;
+  uint64_t seed;
+} ShardedHashTable;
+
+
+ShardedHashTable *create_sharded_hash_table(int shard_count, int shard_capacity);
+
+void sharded_hash_table_insert(ShardedHashTable *sht, char *key, char *value);
+
+void sharded_hash_table_remove(ShardedHashTable *sht, char *key);
+
+long sharded_hash_table_retrieve(ShardedHashTable *sht, char *key, char *value, size_t size);
+
+void destroy_sharded_hash_table(ShardedHashTable *sht);
+
+void sharded_hash_table_resize_shard(ShardedHashTable *sht, int shard);
+
+int sharded_hash_table_count(ShardedHashTable *sht);
+
+
+#endif
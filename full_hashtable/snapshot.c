@@ -0,0 +1,401 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "snapshot.h"
+#include "../utils/dbg.h"
+
+/*
+  Save and map hash table snapshots, see snapshot.h for the layout.
+
+  The table in memory may hash with any function, but a function pointer
+  cannot be stored in a file, so snapshots always hash with seeded
+  wyhash. The seed is the table's own seed and is kept in the header.
+
+  Every section is a multiple of 8 bytes long and starts on an 8 byte
+  boundary, so a mapping can be read through plain struct pointers.
+ */
+
+static uint64_t snapshot_round_pow2(uint64_t n)
+{
+  uint64_t rounded = 1;
+  while (rounded < n)
+  {
+    rounded <<= 1;
+  }
+  return rounded;
+}
+
+/*
+  Collect every pair of the table, from the old storage too while an
+  incremental resize is running, and set count to how many there are.
+  Pairs past their TTL are left out. Snapshots and frozen tables are
+  both built from this list.
+ */
+LinkedPair **snapshot_collect_pairs(HashTable *ht, uint64_t *count)
+{
+  LinkedPair **pairs = malloc((ht->count + 1) * sizeof(LinkedPair *));
+  uint64_t now = ht->wheel != NULL ? ht->clock() : 0;
+  uint64_t n = 0;
+  for (int i = 0; i < ht->capacity; i++)
+  {
+    for (LinkedPair *pair = ht->storage[i]; pair != NULL; pair = pair->next)
+    {
+      if (!hash_table_pair_expired(ht, pair, now))
+      {
+        pairs[n++] = pair;
+      }
+    }
+  }
+  for (int i = 0; ht->old_storage != NULL && i < ht->old_capacity; i++)
+  {
+    for (LinkedPair *pair = ht->old_storage[i]; pair != NULL; pair = pair->next)
+    {
+      if (!hash_table_pair_expired(ht, pair, now))
+      {
+        pairs[n++] = pair;
+      }
+    }
+  }
+  *count = n;
+  return pairs;
+}
+
+/*
+  Write a snapshot of the table to path. The file is written next to
+  path and renamed over it once complete, so readers only ever see a
+  whole snapshot. Returns 0, or -1 if the file could not be written.
+ */
+int hash_table_save(HashTable *ht, const char *path)
+{
+  uint64_t count;
+  LinkedPair **pairs = snapshot_collect_pairs(ht, &count);
+  uint64_t bucket_count = snapshot_round_pow2(count);
+  uint64_t *hashes = malloc((count + 1) * sizeof(uint64_t));
+  uint64_t *bucket_starts = calloc(bucket_count + 1, sizeof(uint64_t));
+  SnapshotEntry *entries = malloc((count + 1) * sizeof(SnapshotEntry));
+  char *tmp_path = malloc(strlen(path) + 5);
+  FILE *file = NULL;
+
+  // count the entries of every bucket, then turn the counts into starts
+  for (uint64_t i = 0; i < count; i++)
+  {
+    hashes[i] = hash_wyhash(pairs[i]->key, pairs[i]->key_len, ht->seed);
+    bucket_starts[(hashes[i] & (bucket_count - 1)) + 1]++;
+  }
+  for (uint64_t b = 0; b < bucket_count; b++)
+  {
+    bucket_starts[b + 1] += bucket_starts[b];
+  }
+  // place the entries bucket by bucket, the heap follows the same order later
+  uint64_t *positions = malloc(bucket_count * sizeof(uint64_t));
+  memcpy(positions, bucket_starts, bucket_count * sizeof(uint64_t));
+  LinkedPair **ordered = malloc((count + 1) * sizeof(LinkedPair *));
+  for (uint64_t i = 0; i < count; i++)
+  {
+    uint64_t e = positions[hashes[i] & (bucket_count - 1)]++;
+    entries[e].hash = hashes[i];
+    entries[e].key_len = pairs[i]->key_len;
+    entries[e].value_len = pairs[i]->value_len;
+    ordered[e] = pairs[i];
+  }
+  free(positions);
+  uint64_t heap_size = 0;
+  for (uint64_t e = 0; e < count; e++)
+  {
+    entries[e].offset = heap_size;
+    heap_size += entries[e].key_len + entries[e].value_len + 2;
+  }
+  uint64_t heap_padding = (8 - heap_size % 8) % 8;
+
+  SnapshotHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = SNAPSHOT_VERSION;
+  header.seed = ht->seed;
+  header.count = count;
+  header.bucket_count = bucket_count;
+  header.buckets_offset = sizeof(SnapshotHeader);
+  header.entries_offset = header.buckets_offset + (bucket_count + 1) * sizeof(uint64_t);
+  header.heap_offset = header.entries_offset + count * sizeof(SnapshotEntry);
+  header.heap_size = heap_size;
+  header.file_size = header.heap_offset + heap_size + heap_padding;
+
+  sprintf(tmp_path, "%s.tmp", path);
+  file = fopen(tmp_path, "wb");
+  check(file != NULL, "Could not open %s for writing.", tmp_path);
+  check(fwrite(&header, sizeof(header), 1, file) == 1, "Could not write snapshot header.");
+  check(fwrite(bucket_starts, sizeof(uint64_t), bucket_count + 1, file) == bucket_count + 1, "Could not write snapshot buckets.");
+  check(fwrite(entries, sizeof(SnapshotEntry), count, file) == count, "Could not write snapshot entries.");
+  static const char padding[8];
+  for (uint64_t e = 0; e < count; e++)
+  {
+    // borrowed and moved bytes need not be NUL terminated, write the terminators ourselves
+    check(fwrite(ordered[e]->key, 1, ordered[e]->key_len, file) == ordered[e]->key_len, "Could not write snapshot heap.");
+    check(fwrite(padding, 1, 1, file) == 1, "Could not write snapshot heap.");
+    check(fwrite(ordered[e]->value, 1, ordered[e]->value_len, file) == ordered[e]->value_len, "Could not write snapshot heap.");
+    check(fwrite(padding, 1, 1, file) == 1, "Could not write snapshot heap.");
+  }
+  check(fwrite(padding, 1, heap_padding, file) == heap_padding, "Could not write snapshot heap.");
+  check(fflush(file) == 0 && fsync(fileno(file)) == 0, "Could not flush %s.", tmp_path);
+  check(fclose(file) == 0, "Could not close %s.", tmp_path);
+  file = NULL;
+  check(rename(tmp_path, path) == 0, "Could not rename %s to %s.", tmp_path, path);
+
+  free(ordered);
+  free(pairs);
+  free(hashes);
+  free(bucket_starts);
+  free(entries);
+  free(tmp_path);
+  return 0;
+
+error:
+  if (file != NULL)
+  {
+    fclose(file);
+  }
+  unlink(tmp_path);
+  free(ordered);
+  free(pairs);
+  free(hashes);
+  free(bucket_starts);
+  free(entries);
+  free(tmp_path);
+  return -1;
+}
+
+/*
+  Map the snapshot at path read only. Nothing is copied or rebuilt, so
+  opening takes the same time for any size of snapshot and processes
+  mapping the same file share its pages.
+
+  Returns NULL if the file cannot be mapped or is not a snapshot.
+ */
+MappedHashTable *hash_table_open_mapped(const char *path)
+{
+  MappedHashTable *mht = NULL;
+  void *base = MAP_FAILED;
+  struct stat st;
+  int fd = open(path, O_RDONLY);
+  check(fd >= 0, "Could not open %s.", path);
+  check(fstat(fd, &st) == 0, "Could not stat %s.", path);
+  check((size_t)st.st_size >= sizeof(SnapshotHeader), "%s is too small to be a snapshot.", path);
+  base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  check(base != MAP_FAILED, "Could not map %s.", path);
+  close(fd);
+  fd = -1;
+
+  mht = snapshot_attach(base, st.st_size, 0);
+  check(mht != NULL, "%s is not a valid snapshot.", path);
+  return mht;
+
+error:
+  if (fd >= 0)
+  {
+    close(fd);
+  }
+  if (base != MAP_FAILED)
+  {
+    munmap(base, st.st_size);
+  }
+  return NULL;
+}
+
+/*
+  Check the perfect hash section of a snapshot and point mht at it.
+ */
+static int snapshot_attach_perfect(MappedHashTable *mht, SnapshotHeader *header)
+{
+  check(header->buckets_offset == sizeof(SnapshotHeader) &&
+            header->buckets_offset + sizeof(SnapshotPerfectHash) <= header->file_size,
+        "Bad perfect hash offset.");
+  SnapshotPerfectHash *perfect = (SnapshotPerfectHash *)((char *)mht->base + header->buckets_offset);
+  uint64_t remap_bytes = (perfect->remap_count * sizeof(uint32_t) + 7) / 8 * 8;
+  check(header->bucket_count > 0 && perfect->dense_buckets > 0 && perfect->dense_buckets < header->bucket_count &&
+            header->bucket_count < ((uint64_t)1 << 32) && perfect->pilot_bits <= 64 &&
+            perfect->pilot_words == (header->bucket_count * perfect->pilot_bits + 63) / 64 + 1,
+        "Bad perfect hash buckets.");
+  check(perfect->table_size >= header->count && perfect->remap_count == perfect->table_size - header->count,
+        "Bad perfect hash table size.");
+  check(header->entries_offset == header->buckets_offset + sizeof(SnapshotPerfectHash) + perfect->pilot_words * sizeof(uint64_t) + remap_bytes,
+        "Bad perfect hash section size.");
+  mht->perfect = perfect;
+  mht->bucket_count = header->bucket_count;
+  mht->pilots = (uint64_t *)(perfect + 1);
+  mht->remap = (uint32_t *)(mht->pilots + perfect->pilot_words);
+  return 0;
+
+error:
+  return -1;
+}
+
+/*
+  Read the snapshot image of size bytes at base, as mapped from a file
+  or built in memory. The image is used in place and handed over to the
+  returned table, which unmaps it, or frees it when owned is set.
+
+  Returns NULL, leaving the image to the caller, if it is not a valid
+  snapshot.
+ */
+MappedHashTable *snapshot_attach(void *base, size_t size, int owned)
+{
+  MappedHashTable *mht = calloc(1, sizeof(MappedHashTable));
+  SnapshotHeader *header = base;
+  mht->base = base;
+  mht->size = size;
+  mht->owned = owned;
+  check(size >= sizeof(SnapshotHeader), "Snapshot is too small.");
+  check(memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) == 0, "Not a snapshot.");
+  check(header->version == SNAPSHOT_VERSION, "Unknown snapshot version %u.", header->version);
+  check(header->file_size == (uint64_t)size, "Snapshot is truncated.");
+  check(header->heap_offset == header->entries_offset + header->count * sizeof(SnapshotEntry) &&
+            header->heap_offset + header->heap_size <= header->file_size,
+        "Bad snapshot section offsets.");
+  if (header->flags & SNAPSHOT_PERFECT_HASH)
+  {
+    check(snapshot_attach_perfect(mht, header) == 0, "Bad perfect hash section.");
+  }
+  else
+  {
+    check(header->bucket_count > 0 && (header->bucket_count & (header->bucket_count - 1)) == 0, "Bad bucket count.");
+    check(header->buckets_offset == sizeof(SnapshotHeader) &&
+              header->entries_offset == header->buckets_offset + (header->bucket_count + 1) * sizeof(uint64_t),
+          "Bad bucket section offsets.");
+    mht->mask = header->bucket_count - 1;
+    mht->bucket_starts = (uint64_t *)((char *)base + header->buckets_offset);
+    check(mht->bucket_starts[header->bucket_count] == header->count, "Bad bucket starts.");
+  }
+  mht->count = header->count;
+  mht->seed = header->seed;
+  mht->entries = (SnapshotEntry *)((char *)base + header->entries_offset);
+  mht->heap = (char *)base + header->heap_offset;
+  mht->heap_size = header->heap_size;
+  return mht;
+
+error:
+  free(mht);
+  return NULL;
+}
+
+/*
+  The key_len bytes at key if they are the key of entry, followed by
+  the value. NULL for another key, or a corrupt entry pointing past the
+  heap.
+ */
+static char *snapshot_entry_key(MappedHashTable *mht, SnapshotEntry *entry, uint64_t keyHash, const void *key, size_t key_len)
+{
+  // the hash tag rules out other keys before the heap is touched
+  if (entry->hash != keyHash || entry->key_len != key_len)
+  {
+    return NULL;
+  }
+  if (entry->offset > mht->heap_size || entry->key_len + entry->value_len + 2 > mht->heap_size - entry->offset)
+  {
+    return NULL;
+  }
+  char *stored_key = mht->heap + entry->offset;
+  return memcmp(stored_key, key, key_len) == 0 ? stored_key : NULL;
+}
+
+/*
+  The one entry a key can be in a perfect hash snapshot.
+ */
+static uint64_t snapshot_perfect_entry(MappedHashTable *mht, uint64_t keyHash)
+{
+  SnapshotPerfectHash *perfect = mht->perfect;
+  uint64_t b = snapshot_perfect_bucket(keyHash, perfect->dense_buckets, mht->bucket_count);
+  uint64_t pilot = snapshot_perfect_pilot(mht->pilots, perfect->pilot_bits, b);
+  uint64_t slot = snapshot_perfect_position(keyHash, snapshot_perfect_pilot_mix(pilot), perfect->table_size);
+  return slot < mht->count ? slot : mht->remap[slot - mht->count];
+}
+
+char *mapped_hash_table_retrieve(MappedHashTable *mht, char *key)
+{
+  return mapped_hash_table_retrieve_bytes(mht, key, strlen(key), NULL);
+}
+
+/*
+  Return the value stored under the key_len bytes at key, pointing into
+  the mapping, or NULL if the key is not found. When value_len is not
+  NULL it is set to the length of the value. The value is always
+  followed by a NUL byte.
+ */
+void *mapped_hash_table_retrieve_bytes(MappedHashTable *mht, const void *key, size_t key_len, size_t *value_len)
+{
+  uint64_t keyHash = hash_wyhash(key, key_len, mht->seed);
+  char *stored_key = NULL;
+  SnapshotEntry *entry = NULL;
+  if (mht->perfect != NULL)
+  {
+    // exactly one probe, a key that is not in the table fails on the hash tag
+    if (mht->count > 0)
+    {
+      uint64_t e = snapshot_perfect_entry(mht, keyHash);
+      entry = e < mht->count ? &mht->entries[e] : NULL;
+      stored_key = entry != NULL ? snapshot_entry_key(mht, entry, keyHash, key, key_len) : NULL;
+    }
+  }
+  else
+  {
+    uint64_t bucket = keyHash & mht->mask;
+    uint64_t end = mht->bucket_starts[bucket + 1];
+    for (uint64_t e = mht->bucket_starts[bucket]; stored_key == NULL && e < end && e < mht->count; e++)
+    {
+      entry = &mht->entries[e];
+      stored_key = snapshot_entry_key(mht, entry, keyHash, key, key_len);
+    }
+  }
+  if (stored_key == NULL)
+  {
+    return NULL;
+  }
+  if (value_len != NULL)
+  {
+    *value_len = entry->value_len;
+  }
+  return stored_key + entry->key_len + 1;
+}
+
+/*
+  Read the snapshot at path into a new, writable HashTable. Returns NULL
+  if the file cannot be mapped or is not a snapshot.
+ */
+HashTable *hash_table_load(const char *path)
+{
+  MappedHashTable *mht = hash_table_open_mapped(path);
+  if (mht == NULL)
+  {
+    return NULL;
+  }
+  HashTable *ht = create_hash_table((int)(mht->count / HASH_TABLE_MAX_LOAD) + 1);
+  for (uint64_t e = 0; e < mht->count; e++)
+  {
+    SnapshotEntry *entry = &mht->entries[e];
+    if (entry->offset > mht->heap_size || entry->key_len + entry->value_len + 2 > mht->heap_size - entry->offset)
+    {
+      continue;
+    }
+    char *stored_key = mht->heap + entry->offset;
+    hash_table_insert_bytes(ht, stored_key, entry->key_len, stored_key + entry->key_len + 1, entry->value_len);
+  }
+  destroy_mapped_hash_table(mht);
+  return ht;
+}
+
+void destroy_mapped_hash_table(MappedHashTable *mht)
+{
+  if (mht->owned)
+  {
+    free(mht->base);
+  }
+  else
+  {
+    munmap(mht->base, mht->size);
+  }
+  free(mht);
+}
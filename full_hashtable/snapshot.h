@@ -0,0 +1,170 @@
+#ifndef snapshot_h
+#define snapshot_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hashtables.h"
+
+#define SNAPSHOT_MAGIC "HTSNAP\0\0"
+#define SNAPSHOT_VERSION 1
+
+// header flag: the bucket section holds a minimal perfect hash, see below
+#define SNAPSHOT_PERFECT_HASH 1
+
+/*
+  Snapshot file layout. All offsets are byte offsets from the start of
+  the file and all integers are in the byte order of the machine that
+  wrote it, so a file can be mapped anywhere and used in place.
+
+    SnapshotHeader
+    uint64_t bucket_starts[bucket_count + 1]
+    SnapshotEntry entries[count]
+    string heap: key bytes, NUL, value bytes, NUL, for every entry
+
+  The entries of bucket b are entries[bucket_starts[b]] up to
+  entries[bucket_starts[b + 1]], stored next to each other. Each entry is
+  tagged with the full hash of its key, so a lookup only reads the heap
+  for an entry whose hash matches.
+
+  Snapshots of frozen tables (see frozen_hashtable.h) set
+  SNAPSHOT_PERFECT_HASH and replace the bucket starts with a minimal
+  perfect hash of the keys, which names the one entry a key can be:
+
+    SnapshotHeader
+    SnapshotPerfectHash
+    uint64_t pilots[pilot_words], pilot_bits bits per bucket
+    uint32_t remap[remap_count], padded to 8 bytes
+    SnapshotEntry entries[count]
+    string heap
+
+  Here bucket_count is the number of pilot buckets, not a power of two.
+ */
+typedef struct SnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t flags;
+  uint64_t seed;
+  uint64_t count;
+  uint64_t bucket_count;
+  uint64_t buckets_offset;
+  uint64_t entries_offset;
+  uint64_t heap_offset;
+  uint64_t heap_size;
+  uint64_t file_size;
+} SnapshotHeader;
+
+/*
+  PTHash style minimal perfect hash: a key's hash picks its bucket, the
+  bucket's pilot moves all of its keys to free slots of a table of
+  table_size slots. Slots from count up are remapped into the holes
+  below count, so the slots used end up being exactly 0 to count - 1.
+ */
+typedef struct SnapshotPerfectHash {
+  uint64_t table_size;
+  uint64_t dense_buckets;
+  uint64_t pilot_bits;
+  uint64_t pilot_words;
+  uint64_t remap_count;
+} SnapshotPerfectHash;
+
+typedef struct SnapshotEntry {
+  uint64_t hash;
+  uint64_t offset;
+  uint64_t key_len;
+  uint64_t value_len;
+} SnapshotEntry;
+
+/*
+  Read only table served straight from a mapped snapshot file, or from
+  an image of one in memory when `owned` is set. `perfect` is NULL
+  unless the snapshot has a minimal perfect hash.
+ */
+typedef struct MappedHashTable {
+  void *base;
+  size_t size;
+  int owned;
+  uint64_t count;
+  uint64_t mask;
+  uint64_t seed;
+  uint64_t *bucket_starts;
+  SnapshotPerfectHash *perfect;
+  uint64_t bucket_count;
+  uint64_t *pilots;
+  uint32_t *remap;
+  SnapshotEntry *entries;
+  char *heap;
+  uint64_t heap_size;
+} MappedHashTable;
+
+
+int hash_table_save(HashTable *ht, const char *path);
+
+MappedHashTable *hash_table_open_mapped(const char *path);
+
+MappedHashTable *snapshot_attach(void *base, size_t size, int owned);
+
+LinkedPair **snapshot_collect_pairs(HashTable *ht, uint64_t *count);
+
+char *mapped_hash_table_retrieve(MappedHashTable *mht, char *key);
+
+void *mapped_hash_table_retrieve_bytes(MappedHashTable *mht, const void *key, size_t key_len, size_t *value_len);
+
+HashTable *hash_table_load(const char *path);
+
+void destroy_mapped_hash_table(MappedHashTable *mht);
+
+
+/*
+  Slot of a key in a perfect hash snapshot, shared by the builder in
+  frozen_hashtable.c and the lookups here. The low half of the hash
+  sends 60% of the keys to the first 30% of the buckets, which the
+  builder handles first while the table is still empty.
+ */
+static inline uint64_t snapshot_perfect_bucket(uint64_t keyHash, uint64_t dense_buckets, uint64_t bucket_count)
+{
+  uint64_t high = keyHash >> 32;
+  if ((uint32_t)keyHash < (uint32_t)(0.6 * 4294967296.0))
+  {
+    return (high * dense_buckets) >> 32;
+  }
+  return dense_buckets + ((high * (bucket_count - dense_buckets)) >> 32);
+}
+
+static inline uint64_t snapshot_perfect_pilot_mix(uint64_t pilot)
+{
+  return hash_wy_mix(pilot ^ 0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull);
+}
+
+/*
+  The key hash and the pilot are mixed together before the reduction,
+  so the keys of one bucket land on independent slots for every pilot.
+ */
+static inline uint64_t snapshot_perfect_position(uint64_t keyHash, uint64_t pilot_mix, uint64_t table_size)
+{
+  uint64_t mixed = hash_wy_mix(keyHash ^ pilot_mix, 0x9e3779b97f4a7c15ull);
+  return (uint64_t)(((__uint128_t)mixed * table_size) >> 64);
+}
+
+/*
+  The pilot of bucket b. The pilot array has one spare word at the end,
+  so a pilot can always be read from two words.
+ */
+static inline uint64_t snapshot_perfect_pilot(const uint64_t *pilots, uint64_t pilot_bits, uint64_t b)
+{
+  if (pilot_bits == 0)
+  {
+    return 0;
+  }
+  uint64_t bit = b * pilot_bits;
+  uint64_t word = bit >> 6, shift = bit & 63;
+  uint64_t value = pilots[word] >> shift;
+  if (shift + pilot_bits > 64)
+  {
+    value |= pilots[word + 1] << (64 - shift);
+  }
+  return value & (pilot_bits == 64 ? ~0ull : (1ull << pilot_bits) - 1);
+}
+
+
+#endif
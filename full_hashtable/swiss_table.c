@@ -0,0 +1,330 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+// SSE2 group matching, unless SWISS_NO_SIMD asks for the portable loops
+#if defined(__SSE2__) && !defined(SWISS_NO_SIMD)
+#define SWISS_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "swiss_table.h"
+
+/*
+  Open addressed hash table with SwissTable style control bytes.
+
+  Slots are split into groups of SWISS_GROUP_WIDTH. Next to the slot array
+  sits a byte array `ctrl` with one control byte per slot:
+
+    SWISS_EMPTY    slot has never been used since the last rehash
+    SWISS_DELETED  slot held an entry that was removed (a tombstone)
+    0..127         slot is full, the byte is the low 7 bits of its hash
+
+  A probe loads a whole group of control bytes and compares all of them
+  with the 7 bit hash fragment at once (one SSE2 compare + movemask on
+  x86, a plain loop elsewhere). Only slots whose fragment matches ever
+  have their key compared, and a group with an empty slot ends the probe,
+  so most misses are answered from the control bytes alone.
+ */
+
+#define SWISS_EMPTY ((signed char)-128)
+#define SWISS_DELETED ((signed char)-2)
+
+// keep at least 1/8 of the slots empty so probes terminate quickly
+#define SWISS_MAX_LOAD_NUM 7
+#define SWISS_MAX_LOAD_DEN 8
+
+/*
+  Full hash of key with the table's hash function and seed. Both h1 and
+  h2 come from it, so it has to be well mixed in every bit: with a weak
+  hash, runs of similar keys start their probes in neighbouring groups
+  and pile up.
+ */
+static uint64_t swiss_hash(SwissTable *st, char *key)
+{
+  return st->hash_function(key, strlen(key), st->seed);
+}
+
+/*
+  h1 picks the group a probe starts at, h2 is the fragment kept in ctrl.
+ */
+static uint64_t swiss_h1(uint64_t hash)
+{
+  return hash >> 7;
+}
+
+static signed char swiss_h2(uint64_t hash)
+{
+  return (signed char)(hash & 0x7f);
+}
+
+/*
+  Bit i of the result is set when control byte i of the group equals byte.
+ */
+static unsigned int swiss_match(const signed char *group, signed char byte)
+{
+#ifdef SWISS_SSE2
+  __m128i ctrl = _mm_load_si128((const __m128i *)group);
+  return (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(byte)));
+#else
+  unsigned int mask = 0;
+  for (int i = 0; i < SWISS_GROUP_WIDTH; i++)
+  {
+    if (group[i] == byte)
+    {
+      mask |= 1u << i;
+    }
+  }
+  return mask;
+#endif
+}
+
+/*
+  Bit i of the result is set when slot i of the group is empty or deleted.
+  Both markers have their sign bit set and full slots never do.
+ */
+static unsigned int swiss_match_free(const signed char *group)
+{
+#ifdef SWISS_SSE2
+  return (unsigned int)_mm_movemask_epi8(_mm_load_si128((const __m128i *)group));
+#else
+  unsigned int mask = 0;
+  for (int i = 0; i < SWISS_GROUP_WIDTH; i++)
+  {
+    if (group[i] < 0)
+    {
+      mask |= 1u << i;
+    }
+  }
+  return mask;
+#endif
+}
+
+/*
+  Capacity is a power of two and at least one group.
+ */
+static int swiss_round_capacity(int capacity)
+{
+  int rounded = SWISS_GROUP_WIDTH;
+  while (rounded < capacity)
+  {
+    rounded <<= 1;
+  }
+  return rounded;
+}
+
+/*
+  Allocate empty control bytes and slots for capacity slots.
+ */
+static void swiss_alloc(SwissTable *st, int capacity)
+{
+  st->capacity = capacity;
+  st->count = 0;
+  st->deleted = 0;
+  // the control bytes are read a group at a time with aligned loads
+  st->ctrl = aligned_alloc(SWISS_GROUP_WIDTH, capacity);
+  memset(st->ctrl, SWISS_EMPTY, capacity);
+  st->slots = calloc(capacity, sizeof(SwissSlot));
+}
+
+/*
+  Return the slot index holding key, or -1 if it is not in the table.
+
+  Groups are visited in triangular order (+1, +2, +3 ...), which touches
+  every group exactly once when the group count is a power of two.
+ */
+static long swiss_find(SwissTable *st, char *key, uint64_t hash)
+{
+  unsigned long group_mask = (unsigned long)st->capacity / SWISS_GROUP_WIDTH - 1;
+  unsigned long group = (unsigned long)(swiss_h1(hash) & group_mask);
+  signed char h2 = swiss_h2(hash);
+  for (unsigned long step = 1; step <= group_mask + 1; step++)
+  {
+    signed char *ctrl = st->ctrl + group * SWISS_GROUP_WIDTH;
+    unsigned int matches = swiss_match(ctrl, h2);
+    while (matches)
+    {
+      unsigned long index = group * SWISS_GROUP_WIDTH + __builtin_ctz(matches);
+      SwissSlot *slot = &st->slots[index];
+      if (slot->hash == hash && strcmp(slot->key, key) == 0)
+      {
+        return (long)index;
+      }
+      // clear the lowest set bit and try the next candidate
+      matches &= matches - 1;
+    }
+    // an empty slot means the key was never pushed past this group
+    if (swiss_match(ctrl, SWISS_EMPTY))
+    {
+      return -1;
+    }
+    group = (group + step) & group_mask;
+  }
+  return -1;
+}
+
+/*
+  Return the first empty or deleted slot on the probe sequence of hash.
+  The load factor guarantees one exists.
+ */
+static unsigned long swiss_find_free(SwissTable *st, uint64_t hash)
+{
+  unsigned long group_mask = (unsigned long)st->capacity / SWISS_GROUP_WIDTH - 1;
+  unsigned long group = (unsigned long)(swiss_h1(hash) & group_mask);
+  unsigned long step = 1;
+  unsigned int free_slots;
+  while (!(free_slots = swiss_match_free(st->ctrl + group * SWISS_GROUP_WIDTH)))
+  {
+    group = (group + step++) & group_mask;
+  }
+  return group * SWISS_GROUP_WIDTH + __builtin_ctz(free_slots);
+}
+
+/*
+  Move every entry into fresh arrays of new_capacity, dropping tombstones.
+  Entries are moved with their cached hash, nothing is copied or re-hashed.
+ */
+static void swiss_rehash(SwissTable *st, int new_capacity)
+{
+  int old_capacity = st->capacity;
+  signed char *old_ctrl = st->ctrl;
+  SwissSlot *old_slots = st->slots;
+  int count = st->count;
+  swiss_alloc(st, new_capacity);
+  for (int i = 0; i < old_capacity; i++)
+  {
+    if (old_ctrl[i] >= 0)
+    {
+      unsigned long index = swiss_find_free(st, old_slots[i].hash);
+      st->ctrl[index] = old_ctrl[i];
+      st->slots[index] = old_slots[i];
+    }
+  }
+  st->count = count;
+  free(old_ctrl);
+  free(old_slots);
+}
+
+/*
+  All control bytes start out empty.
+ */
+SwissTable *create_swiss_table(int capacity)
+{
+  SwissTable *st = malloc(sizeof(SwissTable));
+  swiss_alloc(st, swiss_round_capacity(capacity));
+  // seeded wyhash, see swiss_hash
+  st->hash_function = hash_wyhash;
+  st->seed = hash_random_seed();
+  return st;
+}
+
+/*
+  Inserting an existing key overwrites its value.
+
+  Before a new key would push the used slots (full + tombstones) past the
+  max load, the table is rehashed: in place when tombstones make up most
+  of the used slots, at double the capacity otherwise.
+ */
+void swiss_table_insert(SwissTable *st, char *key, char *value)
+{
+  uint64_t hash = swiss_hash(st, key);
+  long found = swiss_find(st, key, hash);
+  if (found >= 0)
+  {
+    free(st->slots[found].value);
+    st->slots[found].value = strdup(value);
+    return;
+  }
+  long used = (long)st->count + st->deleted + 1;
+  if (used * SWISS_MAX_LOAD_DEN > (long)st->capacity * SWISS_MAX_LOAD_NUM)
+  {
+    swiss_rehash(st, st->deleted > st->count ? st->capacity : st->capacity * 2);
+  }
+  unsigned long index = swiss_find_free(st, hash);
+  if (st->ctrl[index] == SWISS_DELETED)
+  {
+    st->deleted--;
+  }
+  st->ctrl[index] = swiss_h2(hash);
+  st->slots[index].key = strdup(key);
+  st->slots[index].value = strdup(value);
+  st->slots[index].hash = hash;
+  st->count++;
+}
+
+/*
+  A removed slot can go straight back to empty when its group still has
+  an empty slot: no probe ever continued past this group, so none can be
+  cut short. Otherwise it has to become a tombstone.
+ */
+void swiss_table_remove(SwissTable *st, char *key)
+{
+  long found = swiss_find(st, key, swiss_hash(st, key));
+  if (found < 0)
+  {
+    return;
+  }
+  signed char *group = st->ctrl + (found / SWISS_GROUP_WIDTH) * SWISS_GROUP_WIDTH;
+  free(st->slots[found].key);
+  free(st->slots[found].value);
+  memset(&st->slots[found], 0, sizeof(SwissSlot));
+  if (swiss_match(group, SWISS_EMPTY))
+  {
+    st->ctrl[found] = SWISS_EMPTY;
+  }
+  else
+  {
+    st->ctrl[found] = SWISS_DELETED;
+    st->deleted++;
+  }
+  st->count--;
+}
+
+/*
+  Return NULL if the key is not found.
+ */
+char *swiss_table_retrieve(SwissTable *st, char *key)
+{
+  long found = swiss_find(st, key, swiss_hash(st, key));
+  if (found < 0)
+  {
+    return NULL;
+  }
+  return st->slots[found].value;
+}
+
+void destroy_swiss_table(SwissTable *st)
+{
+  for (int i = 0; i < st->capacity; i++)
+  {
+    if (st->ctrl[i] >= 0)
+    {
+      free(st->slots[i].key);
+      free(st->slots[i].value);
+    }
+  }
+  free(st->ctrl);
+  free(st->slots);
+  free(st);
+}
+
+/*
+  Double the capacity. The table is resized in place and the same pointer
+  is returned, like `rh_table_resize`.
+ */
+SwissTable *swiss_table_resize(SwissTable *st)
+{
+  swiss_rehash(st, st->capacity * 2);
+  return st;
+}
+
+/*
+  Hash keys with hash_function keyed by seed instead of the default
+  seeded wyhash, see utils/hash.h.
+
+  Only call this on an empty table, stored entries are not moved.
+ */
+void swiss_table_set_hash_function(SwissTable *st, HashFunction hash_function, uint64_t seed)
+{
+  st->hash_function = hash_function;
+  st->seed = seed;
+}
@@ -0,0 +1,42 @@
+#ifndef swiss_table_h
+#define swiss_table_h
+
+#include <stdint.h>
+
+#include "../utils/hash.h"
+
+#define SWISS_GROUP_WIDTH 16
+
+typedef struct SwissSlot {
+  char *key;
+  char *value;
+  uint64_t hash;
+} SwissSlot;
+
+typedef struct SwissTable {
+  int capacity;
+  int count;
+  int deleted;
+  signed char *ctrl;
+  SwissSlot *slots;
+  HashFunction hash_function;
+  uint64_t seed;
+} SwissTable;
+
+
+SwissTable *create_swiss_table(int capacity);
+
+void swiss_table_insert(SwissTable *st, char *key, char *value);
+
+void swiss_table_remove(SwissTable *st, char *key);
+
+char *swiss_table_retrieve(SwissTable *st, char *key);
+
+void destroy_swiss_table(SwissTable *st);
+
+SwissTable *swiss_table_resize(SwissTable *st);
+
+void swiss_table_set_hash_function(SwissTable *st, HashFunction hash_function, uint64_t seed);
+
+
+#endif
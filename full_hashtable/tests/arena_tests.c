@@ -0,0 +1,66 @@
+#include <arena.h>
+#include "../utils/minunit.h"
+
+char *test_arena_reuses_freed_blocks()
+{
+    Arena *arena = create_arena(ARENA_CHUNK_SIZE);
+
+    char *first = arena_alloc(arena, 20);
+    char *second = arena_alloc(arena, 20);
+    mu_assert(second == first + 32, "Small blocks are not bumped next to each other");
+
+    arena_free(arena, first, 20);
+    // any size in the same class gets the freed block back
+    mu_assert(arena_alloc(arena, 30) == first, "Freed block was not reused");
+    // a different class does not
+    mu_assert(arena_alloc(arena, 40) != first, "Block reused across size classes");
+
+    destroy_arena(arena);
+
+    return NULL;
+}
+
+char *test_arena_large_blocks()
+{
+    Arena *arena = create_arena(ARENA_CHUNK_SIZE);
+
+    char *large = arena_alloc(arena, ARENA_CHUNK_SIZE * 2);
+    memset(large, 'x', ARENA_CHUNK_SIZE * 2);
+    char *other = arena_alloc(arena, ARENA_MAX_SMALL + 1);
+    arena_free(arena, large, ARENA_CHUNK_SIZE * 2);
+    memset(other, 'y', ARENA_MAX_SMALL + 1);
+
+    // destroy releases the large block we never freed
+    destroy_arena(arena);
+
+    return NULL;
+}
+
+char *test_arena_fills_many_chunks()
+{
+    Arena *arena = create_arena(1024);
+
+    for (int i = 0; i < 10000; i++)
+    {
+        int *block = arena_alloc(arena, sizeof(int) * 4);
+        block[0] = block[3] = i;
+    }
+    mu_assert(arena->chunks != NULL && arena->chunks->next != NULL, "Arena did not start new chunks");
+
+    destroy_arena(arena);
+
+    return NULL;
+}
+
+char *all_tests()
+{
+    mu_suite_start();
+
+    mu_run_test(test_arena_reuses_freed_blocks);
+    mu_run_test(test_arena_large_blocks);
+    mu_run_test(test_arena_fills_many_chunks);
+
+    return NULL;
+}
+
+RUN_TESTS(all_tests);
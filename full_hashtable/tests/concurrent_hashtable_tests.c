@@ -0,0 +1,181 @@
+#include <concurrent_hashtable.h>
+#include <time.h>
+#include <unistd.h>
+#include "../utils/minunit.h"
+
+#define WRITER_KEYS 2000
+#define THROUGHPUT_KEYS 10000
+#define THROUGHPUT_OPS 200000
+
+typedef struct Worker {
+    ConcurrentHashTable *cht;
+    int id;
+    int ops;
+    long misses;
+} Worker;
+
+static double now_seconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+  Each writer inserts its own keys, overwrites them, removes every other
+  one and reads the rest back, while the table resizes under it.
+ */
+static void *writer(void *arg)
+{
+    Worker *worker = arg;
+    char key[32], val[32], out[32];
+    for (int i = 0; i < WRITER_KEYS; i++)
+    {
+        sprintf(key, "w%d-key-%d", worker->id, i);
+        concurrent_hash_table_insert(worker->cht, key, key);
+    }
+    for (int i = 0; i < WRITER_KEYS; i++)
+    {
+        sprintf(key, "w%d-key-%d", worker->id, i);
+        sprintf(val, "w%d-val-%d", worker->id, i);
+        concurrent_hash_table_insert(worker->cht, key, val);
+        if (i % 2 == 0)
+        {
+            concurrent_hash_table_remove(worker->cht, key);
+        }
+    }
+    for (int i = 0; i < WRITER_KEYS; i++)
+    {
+        sprintf(key, "w%d-key-%d", worker->id, i);
+        sprintf(val, "w%d-val-%d", worker->id, i);
+        long len = concurrent_hash_table_retrieve(worker->cht, key, out, sizeof(out));
+        if ((i % 2 == 0) != (len < 0) || (len >= 0 && strcmp(out, val) != 0))
+        {
+            worker->misses++;
+        }
+    }
+    return NULL;
+}
+
+/*
+  95% retrieves and 5% overwrites over a preloaded key set.
+ */
+static void *mixed_worker(void *arg)
+{
+    Worker *worker = arg;
+    char key[32], out[32];
+    unsigned int seed = worker->id * 7919 + 1;
+    for (int i = 0; i < worker->ops; i++)
+    {
+        sprintf(key, "tp-key-%d", rand_r(&seed) % THROUGHPUT_KEYS);
+        if (i % 20 == 0)
+        {
+            concurrent_hash_table_insert(worker->cht, key, key);
+        }
+        else if (concurrent_hash_table_retrieve(worker->cht, key, out, sizeof(out)) < 0)
+        {
+            worker->misses++;
+        }
+    }
+    return NULL;
+}
+
+static long run_workers(ConcurrentHashTable *cht, int threads, int ops, void *(*fn)(void *))
+{
+    pthread_t ids[64];
+    Worker workers[64];
+    long misses = 0;
+    for (int t = 0; t < threads; t++)
+    {
+        workers[t] = (Worker){cht, t, ops, 0};
+        pthread_create(&ids[t], NULL, fn, &workers[t]);
+    }
+    for (int t = 0; t < threads; t++)
+    {
+        pthread_join(ids[t], NULL);
+        misses += workers[t].misses;
+    }
+    return misses;
+}
+
+char *test_concurrent_writers()
+{
+    ConcurrentHashTable *cht = create_concurrent_hash_table(8, 16);
+
+    long misses = run_workers(cht, 8, 0, writer);
+    mu_assert(misses == 0, "Concurrent writers lost or corrupted keys");
+    mu_assert(concurrent_hash_table_count(cht) == 8 * WRITER_KEYS / 2, "Concurrent count is wrong");
+    mu_assert(cht->capacity >= 8 * WRITER_KEYS / 2 / 0.7, "Table did not grow under concurrent inserts");
+
+    destroy_concurrent_hash_table(cht);
+
+    return NULL;
+}
+
+char *test_concurrent_retrieve_truncates()
+{
+    ConcurrentHashTable *cht = create_concurrent_hash_table(8, 4);
+    char out[4];
+
+    concurrent_hash_table_insert(cht, "key", "long-value");
+    mu_assert(concurrent_hash_table_retrieve(cht, "key", out, sizeof(out)) == 10, "Retrieve did not report the full length");
+    mu_assert(strcmp(out, "lon") == 0, "Retrieve did not truncate to the buffer");
+    mu_assert(concurrent_hash_table_retrieve(cht, "missing", out, sizeof(out)) == -1, "Missing key was found");
+
+    concurrent_hash_table_resize(cht);
+    mu_assert(cht->capacity == 16, "Resize did not double capacity");
+    mu_assert(concurrent_hash_table_retrieve(cht, "key", NULL, 0) == 10, "Resize lost a key");
+
+    destroy_concurrent_hash_table(cht);
+
+    return NULL;
+}
+
+/*
+  Not a pass/fail check: prints ops/sec from 1 thread up to N so scaling
+  can be compared across machines. N is twice the online cores, at least 4.
+ */
+char *test_concurrent_throughput_scaling()
+{
+    ConcurrentHashTable *cht = create_concurrent_hash_table(THROUGHPUT_KEYS * 2, 256);
+    char key[32];
+    for (int i = 0; i < THROUGHPUT_KEYS; i++)
+    {
+        sprintf(key, "tp-key-%d", i);
+        concurrent_hash_table_insert(cht, key, key);
+    }
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_threads = cores * 2 < 4 ? 4 : (cores * 2 > 64 ? 64 : (int)cores * 2);
+    double single = 0;
+    for (int threads = 1; threads <= max_threads; threads *= 2)
+    {
+        double start = now_seconds();
+        long misses = run_workers(cht, threads, THROUGHPUT_OPS, mixed_worker);
+        double elapsed = now_seconds() - start;
+        double ops_per_sec = threads * (double)THROUGHPUT_OPS / elapsed;
+        if (threads == 1)
+        {
+            single = ops_per_sec;
+        }
+        printf("concurrent_hash_table threads=%d ops/sec=%.0f scaling=%.2fx\n", threads, ops_per_sec, ops_per_sec / single);
+        mu_assert(misses == 0, "Preloaded key went missing");
+    }
+
+    destroy_concurrent_hash_table(cht);
+
+    return NULL;
+}
+
+char *all_tests()
+{
+    mu_suite_start();
+
+    mu_run_test(test_concurrent_writers);
+    mu_run_test(test_concurrent_retrieve_truncates);
+    mu_run_test(test_concurrent_throughput_scaling);
+
+    return NULL;
+}
+
+RUN_TESTS(all_tests);
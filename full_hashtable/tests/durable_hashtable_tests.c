@@ -0,0 +1,251 @@
+#include <durable_hashtable.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include "../utils/minunit.h"
+
+#define WRITER_KEYS 500
+
+static char durable_dir[64];
+
+typedef struct Worker {
+    DurableHashTable *dht;
+    int id;
+    long failures;
+} Worker;
+
+static void *writer(void *arg)
+{
+    Worker *worker = arg;
+    char key[32];
+    for (int i = 0; i < WRITER_KEYS; i++)
+    {
+        sprintf(key, "w%d-key-%d", worker->id, i);
+        if (durable_hash_table_insert(worker->dht, key, key) != 0)
+        {
+            worker->failures++;
+        }
+    }
+    return NULL;
+}
+
+typedef struct Compactor {
+    DurableHashTable *dht;
+    atomic_int done;
+    long compactions;
+} Compactor;
+
+/*
+  Keep rotating segments under the writers, each rotation has to wait
+  out the flush leader that is still writing to the old segment.
+ */
+static void *compactor(void *arg)
+{
+    Compactor *background = arg;
+    while (!background->done)
+    {
+        if (durable_hash_table_compact(background->dht) == 0)
+        {
+            background->compactions++;
+        }
+    }
+    return NULL;
+}
+
+static void remove_dir(const char *dir)
+{
+    char path[512];
+    DIR *d = opendir(dir);
+    struct dirent *entry;
+    while (d != NULL && (entry = readdir(d)) != NULL)
+    {
+        if (entry->d_name[0] != '.')
+        {
+            sprintf(path, "%s/%s", dir, entry->d_name);
+            unlink(path);
+        }
+    }
+    if (d != NULL)
+    {
+        closedir(d);
+    }
+    rmdir(dir);
+}
+
+static int count_files(const char *dir, const char *prefix)
+{
+    int count = 0;
+    DIR *d = opendir(dir);
+    struct dirent *entry;
+    while ((entry = readdir(d)) != NULL)
+    {
+        count += strncmp(entry->d_name, prefix, strlen(prefix)) == 0;
+    }
+    closedir(d);
+    return count;
+}
+
+char *test_durable_recovers_after_reopen()
+{
+    remove_dir(durable_dir);
+    DurableHashTable *dht = open_durable_hash_table(durable_dir);
+    char key[32], out[32];
+    mu_assert(dht != NULL, "Durable table was not opened");
+
+    for (int i = 0; i < 100; i++)
+    {
+        sprintf(key, "key-%d", i);
+        mu_assert(durable_hash_table_insert(dht, key, key) == 0, "Insert was not made durable");
+    }
+    durable_hash_table_insert(dht, "key-0", "new-val-0");
+    durable_hash_table_remove(dht, "key-1");
+    destroy_durable_hash_table(dht);
+
+    // reopening replays the log, twice to also replay after a compaction
+    for (int round = 0; round < 2; round++)
+    {
+        dht = open_durable_hash_table(durable_dir);
+        mu_assert(dht != NULL, "Durable table was not reopened");
+        mu_assert(durable_hash_table_retrieve(dht, "key-0", out, sizeof(out)) == 9 && strcmp(out, "new-val-0") == 0, "Overwrite was not recovered");
+        mu_assert(durable_hash_table_retrieve(dht, "key-1", out, sizeof(out)) == -1, "Remove was not recovered");
+        mu_assert(durable_hash_table_retrieve(dht, "key-99", out, sizeof(out)) == 6, "Insert was not recovered");
+        mu_assert(dht->ht->count == 99, "Recovered table has the wrong count");
+        destroy_durable_hash_table(dht);
+    }
+    mu_assert(count_files(durable_dir, "snapshot.") == 1, "Compaction did not leave one snapshot");
+    mu_assert(count_files(durable_dir, "wal.") == 1, "Compaction did not delete the replayed segments");
+
+    return NULL;
+}
+
+char *test_durable_ignores_torn_tail()
+{
+    remove_dir(durable_dir);
+    DurableHashTable *dht = open_durable_hash_table(durable_dir);
+    char path[128], out[32];
+    durable_hash_table_insert(dht, "first", "1");
+    durable_hash_table_insert(dht, "second", "2");
+    sprintf(path, "%s/wal.%llu", durable_dir, (unsigned long long)dht->generation);
+    destroy_durable_hash_table(dht);
+
+    // a crash in the middle of a write leaves part of a record behind
+    int fd = open(path, O_WRONLY | O_APPEND);
+    mu_assert(write(fd, "I\005\003thi", 6) == 6, "Could not write a torn record");
+    close(fd);
+
+    dht = open_durable_hash_table(durable_dir);
+    mu_assert(durable_hash_table_retrieve(dht, "first", out, sizeof(out)) == 1, "Record before the torn one was lost");
+    mu_assert(durable_hash_table_retrieve(dht, "second", out, sizeof(out)) == 1, "Record before the torn one was lost");
+    mu_assert(dht->ht->count == 2, "Torn record was replayed");
+    // new records go to a fresh segment, never behind the torn one
+    durable_hash_table_insert(dht, "third", "3");
+    destroy_durable_hash_table(dht);
+
+    dht = open_durable_hash_table(durable_dir);
+    mu_assert(durable_hash_table_retrieve(dht, "third", out, sizeof(out)) == 1, "Record after recovery was lost");
+    destroy_durable_hash_table(dht);
+
+    return NULL;
+}
+
+char *test_durable_group_commit_and_compaction()
+{
+    remove_dir(durable_dir);
+    DurableHashTable *dht = open_durable_hash_table(durable_dir);
+    char key[32], out[32];
+    // small segments, so several compactions run while the writers go on
+    dht->compact_bytes = 4096;
+
+    pthread_t ids[8];
+    Worker workers[8];
+    long failures = 0;
+    for (int t = 0; t < 8; t++)
+    {
+        workers[t] = (Worker){dht, t, 0};
+        pthread_create(&ids[t], NULL, writer, &workers[t]);
+    }
+    for (int t = 0; t < 8; t++)
+    {
+        pthread_join(ids[t], NULL);
+        failures += workers[t].failures;
+    }
+    mu_assert(failures == 0, "Concurrent inserts failed");
+    printf("durable_hash_table inserts=%d fsyncs=%ld\n", 8 * WRITER_KEYS, dht->syncs);
+    mu_assert(dht->generation > 1, "No compaction was started");
+    mu_assert(durable_hash_table_compact(dht) == 0 || dht->compacting, "Compaction could not be started");
+    destroy_durable_hash_table(dht);
+
+    dht = open_durable_hash_table(durable_dir);
+    for (int t = 0; t < 8; t++)
+    {
+        for (int i = 0; i < WRITER_KEYS; i++)
+        {
+            sprintf(key, "w%d-key-%d", t, i);
+            mu_assert(durable_hash_table_retrieve(dht, key, out, sizeof(out)) >= 0 && strcmp(out, key) == 0, "Insert was lost across compactions");
+        }
+    }
+    mu_assert(dht->ht->count == 8 * WRITER_KEYS, "Recovered table has the wrong count");
+    destroy_durable_hash_table(dht);
+    remove_dir(durable_dir);
+
+    return NULL;
+}
+
+char *test_durable_compaction_under_writers()
+{
+    remove_dir(durable_dir);
+    DurableHashTable *dht = open_durable_hash_table(durable_dir);
+    char key[32], out[32];
+
+    Compactor background = {dht, 0, 0};
+    pthread_t compactor_id;
+    pthread_create(&compactor_id, NULL, compactor, &background);
+    pthread_t ids[8];
+    Worker workers[8];
+    long failures = 0;
+    for (int t = 0; t < 8; t++)
+    {
+        workers[t] = (Worker){dht, t, 0};
+        pthread_create(&ids[t], NULL, writer, &workers[t]);
+    }
+    for (int t = 0; t < 8; t++)
+    {
+        pthread_join(ids[t], NULL);
+        failures += workers[t].failures;
+    }
+    background.done = 1;
+    pthread_join(compactor_id, NULL);
+    mu_assert(failures == 0 && !dht->failed, "Inserts failed while compacting");
+    mu_assert(background.compactions > 1, "Compactions did not run alongside the writers");
+    destroy_durable_hash_table(dht);
+
+    dht = open_durable_hash_table(durable_dir);
+    for (int t = 0; t < 8; t++)
+    {
+        for (int i = 0; i < WRITER_KEYS; i++)
+        {
+            sprintf(key, "w%d-key-%d", t, i);
+            mu_assert(durable_hash_table_retrieve(dht, key, out, sizeof(out)) >= 0, "Insert was lost to a rotation");
+        }
+    }
+    destroy_durable_hash_table(dht);
+    remove_dir(durable_dir);
+
+    return NULL;
+}
+
+char *all_tests()
+{
+    mu_suite_start();
+
+    sprintf(durable_dir, "/tmp/durable_tests_%d", (int)getpid());
+    mu_run_test(test_durable_recovers_after_reopen);
+    mu_run_test(test_durable_ignores_torn_tail);
+    mu_run_test(test_durable_group_commit_and_compaction);
+    mu_run_test(test_durable_compaction_under_writers);
+
+    return NULL;
+}
+
+RUN_TESTS(all_tests);
@@ -0,0 +1,111 @@
+#include <frozen_hashtable.h>
+#include <unistd.h>
+#include "../utils/minunit.h"
+
+#define FROZEN_KEYS 20000
+
+static char frozen_path[64];
+
+char *test_frozen_retrieval()
+{
+    struct HashTable *ht = create_hash_table(8);
+    hash_table_set_incremental_resize(ht, 1);
+    char key[32], value[32];
+    for (int i = 0; i < FROZEN_KEYS; i++)
+    {
+        sprintf(key, "frozen-key-%d", i);
+        sprintf(value, "frozen-val-%d", i);
+        hash_table_insert(ht, key, value);
+    }
+    hash_table_insert_bytes(ht, "bin\0key", 7, "bin\0value", 9);
+
+    FrozenHashTable *fht = hash_table_freeze(ht);
+    mu_assert(fht != NULL && fht->count == FROZEN_KEYS + 1, "Table was not frozen");
+    destroy_hash_table(ht);
+
+    for (int i = 0; i < FROZEN_KEYS; i++)
+    {
+        sprintf(key, "frozen-key-%d", i);
+        sprintf(value, "frozen-val-%d", i);
+        char *return_value = frozen_hash_table_retrieve(fht, key);
+        mu_assert(return_value != NULL && strcmp(return_value, value) == 0, "Frozen table lost a value");
+    }
+    size_t value_len = 0;
+    char *return_value = frozen_hash_table_retrieve_bytes(fht, "bin\0key", 7, &value_len);
+    mu_assert(return_value != NULL && value_len == 9 && memcmp(return_value, "bin\0value", 9) == 0, "Frozen table lost a binary value");
+    for (int i = 0; i < FROZEN_KEYS; i++)
+    {
+        sprintf(key, "missing-key-%d", i);
+        mu_assert(frozen_hash_table_retrieve(fht, key) == NULL, "Missing key was found");
+    }
+
+    // the perfect hash is pilots and remap only, about 3 bits per key
+    SnapshotPerfectHash *perfect = fht->perfect;
+    double bits = (perfect->pilot_words * 64.0 + perfect->remap_count * 32.0) / fht->count;
+    mu_assert(bits < 4, "Perfect hash takes too many bits per key");
+
+    // saved and mapped again, lookups still go through the perfect hash
+    mu_assert(frozen_hash_table_save(fht, frozen_path) == 0, "Frozen table was not saved");
+    destroy_frozen_hash_table(fht);
+    MappedHashTable *mht = hash_table_open_mapped(frozen_path);
+    mu_assert(mht != NULL && mht->perfect != NULL && mht->count == FROZEN_KEYS + 1, "Frozen snapshot was not mapped");
+    mu_assert(strcmp(mapped_hash_table_retrieve(mht, "frozen-key-7"), "frozen-val-7") == 0, "Mapped frozen snapshot lost a value");
+    mu_assert(mapped_hash_table_retrieve(mht, "frozen-key") == NULL, "Mapped frozen snapshot found a missing key");
+    destroy_mapped_hash_table(mht);
+
+    // and it loads back into a writable table
+    ht = hash_table_load(frozen_path);
+    mu_assert(ht != NULL && ht->count == FROZEN_KEYS + 1, "Frozen snapshot was not loaded");
+    mu_assert(strcmp(hash_table_retrieve(ht, "frozen-key-99"), "frozen-val-99") == 0, "Loaded table lost a value");
+    destroy_hash_table(ht);
+
+    unlink(frozen_path);
+
+    return NULL;
+}
+
+char *test_frozen_small_tables()
+{
+    struct HashTable *ht = create_hash_table(8);
+    FrozenHashTable *fht = hash_table_freeze(ht);
+    mu_assert(fht != NULL && fht->count == 0, "Empty table was not frozen");
+    mu_assert(frozen_hash_table_retrieve(fht, "key") == NULL, "Empty frozen table found a key");
+    destroy_frozen_hash_table(fht);
+
+    hash_table_insert(ht, "only", "one");
+    fht = hash_table_freeze(ht);
+    mu_assert(strcmp(frozen_hash_table_retrieve(fht, "only"), "one") == 0, "Single key was lost");
+    mu_assert(frozen_hash_table_retrieve(fht, "other") == NULL, "Other key was found");
+    destroy_frozen_hash_table(fht);
+
+    // a corrupt perfect hash section is rejected
+    char key[32];
+    for (int i = 0; i < 100; i++)
+    {
+        sprintf(key, "key-%d", i);
+        hash_table_insert(ht, key, key);
+    }
+    fht = hash_table_freeze(ht);
+    fht->perfect->pilot_words++;
+    mu_assert(frozen_hash_table_save(fht, frozen_path) == 0, "Frozen table was not saved");
+    mu_assert(hash_table_open_mapped(frozen_path) == NULL, "Corrupt perfect hash was mapped");
+    destroy_frozen_hash_table(fht);
+    destroy_hash_table(ht);
+
+    unlink(frozen_path);
+
+    return NULL;
+}
+
+char *all_tests()
+{
+    mu_suite_start();
+
+    sprintf(frozen_path, "/tmp/frozen_tests_%d.snap", (int)getpid());
+    mu_run_test(test_frozen_retrieval);
+    mu_run_test(test_frozen_small_tables);
+
+    return NULL;
+}
+
+RUN_TESTS(all_tests);
@@ -0,0 +1,127 @@
+#include <hash_map.hpp>
+#include <cmath>
+#include <memory>
+#include <string>
+#include "../utils/minunit.h"
+
+using hashtables::HashMap;
+
+char *test_hash_map_integer_keys()
+{
+    HashMap<uint64_t, uint64_t> map(4);
+    for (uint64_t id = 0; id < 1000; id++)
+    {
+        map.insert(id, id * 2);
+    }
+    map.insert(7, 70);
+    mu_assert(map.size() == 1000 && map.capacity() >= 1000 / 0.7, "Map did not grow with its pairs");
+    mu_assert(*map.find(uint64_t{7}) == 70, "Value is not overwritten correctly");
+    mu_assert(map.find(uint64_t{999}) != nullptr && *map.find(uint64_t{999}) == 1998, "Value is not stored correctly");
+    mu_assert(map.find(uint64_t{1000}) == nullptr, "Missing key has a value");
+
+    uint64_t *stable = map.find(uint64_t{500});
+    for (uint64_t id = 0; id < 1000; id++)
+    {
+        if (id != 500)
+        {
+            map.remove(id);
+        }
+    }
+    mu_assert(map.size() == 1 && map.capacity() < 1000, "Map did not shrink after removes");
+    mu_assert(map.find(uint64_t{500}) == stable && *stable == 1000, "Value moved during resizes");
+    mu_assert(!map.remove(uint64_t{1}), "Removed key is still there");
+
+    // the same checks as hash_table_set_load_factors
+    mu_assert(!map.set_load_factors(0.5, 0.3), "Load factors that resize on every insert/remove were accepted");
+    mu_assert(!map.set_load_factors(-1, 0.1) && !map.set_load_factors(0.7, std::nan("")), "Negative or NaN load factor was accepted");
+    mu_assert(map.set_load_factors(0, 0.5) && map.set_load_factors(0.7, 0.2), "Valid load factors were rejected");
+
+    return NULL;
+}
+
+char *test_hash_map_string_keys()
+{
+    HashMap<std::string, std::string> map;
+    std::string key = "line_1", value = "Tiny hash table";
+    map.insert(std::move(key), std::move(value));
+    map.insert("line_2", "Filled beyond capacity");
+    map.insert("line_2", "Overwritten");
+    map.emplace("line_3", 5, 'x');
+
+    // heterogeneous lookups, nothing is converted to std::string
+    std::string_view view = "line_1";
+    mu_assert(*map.find(view) == "Tiny hash table", "string_view lookup failed");
+    mu_assert(*map.find("line_2") == "Overwritten", "C string lookup failed");
+    mu_assert(*map.find(std::string("line_3")) == "xxxxx", "Emplaced value is wrong");
+
+    mu_assert(map.remove(view) && !map.contains("line_1"), "Key is not removed");
+
+    // C string keys are compared by contents, not by address
+    HashMap<const char *, int> by_name;
+    char stored[] = "name", other[] = "name";
+    by_name.insert(stored, 1);
+    mu_assert(by_name.find(other) != nullptr && *by_name.find(other) == 1, "Equal C string at another address was not found");
+    by_name.insert(other, 2);
+    mu_assert(by_name.size() == 1 && *by_name.find("name") == 2, "Equal C string was inserted twice");
+    map.clear();
+    mu_assert(map.empty() && map.find("line_2") == nullptr, "Map is not cleared");
+
+    // C string keys keep their hash, growing does not walk their bytes again
+    int hashes = 0;
+    auto counting = [&hashes](std::string_view key) { hashes++; return hashtables::HashMapHash()(key); };
+    HashMap<const char *, int, decltype(counting), hashtables::HashMapEqual> counted(4, counting);
+    std::string names[100];
+    for (int i = 0; i < 100; i++)
+    {
+        names[i] = "name_" + std::to_string(i);
+        counted.insert(names[i].c_str(), i);
+    }
+    mu_assert(counted.capacity() > 4 && hashes == 100, "C string keys were rehashed on resize");
+
+    return NULL;
+}
+
+/*
+  Move only values go in without a copy and are destroyed exactly once.
+ */
+char *test_hash_map_move_only_values()
+{
+    auto counter = std::make_shared<int>(0);
+    {
+        HashMap<int, std::shared_ptr<int>> map;
+        for (int i = 0; i < 100; i++)
+        {
+            map.insert(i, std::shared_ptr<int>(counter));
+        }
+        mu_assert(counter.use_count() == 101, "Values were copied");
+        map.insert(0, std::make_shared<int>(1));
+        map.remove(1);
+        mu_assert(counter.use_count() == 99, "Overwrite or remove leaked a value");
+
+        HashMap<int, std::shared_ptr<int>> moved(std::move(map));
+        mu_assert(counter.use_count() == 99 && moved.size() == 99 && map.size() == 0, "Move did not take the pairs");
+        map.insert(5, std::shared_ptr<int>(counter));
+        mu_assert(map.find(5) != nullptr && counter.use_count() == 100, "Moved from map is not usable");
+
+        HashMap<int, std::unique_ptr<int>> unique;
+        unique.insert(1, std::make_unique<int>(42));
+        unique.emplace(2, new int(43));
+        mu_assert(**unique.find(1) == 42 && **unique.find(2) == 43, "Move only values are not stored");
+    }
+    mu_assert(counter.use_count() == 1, "Destroy leaked values");
+
+    return NULL;
+}
+
+char *all_tests()
+{
+    mu_suite_start();
+
+    mu_run_test(test_hash_map_integer_keys);
+    mu_run_test(test_hash_map_string_keys);
+    mu_run_test(test_hash_map_move_only_values);
+
+    return NULL;
+}
+
+RUN_TESTS(all_tests);
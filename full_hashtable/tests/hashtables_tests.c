@@ -1,4 +1,6 @@
 #include <hashtables.h>
+#include <frozen_hashtable.h>
+#include <unistd.h>
 #include "../utils/minunit.h"
 
 char *test_hash_table_insertion_and_retrieval()
@@ -138,9 +140,11 @@ char *hash_table_resizing_test()
     hash_table_insert(ht, "resize-key-8", "resize-val-8");
     hash_table_insert(ht, "resize-key-9", "resize-val-9");
 
+    // inserts may already have grown the table past its max load
+    int old_capacity = ht->capacity;
     ht = hash_table_resize(ht);
 
-    mu_assert(ht->capacity == 16, "Resized hash table did not double capacity");
+    mu_assert(ht->capacity == 2 * old_capacity, "Resized hash table did not double capacity");
 
     mu_assert(strcmp(hash_table_retrieve(ht, "resize-key-0"), "resize-val-0") == 0, "Resized hash table did not copy values correctly");
     mu_assert(strcmp(hash_table_retrieve(ht, "resize-key-1"), "resize-val-1") == 0, "Resized hash table did not copy values correctly");
@@ -156,6 +160,698 @@ char *hash_table_resizing_test()
     return NULL;
 }
 
+char *hash_table_incremental_resizing_test()
+{
+    struct HashTable *ht = create_hash_table(8);
+    hash_table_set_incremental_resize(ht, 1);
+    // only the explicit resizes below, no automatic ones
+    hash_table_set_load_factors(ht, 0, 0);
+    char key[32];
+
+    for (int i = 0; i < 200; i++)
+    {
+        sprintf(key, "inc-key-%d", i);
+        hash_table_insert(ht, key, key);
+        // start a new resize every 25 inserts, usually while one is still running
+        if (i % 25 == 24)
+        {
+            ht = hash_table_resize(ht);
+        }
+        // every key inserted so far has to be found, whichever array it is in
+        for (int j = 0; j <= i; j += 7)
+        {
+            sprintf(key, "inc-key-%d", j);
+            mu_assert(hash_table_retrieve(ht, key) != NULL, "Key lost during incremental resize");
+        }
+    }
+    mu_assert(ht->capacity == 2048, "Incremental resizes did not double capacity");
+
+    ht = hash_table_resize(ht);
+    mu_assert(ht->old_storage != NULL, "Incremental resize moved everything at once");
+    for (int i = 0; i < 200; i += 2)
+    {
+        sprintf(key, "inc-key-%d", i);
+        hash_table_remove(ht, key);
+    }
+    for (int i = 0; i < 200; i++)
+    {
+        sprintf(key, "inc-key-%d", i);
+        char *return_value = hash_table_retrieve(ht, key);
+        if (i % 2 == 0)
+        {
+            mu_assert(return_value == NULL, "Deleted value is not NULL");
+        }
+        else
+        {
+            mu_assert(return_value != NULL && strcmp(return_value, key) == 0, "Key lost during incremental resize");
+        }
+    }
+    mu_assert(ht->old_storage == NULL, "Incremental resize never finished");
+
+    destroy_hash_table(ht);
+
+    return NULL;
+}
+
+char *hash_table_load_factor_resizing_test()
+{
+    struct HashTable *ht = create_hash_table(8);
+    char key[32];
+
+    for (int i = 0; i < 100; i++)
+    {
+        sprintf(key, "load-key-%d", i);
+        hash_table_insert(ht, key, key);
+        mu_assert(ht->count <= ht->capacity * 0.7, "Table grew past its max load");
+    }
+    mu_assert(ht->count == 100, "Table does not count its pairs");
+    mu_assert(ht->capacity == 256, "Table did not double on max load");
+
+    // overwriting a key does not add a pair
+    hash_table_insert(ht, "load-key-0", "load-val-0");
+    mu_assert(ht->count == 100, "Overwrite changed the count");
+
+    for (int i = 0; i < 100; i++)
+    {
+        sprintf(key, "load-key-%d", i);
+        hash_table_remove(ht, key);
+        mu_assert(ht->capacity == 8 || ht->count >= ht->capacity * 0.2, "Table did not shrink on min load");
+        // a shrink must never land the table back above max load
+        mu_assert(ht->count <= ht->capacity * 0.7, "Shrink went past max load");
+    }
+    mu_assert(ht->count == 0, "Remove did not update the count");
+    mu_assert(ht->capacity == 8, "Table shrank below its initial capacity");
+
+    // load factors that would grow on every insert or thrash are refused
+    mu_assert(hash_table_set_load_factors(ht, -1, 0) == -1, "Negative max load was accepted");
+    mu_assert(hash_table_set_load_factors(ht, 0.7, 0.35) == -1, "Thrashing load factors were accepted");
+    mu_assert(hash_table_set_load_factors(ht, 0.7, 0.2) == 0, "Valid load factors were refused");
+    mu_assert(hash_table_set_load_factors(ht, 0, 0.2) == 0, "Growing could not be turned off");
+    mu_assert(ht->max_load == 0 && ht->min_load == 0.2, "Load factors were not set");
+
+    destroy_hash_table(ht);
+
+    return NULL;
+}
+
+char *hash_table_arena_test()
+{
+    struct HashTable *ht = create_hash_table(8);
+    hash_table_use_arena(ht);
+    char key[32], val[64];
+
+    for (int i = 0; i < 1000; i++)
+    {
+        sprintf(key, "arena-key-%d", i);
+        hash_table_insert(ht, key, key);
+    }
+    // overwrite with longer values, then churn half the keys out and back in
+    for (int i = 0; i < 1000; i++)
+    {
+        sprintf(key, "arena-key-%d", i);
+        sprintf(val, "arena-longer-value-%d", i);
+        hash_table_insert(ht, key, val);
+    }
+    for (int i = 0; i < 1000; i += 2)
+    {
+        sprintf(key, "arena-key-%d", i);
+        hash_table_remove(ht, key);
+    }
+    for (int i = 0; i < 1000; i += 2)
+    {
+        sprintf(key, "arena-key-%d", i);
+        hash_table_insert(ht, key, "back");
+    }
+    for (int i = 0; i < 1000; i++)
+    {
+        sprintf(key, "arena-key-%d", i);
+        sprintf(val, "arena-longer-value-%d", i);
+        char *return_value = hash_table_retrieve(ht, key);
+        mu_assert(return_value != NULL, "Arena table lost a value");
+        mu_assert(strcmp(return_value, i % 2 == 0 ? "back" : val) == 0, "Arena table stored a wrong value");
+    }
+
+    destroy_hash_table(ht);
+
+    return NULL;
+}
+
+char *hash_table_cached_hash_test()
+{
+    struct HashTable *ht = create_hash_table(4);
+    hash_table_set_load_factors(ht, 0, 0);
+    char key[32];
+
+    for (int i = 0; i < 50; i++)
+    {
+        sprintf(key, "cached-key-%d", i);
+        hash_table_insert(ht, key, key);
+    }
+    ht = hash_table_resize(ht);
+    ht = hash_table_resize(ht);
+
+    // resizes place every pair by its cached hash
+    int pairs = 0;
+    for (int i = 0; i < ht->capacity; i++)
+    {
+        for (LinkedPair *pair = ht->storage[i]; pair != NULL; pair = pair->next)
+        {
+            mu_assert(pair->hash % ht->capacity == (unsigned long)i, "Pair is in the wrong bucket for its cached hash");
+            pairs++;
+        }
+    }
+    mu_assert(pairs == 50, "Resize lost pairs");
+
+    destroy_hash_table(ht);
+
+    return NULL;
+}
+
+char *hash_table_binary_keys_test()
+{
+    struct HashTable *ht = create_hash_table(8);
+    size_t value_len = 0;
+
+    // keys that only differ after an embedded NUL, or only in length
+    hash_table_insert_bytes(ht, "ab\0c", 4, "first", 5);
+    hash_table_insert_bytes(ht, "ab\0d", 4, "second", 6);
+    hash_table_insert_bytes(ht, "ab", 2, "short", 5);
+    hash_table_insert_bytes(ht, "ab\0", 3, "\0\1\2", 3);
+
+    mu_assert(strcmp(hash_table_retrieve_bytes(ht, "ab\0c", 4, NULL), "first") == 0, "Binary key is not stored correctly");
+    mu_assert(strcmp(hash_table_retrieve_bytes(ht, "ab\0d", 4, NULL), "second") == 0, "Binary key is not stored correctly");
+    mu_assert(strcmp(hash_table_retrieve(ht, "ab"), "short") == 0, "String key does not match its binary form");
+    char *value = hash_table_retrieve_bytes(ht, "ab\0", 3, &value_len);
+    mu_assert(value_len == 3 && memcmp(value, "\0\1\2", 3) == 0, "Binary value is not stored correctly");
+    mu_assert(hash_table_retrieve_bytes(ht, "ab\0e", 4, NULL) == NULL, "Missing binary key was found");
+
+    // packed integer ids as keys
+    for (unsigned long id = 0; id < 100; id++)
+    {
+        unsigned long doubled = id * 2;
+        hash_table_insert_bytes(ht, &id, sizeof(id), &doubled, sizeof(doubled));
+    }
+    for (unsigned long id = 0; id < 100; id++)
+    {
+        unsigned long *stored = hash_table_retrieve_bytes(ht, &id, sizeof(id), &value_len);
+        mu_assert(stored != NULL && value_len == sizeof(unsigned long) && *stored == id * 2, "Integer key is not stored correctly");
+    }
+
+    hash_table_remove_bytes(ht, "ab\0c", 4);
+    mu_assert(hash_table_retrieve_bytes(ht, "ab\0c", 4, NULL) == NULL, "Deleted value is not NULL");
+    mu_assert(hash_table_retrieve_bytes(ht, "ab\0d", 4, NULL) != NULL, "Remove took out the wrong key");
+    mu_assert(ht->count == 103, "Binary pairs are not counted");
+
+    destroy_hash_table(ht);
+
+    return NULL;
+}
+
+char *hash_table_seeded_hash_test()
+{
+    struct HashTable *ht = create_hash_table(10);
+    mu_assert(ht->capacity == 16, "Capacity was not rounded up to a power of two");
+    char key[32];
+
+    // switching the hash function re-hashes the pairs already stored
+    for (int i = 0; i < 50; i++)
+    {
+        sprintf(key, "seeded-key-%d", i);
+        hash_table_insert(ht, key, key);
+    }
+    hash_table_set_hash_function(ht, hash_wyhash, hash_random_seed());
+    for (int i = 50; i < 500; i++)
+    {
+        sprintf(key, "seeded-key-%d", i);
+        hash_table_insert(ht, key, key);
+    }
+    for (int i = 0; i < 500; i++)
+    {
+        sprintf(key, "seeded-key-%d", i);
+        char *return_value = hash_table_retrieve(ht, key);
+        mu_assert(return_value != NULL && strcmp(return_value, key) == 0, "Seeded table lost a value");
+    }
+    for (int i = 0; i < ht->capacity; i++)
+    {
+        for (LinkedPair *pair = ht->storage[i]; pair != NULL; pair = pair->next)
+        {
+            mu_assert(pair->hash == hash_wyhash(pair->key, pair->key_len, ht->seed), "Pair kept its old hash");
+        }
+    }
+
+    // the same key hashes differently under different seeds
+    mu_assert(hash_wyhash("key", 3, 1) != hash_wyhash("key", 3, 2), "Seed does not change the hash");
+    mu_assert(hash_djb2("key", 3, 1) == hash_djb2("key", 3, 2), "djb2 should ignore the seed");
+
+    destroy_hash_table(ht);
+
+    return NULL;
+}
+
+char *hash_table_batch_test()
+{
+    struct HashTable *ht = create_hash_table(8);
+    hash_table_set_incremental_resize(ht, 1);
+    char key_buffers[200][32];
+    char *keys[200];
+    char *values[200];
+
+    // more than one batch, growing the table several times on the way
+    for (int i = 0; i < 200; i++)
+    {
+        sprintf(key_buffers[i], "batch-key-%d", i);
+        keys[i] = key_buffers[i];
+        values[i] = key_buffers[i];
+    }
+    hash_table_insert_batch(ht, keys, values, 100);
+    mu_assert(ht->count == 100, "Batch insert did not insert every pair");
+
+    // half of the keys hit, half miss, and the resize is still running
+    char *out_values[200];
+    hash_table_retrieve_batch(ht, keys, 200, out_values);
+    for (int i = 0; i < 200; i++)
+    {
+        char *return_value = hash_table_retrieve(ht, keys[i]);
+        mu_assert(out_values[i] == return_value, "Batch retrieve disagrees with retrieve");
+        mu_assert((i < 100) == (return_value != NULL), "Batch retrieve found the wrong keys");
+    }
+
+    // a batch insert overwrites existing keys
+    values[0] = "new-value";
+    hash_table_insert_batch(ht, keys, values, 1);
+    hash_table_retrieve_batch(ht, keys, 1, out_values);
+    mu_assert(strcmp(out_values[0], "new-value") == 0, "Batch insert did not overwrite");
+    mu_assert(ht->count == 100, "Batch overwrite changed the count");
+
+    destroy_hash_table(ht);
+
+    return NULL;
+}
+
+char *hash_table_build_test()
+{
+    int n = 20000;
+    HashTablePair *pairs = malloc(n * sizeof(HashTablePair));
+    char (*key_buffers)[32] = malloc(n * sizeof(*key_buffers));
+    char (*value_buffers)[32] = malloc(n * sizeof(*value_buffers));
+
+    // the last 1000 pairs repeat earlier keys with new values
+    for (int i = 0; i < n; i++)
+    {
+        sprintf(key_buffers[i], "build-key-%d", i < n - 1000 ? i : i - (n - 1000));
+        sprintf(value_buffers[i], "build-val-%d", i);
+        pairs[i] = (HashTablePair){key_buffers[i], value_buffers[i]};
+    }
+
+    for (int threads = 1; threads <= 8; threads *= 2)
+    {
+        struct HashTable *ht = hash_table_build(pairs, n, threads);
+        mu_assert(ht->count == n - 1000, "Build did not count every distinct key");
+        mu_assert(ht->count <= ht->capacity * ht->max_load, "Build did not pre-size the table");
+        for (int i = 0; i < n - 1000; i++)
+        {
+            char *return_value = hash_table_retrieve(ht, key_buffers[i]);
+            char *expected = i < 1000 ? value_buffers[i + n - 1000] : value_buffers[i];
+            mu_assert(return_value != NULL && strcmp(return_value, expected) == 0, "Build lost a value or kept an earlier duplicate");
+        }
+        // the built table behaves like any other
+        hash_table_insert(ht, "after-build", "value");
+        mu_assert(strcmp(hash_table_retrieve(ht, "after-build"), "value") == 0, "Built table does not take inserts");
+        destroy_hash_table(ht);
+    }
+
+    struct HashTable *ht = hash_table_build(pairs, 0, 0);
+    mu_assert(ht->count == 0, "Empty build is not empty");
+    destroy_hash_table(ht);
+
+    free(pairs);
+    free(key_buffers);
+    free(value_buffers);
+
+    return NULL;
+}
+
+static void hash_table_scan_mark(LinkedPair *pair, void *arg)
+{
+    int *seen = arg;
+    int i;
+    if (sscanf(pair->key, "scan-key-%d", &i) == 1)
+    {
+        seen[i]++;
+    }
+}
+
+char *hash_table_scan_test()
+{
+    for (int incremental = 0; incremental <= 1; incremental++)
+    {
+        struct HashTable *ht = create_hash_table(8);
+        hash_table_set_incremental_resize(ht, incremental);
+        hash_table_set_load_factors(ht, 0.7, 0.3);
+        char key[32];
+        int seen[500] = {0};
+        int max_capacity = 0;
+
+        for (int i = 0; i < 500; i++)
+        {
+            sprintf(key, "scan-key-%d", i);
+            hash_table_insert(ht, key, key);
+        }
+
+        // grow the table a lot between calls, then shrink it back down
+        uint64_t cursor = 0;
+        int calls = 0;
+        do
+        {
+            cursor = hash_table_scan(ht, cursor, 10, hash_table_scan_mark, seen);
+            calls++;
+            max_capacity = ht->capacity > max_capacity ? ht->capacity : max_capacity;
+            for (int j = 0; j < 20; j++)
+            {
+                sprintf(key, "churn-%d-%d", calls, j);
+                if (calls < 30)
+                {
+                    hash_table_insert(ht, key, key);
+                }
+            }
+            for (int j = 0; calls >= 30 && j < 100; j++)
+            {
+                sprintf(key, "churn-%d-%d", calls - 29 + j / 20, j % 20);
+                hash_table_remove(ht, key);
+            }
+        } while (cursor != 0);
+
+        for (int i = 0; i < 500; i++)
+        {
+            mu_assert(seen[i] >= 1, "Scan missed a key that was there the whole time");
+        }
+        mu_assert(calls > 30, "Scan did not work in batches");
+        mu_assert(max_capacity > 1024 && ht->capacity < max_capacity, "Table did not grow and shrink during the scan");
+
+        destroy_hash_table(ht);
+    }
+
+    // an empty table is done in one call
+    struct HashTable *ht = create_hash_table(8);
+    int seen[1] = {0};
+    mu_assert(hash_table_scan(ht, 0, 10, hash_table_scan_mark, seen) == 0, "Empty scan did not finish");
+    destroy_hash_table(ht);
+
+    return NULL;
+}
+
+char *hash_table_stats_test()
+{
+    struct HashTable *ht = create_hash_table(8);
+    HashTableStats stats;
+    char key[32];
+
+    for (int i = 0; i < 100; i++)
+    {
+        sprintf(key, "stats-%d", i);
+        hash_table_insert(ht, key, "value");
+    }
+    hash_table_insert(ht, "stats-0", "new-value");
+    hash_table_remove(ht, "stats-1");
+    hash_table_retrieve(ht, "stats-2");
+    hash_table_retrieve(ht, "missing");
+
+    hash_table_stats(ht, &stats);
+    mu_assert(stats.count == 99 && stats.capacity == ht->capacity, "Stats report the wrong size");
+    mu_assert(stats.load_factor == 99.0 / ht->capacity, "Stats report the wrong load factor");
+    unsigned long buckets = 0, pairs = 0;
+    for (int n = 0; n < HASH_TABLE_STATS_HISTOGRAM; n++)
+    {
+        buckets += stats.chain_histogram[n];
+        pairs += n * stats.chain_histogram[n];
+    }
+    mu_assert(buckets == (unsigned long)ht->capacity && pairs == 99, "Histogram does not cover every bucket and pair");
+    mu_assert(stats.longest_chain >= 1 && stats.chain_histogram[stats.longest_chain] >= 1, "Longest chain is not in the histogram");
+    // short keys and values are inline and count as node bytes, "new-value" no longer fits;
+    // inline keys are padded to 8 bytes so the value behind them is aligned
+    size_t inline_bytes = 0;
+    for (int i = 0; i < 100; i++)
+    {
+        inline_bytes += i == 1 ? 0 : (i < 10 ? 8 : 16) + strlen("value") + 1;
+    }
+    mu_assert(stats.node_bytes == 99 * sizeof(LinkedPair) + inline_bytes, "Node bytes are wrong");
+    mu_assert(stats.key_bytes == 0 && stats.value_bytes == 10, "String bytes are wrong");
+    mu_assert(stats.node_bytes + stats.key_bytes + stats.value_bytes == ht->entry_bytes, "Entry bytes do not match the stats");
+    mu_assert(stats.bucket_bytes == ht->capacity * sizeof(LinkedPair *), "Bucket bytes are wrong");
+#ifndef HASH_TABLE_NO_STATS
+    mu_assert(stats.counters.inserts == 100 && stats.counters.overwrites == 1 && stats.counters.removes == 1, "Write counters are wrong");
+    mu_assert(stats.counters.hits == 1 && stats.counters.misses == 1, "Lookup counters are wrong");
+    mu_assert(stats.counters.resizes == 5, "Resize counter is wrong");
+#endif
+
+    destroy_hash_table(ht);
+
+    return NULL;
+}
+
+char *hash_table_inline_strings_test()
+{
+    for (int arena = 0; arena <= 1; arena++)
+    {
+        struct HashTable *ht = create_hash_table(8);
+        if (arena)
+        {
+            hash_table_use_arena(ht);
+        }
+        char long_key[100], long_value[200];
+        memset(long_key, 'k', sizeof(long_key) - 1);
+        long_key[sizeof(long_key) - 1] = '\0';
+        memset(long_value, 'v', sizeof(long_value) - 1);
+        long_value[sizeof(long_value) - 1] = '\0';
+
+        hash_table_insert(ht, "short", "value");
+        hash_table_insert(ht, long_key, "value");
+        hash_table_insert(ht, "short-long", long_value);
+
+        LinkedPair *pair = ht->storage[hash_djb2("short", 5, 0) & (ht->capacity - 1)];
+        while (strcmp(pair->key, "short") != 0)
+        {
+            pair = pair->next;
+        }
+        mu_assert(pair->key == pair->inline_bytes && pair->flags == (LINKED_PAIR_KEY_INLINE | LINKED_PAIR_VALUE_INLINE), "Short key and value are not inline");
+
+        // overwrites move the value between inline space and the heap
+        hash_table_insert(ht, "short", long_value);
+        mu_assert(!(pair->flags & LINKED_PAIR_VALUE_INLINE) && strcmp(hash_table_retrieve(ht, "short"), long_value) == 0, "Long value did not move to the heap");
+        hash_table_insert(ht, "short", "v2");
+        mu_assert((pair->flags & LINKED_PAIR_VALUE_INLINE) && strcmp(hash_table_retrieve(ht, "short"), "v2") == 0, "Short value did not move back inline");
+        hash_table_insert(ht, "short", "a-longer-value");
+        mu_assert(strcmp(hash_table_retrieve(ht, "short"), "a-longer-value") == 0, "Value outgrowing its inline space was lost");
+
+        mu_assert(strcmp(hash_table_retrieve(ht, long_key), "value") == 0, "Long key lost its value");
+        mu_assert(strcmp(hash_table_retrieve(ht, "short-long"), long_value) == 0, "Long value was lost");
+        hash_table_insert(ht, "short-long", "now-short");
+        mu_assert(strcmp(hash_table_retrieve(ht, "short-long"), "now-short") == 0, "Long value was not replaced");
+
+        hash_table_remove(ht, long_key);
+        hash_table_remove(ht, "short");
+        mu_assert(hash_table_retrieve(ht, long_key) == NULL && hash_table_retrieve(ht, "short") == NULL, "Removed keys are still there");
+
+        destroy_hash_table(ht);
+    }
+
+    return NULL;
+}
+
+static int hash_table_destructor_calls = 0;
+
+static void hash_table_count_destructor(void *bytes, size_t len)
+{
+    (void)len;
+    hash_table_destructor_calls++;
+    free(bytes);
+}
+
+char *hash_table_ownership_test()
+{
+    // borrowed keys and values are the caller's own pointers
+    struct HashTable *ht = create_hash_table(8);
+    hash_table_set_ownership(ht, HASH_TABLE_BORROW, HASH_TABLE_BORROW, NULL);
+    char key[] = "borrowed", value[] = "value";
+    hash_table_insert(ht, key, value);
+    mu_assert(hash_table_retrieve(ht, "borrowed") == value, "Borrowed value was copied");
+    value[0] = 'V';
+    mu_assert(strcmp(hash_table_retrieve(ht, "borrowed"), "Value") == 0, "Borrowed value is not the caller's memory");
+    destroy_hash_table(ht);
+
+    // moved buffers go to the destructor once the table is done with them
+    for (int arena = 0; arena <= 1; arena++)
+    {
+        hash_table_destructor_calls = 0;
+        ht = create_hash_table(8);
+        if (arena)
+        {
+            hash_table_use_arena(ht);
+        }
+        hash_table_set_ownership(ht, HASH_TABLE_MOVE, HASH_TABLE_MOVE, hash_table_count_destructor);
+        hash_table_insert(ht, strdup("a"), strdup("1"));
+        hash_table_insert(ht, strdup("b"), strdup("2"));
+        mu_assert(hash_table_destructor_calls == 0, "Destructor ran on insert");
+        hash_table_insert(ht, strdup("a"), strdup("3"));
+        mu_assert(hash_table_destructor_calls == 2 && strcmp(hash_table_retrieve(ht, "a"), "3") == 0, "Overwrite did not release the old value and the new key");
+        hash_table_remove(ht, "b");
+        mu_assert(hash_table_destructor_calls == 4, "Remove did not release key and value");
+        destroy_hash_table(ht);
+        mu_assert(hash_table_destructor_calls == 6, "Destroy did not release key and value");
+    }
+
+    // copies stay table-owned
+    ht = create_hash_table(8);
+    hash_table_insert(ht, key, value);
+    mu_assert(hash_table_retrieve(ht, "borrowed") != value && strcmp(hash_table_retrieve(ht, "borrowed"), "Value") == 0, "Copied value is not a copy");
+    destroy_hash_table(ht);
+
+    return NULL;
+}
+
+char *hash_table_cache_test()
+{
+    struct HashTable *ht = create_hash_table(8);
+    HashTableStats stats;
+    char key[32], value[100];
+    memset(value, 'v', sizeof(value) - 1);
+    value[sizeof(value) - 1] = '\0';
+    size_t budget = 50 * (sizeof(LinkedPair) + 16 + sizeof(value));
+    hash_table_set_cache(ht, budget);
+
+    for (int i = 0; i < 1000; i++)
+    {
+        // hot keys are hit between inserts and must survive the churn
+        for (int h = 0; h < 5 && i >= 5; h++)
+        {
+            sprintf(key, "cache-%d", h);
+            mu_assert(hash_table_retrieve(ht, key) != NULL, "Hot key was evicted");
+        }
+        sprintf(key, "cache-%d", i);
+        hash_table_insert(ht, key, value);
+        mu_assert(ht->entry_bytes <= budget, "Cache went over its budget");
+    }
+    mu_assert(ht->count < 1000 && ht->count > 25, "Cache did not evict or evicted too much");
+    hash_table_stats(ht, &stats);
+    mu_assert(stats.node_bytes + stats.key_bytes + stats.value_bytes == ht->entry_bytes, "Entry bytes do not match the stats");
+#ifndef HASH_TABLE_NO_STATS
+    mu_assert(stats.counters.evictions == 1000 - (unsigned long)ht->count, "Evictions are not counted");
+#endif
+
+    // a smaller budget evicts right away, 0 turns eviction off
+    hash_table_set_cache(ht, budget / 2);
+    mu_assert(ht->entry_bytes <= budget / 2, "Smaller budget did not evict");
+    hash_table_set_cache(ht, 0);
+    int count = ht->count;
+    hash_table_insert(ht, "no-cache", value);
+    mu_assert(ht->count == count + 1, "Plain table evicted");
+
+    // a pair bigger than the whole budget still goes in, alone
+    char big[4096];
+    memset(big, 'b', sizeof(big) - 1);
+    big[sizeof(big) - 1] = '\0';
+    hash_table_set_cache(ht, 1024);
+    hash_table_insert(ht, "big", big);
+    mu_assert(ht->count == 1 && hash_table_retrieve(ht, "big") != NULL, "Oversized pair was not kept alone");
+
+    destroy_hash_table(ht);
+
+    return NULL;
+}
+
+static uint64_t hash_table_fake_now = 1000;
+
+static void hash_table_scan_count(LinkedPair *pair, void *arg)
+{
+    (void)pair;
+    (*(int *)arg)++;
+}
+
+static uint64_t hash_table_fake_clock(void)
+{
+    return hash_table_fake_now;
+}
+
+char *hash_table_ttl_test()
+{
+    struct HashTable *ht = create_hash_table(8);
+    HashTableStats stats;
+    hash_table_set_clock(ht, hash_table_fake_clock);
+    char key[32];
+    for (int i = 0; i < 1000; i++)
+    {
+        sprintf(key, "ttl-%d", i);
+        hash_table_insert_ttl(ht, key, key, 10 + i);
+    }
+    hash_table_insert(ht, "forever", "value");
+    hash_table_insert_ttl(ht, "overwritten", "value", 5);
+    hash_table_insert(ht, "overwritten", "value");
+    hash_table_insert_ttl(ht, "removed", "value", 5);
+    hash_table_remove(ht, "removed");
+    // a day away, cascades down through three levels
+    hash_table_insert_ttl(ht, "long", "value", 86400000);
+    hash_table_stats(ht, &stats);
+    mu_assert(stats.node_bytes + stats.key_bytes + stats.value_bytes == ht->entry_bytes, "Entry bytes do not match the stats");
+
+    // expired pairs are never returned, even before the wheel gets to them
+    hash_table_fake_now += 510;
+    mu_assert(hash_table_retrieve(ht, "ttl-0") == NULL, "Expired pair was returned");
+    mu_assert(strcmp(hash_table_retrieve(ht, "ttl-501"), "ttl-501") == 0, "Live pair was lost");
+
+    // nor scanned, saved or frozen while they wait for the wheel
+    mu_assert(ht->count > 1003 - 501, "Wheel already reclaimed every expired pair");
+    int scanned = 0;
+    uint64_t cursor = 0;
+    do
+    {
+        cursor = hash_table_scan(ht, cursor, 100, hash_table_scan_count, &scanned);
+    } while (cursor != 0);
+    mu_assert(scanned == 1003 - 501, "Scan visited expired pairs");
+    char path[64];
+    sprintf(path, "/tmp/ttl_tests_%d.snap", (int)getpid());
+    mu_assert(hash_table_save(ht, path) == 0, "Table was not saved");
+    HashTable *loaded = hash_table_load(path);
+    mu_assert(loaded != NULL && loaded->count == 1003 - 501 && hash_table_retrieve(loaded, "ttl-0") == NULL, "Snapshot kept expired pairs");
+    destroy_hash_table(loaded);
+    unlink(path);
+    FrozenHashTable *fht = hash_table_freeze(ht);
+    mu_assert(fht != NULL && fht->count == 1003 - 501 && frozen_hash_table_retrieve(fht, "ttl-0") == NULL, "Frozen table kept expired pairs");
+    destroy_frozen_hash_table(fht);
+
+    // the wheel catches up a bounded batch per operation
+    for (int i = 0; ht->count > 1003 - 501; i++)
+    {
+        mu_assert(i < 10, "Expired pairs were not reclaimed");
+        hash_table_retrieve(ht, "forever");
+    }
+    hash_table_fake_now += 1000000;
+    for (int i = 0; ht->count > 3; i++)
+    {
+        mu_assert(i < 100, "Wheel does not catch up");
+        mu_assert(hash_table_retrieve(ht, "ttl-999") == NULL, "Expired pair was returned");
+    }
+    mu_assert(strcmp(hash_table_retrieve(ht, "forever"), "value") == 0, "Pair without TTL expired");
+    mu_assert(strcmp(hash_table_retrieve(ht, "overwritten"), "value") == 0, "Plain insert did not drop the TTL");
+
+    hash_table_fake_now += 86400000 - 1000000 - 511;
+    mu_assert(strcmp(hash_table_retrieve(ht, "long"), "value") == 0, "Long TTL expired early");
+    hash_table_fake_now += 1;
+    hash_table_retrieve(ht, "forever");
+    mu_assert(ht->count == 2 && hash_table_retrieve(ht, "long") == NULL, "Long TTL did not expire");
+    hash_table_stats(ht, &stats);
+    mu_assert(stats.node_bytes + stats.key_bytes + stats.value_bytes == ht->entry_bytes, "Entry bytes do not match the stats");
+#ifndef HASH_TABLE_NO_STATS
+    mu_assert(stats.counters.expirations == 1001, "Expirations are not counted");
+#endif
+
+    // pairs still waiting on their timers are freed with the table
+    hash_table_insert_ttl(ht, "pending", "value", 1000);
+    hash_table_insert_ttl(ht, "pending", "again", 2000);
+    destroy_hash_table(ht);
+
+    return NULL;
+}
+
 char *all_tests()
 {
     mu_suite_start();
@@ -164,6 +860,20 @@ char *all_tests()
     mu_run_test(test_hash_table_insertion_overwrites_correctly);
     mu_run_test(test_hash_table_removes_correctly);
     mu_run_test(hash_table_resizing_test);
+    mu_run_test(hash_table_incremental_resizing_test);
+    mu_run_test(hash_table_load_factor_resizing_test);
+    mu_run_test(hash_table_arena_test);
+    mu_run_test(hash_table_cached_hash_test);
+    mu_run_test(hash_table_binary_keys_test);
+    mu_run_test(hash_table_seeded_hash_test);
+    mu_run_test(hash_table_batch_test);
+    mu_run_test(hash_table_build_test);
+    mu_run_test(hash_table_scan_test);
+    mu_run_test(hash_table_stats_test);
+    mu_run_test(hash_table_inline_strings_test);
+    mu_run_test(hash_table_ownership_test);
+    mu_run_test(hash_table_cache_test);
+    mu_run_test(hash_table_ttl_test);
 
     return NULL;
 }
@@ -0,0 +1,203 @@
+#include <lockfree_hashtable.h>
+#include <time.h>
+#include <unistd.h>
+#include "../utils/minunit.h"
+
+#define STABLE_KEYS 2000
+#define READ_OPS 200000
+
+typedef struct Reader {
+    LockFreeHashTable *lht;
+    int id;
+    atomic_int *stop;
+    long reads;
+    long errors;
+} Reader;
+
+static double now_seconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+  Reads stable keys until told to stop. Their values are overwritten all
+  the time, but always with one of two values.
+ */
+static void *churn_reader(void *arg)
+{
+    Reader *reader = arg;
+    char key[32], out[32];
+    unsigned int seed = reader->id + 1;
+    while (!atomic_load(reader->stop))
+    {
+        int i = rand_r(&seed) % STABLE_KEYS;
+        sprintf(key, "stable-%d", i);
+        long len = lockfree_hash_table_retrieve(reader->lht, key, out, sizeof(out));
+        if (len < 0 || (strcmp(out, "even") != 0 && strcmp(out, "odd") != 0))
+        {
+            reader->errors++;
+        }
+        reader->reads++;
+    }
+    return NULL;
+}
+
+static void *fixed_reader(void *arg)
+{
+    Reader *reader = arg;
+    char key[32];
+    unsigned int seed = reader->id + 1;
+    // count locally, readers sit next to each other in one array
+    long errors = 0;
+    for (int n = 0; n < READ_OPS; n++)
+    {
+        sprintf(key, "stable-%d", rand_r(&seed) % STABLE_KEYS);
+        epoch_enter();
+        if (lockfree_hash_table_lookup(reader->lht, key) == NULL)
+        {
+            errors++;
+        }
+        epoch_exit();
+    }
+    reader->reads = READ_OPS;
+    reader->errors = errors;
+    return NULL;
+}
+
+char *test_lockfree_basic_operations()
+{
+    LockFreeHashTable *lht = create_lockfree_hash_table(4);
+    char key[32], out[32];
+
+    for (int i = 0; i < 100; i++)
+    {
+        sprintf(key, "key-%d", i);
+        lockfree_hash_table_insert(lht, key, key);
+    }
+    lockfree_hash_table_insert(lht, "key-0", "new-val-0");
+    lockfree_hash_table_remove(lht, "key-1");
+    lockfree_hash_table_resize(lht);
+
+    mu_assert(lockfree_hash_table_retrieve(lht, "key-0", out, sizeof(out)) == 9 && strcmp(out, "new-val-0") == 0, "Value is not overwritten correctly");
+    mu_assert(lockfree_hash_table_retrieve(lht, "key-1", out, sizeof(out)) == -1, "Deleted value is not NULL");
+    mu_assert(lockfree_hash_table_retrieve(lht, "key-99", out, sizeof(out)) == 6, "Value is not stored correctly");
+    mu_assert(lht->count == 99, "Table does not count its pairs");
+
+    destroy_lockfree_hash_table(lht);
+
+    return NULL;
+}
+
+/*
+  Readers run while a writer overwrites, inserts, removes and resizes.
+ */
+char *test_lockfree_readers_during_writes()
+{
+    LockFreeHashTable *lht = create_lockfree_hash_table(8);
+    char key[32];
+    for (int i = 0; i < STABLE_KEYS; i++)
+    {
+        sprintf(key, "stable-%d", i);
+        lockfree_hash_table_insert(lht, key, "even");
+    }
+
+    atomic_int stop;
+    atomic_init(&stop, 0);
+    pthread_t ids[4];
+    Reader readers[4];
+    for (int t = 0; t < 4; t++)
+    {
+        readers[t] = (Reader){lht, t, &stop, 0, 0};
+        pthread_create(&ids[t], NULL, churn_reader, &readers[t]);
+    }
+    for (int round = 0; round < 5; round++)
+    {
+        for (int i = 0; i < STABLE_KEYS; i++)
+        {
+            sprintf(key, "stable-%d", i);
+            lockfree_hash_table_insert(lht, key, round % 2 ? "even" : "odd");
+            sprintf(key, "temp-%d-%d", round, i);
+            lockfree_hash_table_insert(lht, key, key);
+        }
+        for (int i = 0; i < STABLE_KEYS; i++)
+        {
+            sprintf(key, "temp-%d-%d", round, i);
+            lockfree_hash_table_remove(lht, key);
+        }
+        lockfree_hash_table_resize(lht);
+    }
+    atomic_store(&stop, 1);
+    long errors = 0;
+    for (int t = 0; t < 4; t++)
+    {
+        pthread_join(ids[t], NULL);
+        errors += readers[t].errors;
+    }
+    mu_assert(errors == 0, "Reader saw a missing or torn value during writes");
+
+    destroy_lockfree_hash_table(lht);
+
+    return NULL;
+}
+
+/*
+  Not a pass/fail check: prints read throughput from 1 reader up to N so
+  scaling can be compared across machines.
+ */
+char *test_lockfree_read_scaling()
+{
+    LockFreeHashTable *lht = create_lockfree_hash_table(STABLE_KEYS * 2);
+    char key[32];
+    for (int i = 0; i < STABLE_KEYS; i++)
+    {
+        sprintf(key, "stable-%d", i);
+        lockfree_hash_table_insert(lht, key, key);
+    }
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_threads = cores * 2 < 4 ? 4 : (cores * 2 > 64 ? 64 : (int)cores * 2);
+    double single = 0;
+    for (int threads = 1; threads <= max_threads; threads *= 2)
+    {
+        pthread_t ids[64];
+        Reader readers[64];
+        long errors = 0;
+        double start = now_seconds();
+        for (int t = 0; t < threads; t++)
+        {
+            readers[t] = (Reader){lht, t, NULL, 0, 0};
+            pthread_create(&ids[t], NULL, fixed_reader, &readers[t]);
+        }
+        for (int t = 0; t < threads; t++)
+        {
+            pthread_join(ids[t], NULL);
+            errors += readers[t].errors;
+        }
+        double reads_per_sec = threads * (double)READ_OPS / (now_seconds() - start);
+        if (threads == 1)
+        {
+            single = reads_per_sec;
+        }
+        printf("lockfree_hash_table readers=%d reads/sec=%.0f scaling=%.2fx\n", threads, reads_per_sec, reads_per_sec / single);
+        mu_assert(errors == 0, "Preloaded key went missing");
+    }
+
+    destroy_lockfree_hash_table(lht);
+
+    return NULL;
+}
+
+char *all_tests()
+{
+    mu_suite_start();
+
+    mu_run_test(test_lockfree_basic_operations);
+    mu_run_test(test_lockfree_readers_during_writes);
+    mu_run_test(test_lockfree_read_scaling);
+
+    return NULL;
+}
+
+RUN_TESTS(all_tests);
@@ -0,0 +1,158 @@
+#include <robin_hood.h>
+#include "../utils/minunit.h"
+
+char *test_rh_table_insertion_and_retrieval()
+{
+    RHTable *rh = create_rh_table(8);
+
+    mu_assert(rh_table_retrieve(rh, "key-0") == NULL, "Initialized value is not NULL");
+
+    for (int i = 0; i < 10; i++)
+    {
+        char key[16], val[16];
+        sprintf(key, "key-%d", i);
+        sprintf(val, "val-%d", i);
+        rh_table_insert(rh, key, val);
+    }
+
+    for (int i = 0; i < 10; i++)
+    {
+        char key[16], val[16];
+        sprintf(key, "key-%d", i);
+        sprintf(val, "val-%d", i);
+        char *return_value = rh_table_retrieve(rh, key);
+        mu_assert(return_value != NULL && strcmp(return_value, val) == 0, "Value is not stored correctly");
+    }
+    mu_assert(rh->count == 10, "Table does not count its entries");
+    mu_assert(rh->capacity >= 16, "Table did not grow past its max load");
+
+    destroy_rh_table(rh);
+
+    return NULL;
+}
+
+char *test_rh_table_insertion_overwrites_correctly()
+{
+    RHTable *rh = create_rh_table(8);
+
+    rh_table_insert(rh, "key-0", "val-0");
+    rh_table_insert(rh, "key-1", "val-1");
+    rh_table_insert(rh, "key-0", "new-val-0");
+    rh_table_insert(rh, "key-1", "new-val-1");
+
+    mu_assert(strcmp(rh_table_retrieve(rh, "key-0"), "new-val-0") == 0, "Value is not overwritten correctly");
+    mu_assert(strcmp(rh_table_retrieve(rh, "key-1"), "new-val-1") == 0, "Value is not overwritten correctly");
+    mu_assert(rh->count == 2, "Overwrite added a new entry");
+
+    destroy_rh_table(rh);
+
+    return NULL;
+}
+
+char *test_rh_table_removes_correctly()
+{
+    RHTable *rh = create_rh_table(4);
+    char key[16];
+
+    // enough keys to force long probe sequences and several resizes
+    for (int i = 0; i < 1000; i++)
+    {
+        sprintf(key, "key-%d", i);
+        rh_table_insert(rh, key, key);
+    }
+    // remove every other key, backward shifting must keep the rest reachable
+    for (int i = 0; i < 1000; i += 2)
+    {
+        sprintf(key, "key-%d", i);
+        rh_table_remove(rh, key);
+    }
+    for (int i = 0; i < 1000; i++)
+    {
+        sprintf(key, "key-%d", i);
+        char *return_value = rh_table_retrieve(rh, key);
+        if (i % 2 == 0)
+        {
+            mu_assert(return_value == NULL, "Deleted value is not NULL");
+        }
+        else
+        {
+            mu_assert(return_value != NULL && strcmp(return_value, key) == 0, "Remaining value was lost by a remove");
+        }
+    }
+    mu_assert(rh->count == 500, "Remove did not update the count");
+
+    // removing a missing key is a no-op
+    rh_table_remove(rh, "not-a-key");
+    mu_assert(rh->count == 500, "Removing a missing key changed the count");
+
+    destroy_rh_table(rh);
+
+    return NULL;
+}
+
+char *rh_table_resizing_test()
+{
+    RHTable *rh = create_rh_table(16);
+
+    rh_table_insert(rh, "resize-key-0", "resize-val-0");
+    rh_table_insert(rh, "resize-key-1", "resize-val-1");
+    rh_table_insert(rh, "resize-key-2", "resize-val-2");
+
+    rh = rh_table_resize(rh);
+
+    mu_assert(rh->capacity == 32, "Resized table did not double capacity");
+    mu_assert(strcmp(rh_table_retrieve(rh, "resize-key-0"), "resize-val-0") == 0, "Resized table did not copy values correctly");
+    mu_assert(strcmp(rh_table_retrieve(rh, "resize-key-1"), "resize-val-1") == 0, "Resized table did not copy values correctly");
+    mu_assert(strcmp(rh_table_retrieve(rh, "resize-key-2"), "resize-val-2") == 0, "Resized table did not copy values correctly");
+
+    destroy_rh_table(rh);
+
+    return NULL;
+}
+
+/*
+  Sequential keys near the max load still probe only a few slots: the
+  seeded hash keeps them from clustering.
+ */
+char *rh_table_probe_length_test()
+{
+    RHTable *rh = create_rh_table(8);
+    char key[32];
+    for (int i = 0; i < 114000; i++)
+    {
+        sprintf(key, "key-%d", i);
+        rh_table_insert(rh, key, key);
+    }
+    mu_assert(rh->capacity == 131072, "Table is not near its max load");
+    double total = 0;
+    unsigned int longest = 0;
+    for (int i = 0; i < rh->capacity; i++)
+    {
+        if (rh->slots[i].dist != 0)
+        {
+            total += rh->slots[i].dist - 1;
+            longest = rh->slots[i].dist - 1 > longest ? rh->slots[i].dist - 1 : longest;
+        }
+    }
+    mu_assert(total / rh->count < 5, "Mean probe distance is too long");
+    mu_assert(longest < 64, "Longest probe distance is too long");
+
+    destroy_rh_table(rh);
+
+    return NULL;
+}
+
+char *all_tests()
+{
+    mu_suite_start();
+
+    mu_run_test(test_rh_table_insertion_and_retrieval);
+    mu_run_test(test_rh_table_insertion_overwrites_correctly);
+    mu_run_test(test_rh_table_removes_correctly);
+    mu_run_test(rh_table_resizing_test);
+    mu_run_test(rh_table_probe_length_test);
+
+    return NULL;
+}
+
+RUN_TESTS(all_tests);
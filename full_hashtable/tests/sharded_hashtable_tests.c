@@ -0,0 +1,142 @@
+#include <sharded_hashtable.h>
+#include "../utils/minunit.h"
+
+#define WRITER_KEYS 2000
+
+typedef struct Worker {
+    ShardedHashTable *sht;
+    int id;
+    long misses;
+} Worker;
+
+/*
+  Each writer inserts its own keys, removes every other one and reads
+  the rest back, while shards grow under it.
+ */
+static void *writer(void *arg)
+{
+    Worker *worker = arg;
+    char key[32], out[32];
+    for (int i = 0; i < WRITER_KEYS; i++)
+    {
+        sprintf(key, "w%d-key-%d", worker->id, i);
+        sharded_hash_table_insert(worker->sht, key, key);
+    }
+    for (int i = 0; i < WRITER_KEYS; i += 2)
+    {
+        sprintf(key, "w%d-key-%d", worker->id, i);
+        sharded_hash_table_remove(worker->sht, key);
+    }
+    for (int i = 0; i < WRITER_KEYS; i++)
+    {
+        sprintf(key, "w%d-key-%d", worker->id, i);
+        long len = sharded_hash_table_retrieve(worker->sht, key, out, sizeof(out));
+        if ((i % 2 == 0) != (len < 0) || (len >= 0 && strcmp(out, key) != 0))
+        {
+            worker->misses++;
+        }
+    }
+    return NULL;
+}
+
+char *test_sharded_basic_operations()
+{
+    ShardedHashTable *sht = create_sharded_hash_table(6, 4);
+    char key[32], out[32];
+
+    mu_assert(sht->shard_count == 8, "Shard count is not rounded to a power of two");
+    for (int i = 0; i < 1000; i++)
+    {
+        sprintf(key, "key-%d", i);
+        sharded_hash_table_insert(sht, key, key);
+    }
+    sharded_hash_table_insert(sht, "key-0", "new-val-0");
+    sharded_hash_table_remove(sht, "key-1");
+
+    mu_assert(sharded_hash_table_retrieve(sht, "key-0", out, sizeof(out)) == 9 && strcmp(out, "new-val-0") == 0, "Value is not overwritten correctly");
+    mu_assert(sharded_hash_table_retrieve(sht, "key-1", out, sizeof(out)) == -1, "Deleted value is not NULL");
+    mu_assert(sharded_hash_table_retrieve(sht, "key-999", out, sizeof(out)) == 7, "Value is not stored correctly");
+    mu_assert(sharded_hash_table_count(sht) == 999, "Shards do not count their pairs");
+    for (int i = 0; i < sht->shard_count; i++)
+    {
+        mu_assert(sht->shards[i].table->count > 0, "A shard got no keys");
+    }
+
+    destroy_sharded_hash_table(sht);
+
+    return NULL;
+}
+
+char *test_sharded_independent_resize()
+{
+    ShardedHashTable *sht = create_sharded_hash_table(4, 16);
+    char key[32];
+
+    sharded_hash_table_resize_shard(sht, 2);
+    mu_assert(sht->shards[2].table->capacity == 32, "Shard did not resize");
+    mu_assert(sht->shards[0].table->capacity == 16 && sht->shards[1].table->capacity == 16 && sht->shards[3].table->capacity == 16, "Resizing one shard touched another");
+
+    // fill until some shard grows on its own, the others only grow if they filled up too
+    for (int i = 0; i < 80; i++)
+    {
+        sprintf(key, "key-%d", i);
+        sharded_hash_table_insert(sht, key, key);
+    }
+    for (int i = 0; i < sht->shard_count; i++)
+    {
+        HashTable *ht = sht->shards[i].table;
+        mu_assert(ht->count <= ht->capacity * ht->max_load, "Shard did not grow past its max load");
+        mu_assert(i == 2 || ht->capacity == 16 || ht->count > 16 * ht->max_load, "Shard grew without passing its max load");
+    }
+
+    // and shrinks on its own once emptied
+    for (int i = 0; i < 80; i++)
+    {
+        sprintf(key, "key-%d", i);
+        sharded_hash_table_remove(sht, key);
+    }
+    mu_assert(sht->shards[2].table->capacity == 16, "Shard did not shrink back");
+    mu_assert(sharded_hash_table_count(sht) == 0, "Shards are not empty");
+
+    destroy_sharded_hash_table(sht);
+
+    return NULL;
+}
+
+char *test_sharded_concurrent_writers()
+{
+    ShardedHashTable *sht = create_sharded_hash_table(16, 8);
+    pthread_t ids[8];
+    Worker workers[8];
+    long misses = 0;
+
+    for (int t = 0; t < 8; t++)
+    {
+        workers[t] = (Worker){sht, t, 0};
+        pthread_create(&ids[t], NULL, writer, &workers[t]);
+    }
+    for (int t = 0; t < 8; t++)
+    {
+        pthread_join(ids[t], NULL);
+        misses += workers[t].misses;
+    }
+    mu_assert(misses == 0, "Concurrent writers lost or corrupted keys");
+    mu_assert(sharded_hash_table_count(sht) == 8 * WRITER_KEYS / 2, "Concurrent count is wrong");
+
+    destroy_sharded_hash_table(sht);
+
+    return NULL;
+}
+
+char *all_tests()
+{
+    mu_suite_start();
+
+    mu_run_test(test_sharded_basic_operations);
+    mu_run_test(test_sharded_independent_resize);
+    mu_run_test(test_sharded_concurrent_writers);
+
+    return NULL;
+}
+
+RUN_TESTS(all_tests);
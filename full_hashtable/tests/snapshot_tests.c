@@ -0,0 +1,110 @@
+#include <snapshot.h>
+#include <unistd.h>
+#include "../utils/minunit.h"
+
+static char snapshot_path[64];
+
+char *test_snapshot_save_and_map()
+{
+    struct HashTable *ht = create_hash_table(8);
+    hash_table_set_incremental_resize(ht, 1);
+    char key[32], value[32];
+
+    for (int i = 0; i < 1000; i++)
+    {
+        sprintf(key, "snap-key-%d", i);
+        sprintf(value, "snap-val-%d", i);
+        hash_table_insert(ht, key, value);
+    }
+    // binary keys and values with NUL bytes inside
+    hash_table_insert_bytes(ht, "bin\0key", 7, "bin\0value", 9);
+    mu_assert(hash_table_save(ht, snapshot_path) == 0, "Snapshot was not saved");
+    destroy_hash_table(ht);
+
+    MappedHashTable *mht = hash_table_open_mapped(snapshot_path);
+    mu_assert(mht != NULL, "Snapshot was not mapped");
+    mu_assert(mht->count == 1001, "Snapshot lost pairs");
+    for (int i = 0; i < 1000; i++)
+    {
+        sprintf(key, "snap-key-%d", i);
+        sprintf(value, "snap-val-%d", i);
+        char *return_value = mapped_hash_table_retrieve(mht, key);
+        mu_assert(return_value != NULL && strcmp(return_value, value) == 0, "Mapped snapshot lost a value");
+    }
+    size_t value_len = 0;
+    char *return_value = mapped_hash_table_retrieve_bytes(mht, "bin\0key", 7, &value_len);
+    mu_assert(return_value != NULL && value_len == 9 && memcmp(return_value, "bin\0value", 9) == 0, "Mapped snapshot lost a binary value");
+    mu_assert(mapped_hash_table_retrieve(mht, "bin") == NULL, "Binary key matched its prefix");
+    mu_assert(mapped_hash_table_retrieve(mht, "missing") == NULL, "Missing key was found");
+
+    // values point into the mapping, nothing was copied
+    mu_assert(return_value > (char *)mht->base && return_value < (char *)mht->base + mht->size, "Value does not point into the mapping");
+
+    destroy_mapped_hash_table(mht);
+
+    return NULL;
+}
+
+char *test_snapshot_empty_and_invalid()
+{
+    struct HashTable *ht = create_hash_table(8);
+    mu_assert(hash_table_save(ht, snapshot_path) == 0, "Empty snapshot was not saved");
+    destroy_hash_table(ht);
+
+    MappedHashTable *mht = hash_table_open_mapped(snapshot_path);
+    mu_assert(mht != NULL && mht->count == 0, "Empty snapshot was not mapped");
+    mu_assert(mapped_hash_table_retrieve(mht, "key") == NULL, "Empty snapshot found a key");
+    destroy_mapped_hash_table(mht);
+
+    // a truncated file is rejected
+    mu_assert(truncate(snapshot_path, sizeof(SnapshotHeader) + 4) == 0, "Could not truncate the snapshot");
+    mu_assert(hash_table_open_mapped(snapshot_path) == NULL, "Truncated snapshot was mapped");
+
+    // and so is anything that is not a snapshot
+    FILE *file = fopen(snapshot_path, "w");
+    fprintf(file, "not a snapshot, just some text that is long enough to hold a header");
+    fclose(file);
+    mu_assert(hash_table_open_mapped(snapshot_path) == NULL, "Text file was mapped");
+    mu_assert(hash_table_open_mapped("/nonexistent/snapshot") == NULL, "Missing file was mapped");
+
+    unlink(snapshot_path);
+
+    return NULL;
+}
+
+/*
+  Borrowed bytes need not be NUL terminated, the snapshot has to write
+  its own terminators instead of the byte after them.
+ */
+char *test_snapshot_borrowed_bytes()
+{
+    struct HashTable *ht = create_hash_table(8);
+    hash_table_set_ownership(ht, HASH_TABLE_BORROW, HASH_TABLE_BORROW, NULL);
+    char buffer[] = "keyXvalueY";
+    hash_table_insert_bytes(ht, buffer, 3, buffer + 4, 5);
+    mu_assert(hash_table_save(ht, snapshot_path) == 0, "Snapshot was not saved");
+    destroy_hash_table(ht);
+
+    MappedHashTable *mht = hash_table_open_mapped(snapshot_path);
+    char *return_value = mapped_hash_table_retrieve(mht, "key");
+    mu_assert(return_value != NULL && strcmp(return_value, "value") == 0, "Borrowed value was not terminated");
+    destroy_mapped_hash_table(mht);
+
+    unlink(snapshot_path);
+
+    return NULL;
+}
+
+char *all_tests()
+{
+    mu_suite_start();
+
+    sprintf(snapshot_path, "/tmp/snapshot_tests_%d.snap", (int)getpid());
+    mu_run_test(test_snapshot_save_and_map);
+    mu_run_test(test_snapshot_empty_and_invalid);
+    mu_run_test(test_snapshot_borrowed_bytes);
+
+    return NULL;
+}
+
+RUN_TESTS(all_tests);
@@ -0,0 +1,7 @@
+/*
+  The Swiss table tests again, against the portable group matching that
+  SSE2 builds never compile.
+ */
+#define SWISS_NO_SIMD
+#include "../swiss_table.c"
+#include "swiss_table_tests.c"
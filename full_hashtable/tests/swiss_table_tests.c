@@ -0,0 +1,200 @@
+#include <swiss_table.h>
+#include "../utils/minunit.h"
+
+char *test_swiss_table_insertion_and_retrieval()
+{
+    SwissTable *st = create_swiss_table(8);
+
+    mu_assert(swiss_table_retrieve(st, "key-0") == NULL, "Initialized value is not NULL");
+
+    for (int i = 0; i < 10; i++)
+    {
+        char key[16], val[16];
+        sprintf(key, "key-%d", i);
+        sprintf(val, "val-%d", i);
+        swiss_table_insert(st, key, val);
+    }
+
+    for (int i = 0; i < 10; i++)
+    {
+        char key[16], val[16];
+        sprintf(key, "key-%d", i);
+        sprintf(val, "val-%d", i);
+        char *return_value = swiss_table_retrieve(st, key);
+        mu_assert(return_value != NULL && strcmp(return_value, val) == 0, "Value is not stored correctly");
+    }
+    mu_assert(st->count == 10, "Table does not count its entries");
+    mu_assert(st->capacity >= 16, "Table did not grow past its max load");
+
+    destroy_swiss_table(st);
+
+    return NULL;
+}
+
+char *test_swiss_table_insertion_overwrites_correctly()
+{
+    SwissTable *st = create_swiss_table(8);
+
+    swiss_table_insert(st, "key-0", "val-0");
+    swiss_table_insert(st, "key-1", "val-1");
+    swiss_table_insert(st, "key-0", "new-val-0");
+    swiss_table_insert(st, "key-1", "new-val-1");
+
+    mu_assert(strcmp(swiss_table_retrieve(st, "key-0"), "new-val-0") == 0, "Value is not overwritten correctly");
+    mu_assert(strcmp(swiss_table_retrieve(st, "key-1"), "new-val-1") == 0, "Value is not overwritten correctly");
+    mu_assert(st->count == 2, "Overwrite added a new entry");
+
+    destroy_swiss_table(st);
+
+    return NULL;
+}
+
+char *test_swiss_table_removes_correctly()
+{
+    SwissTable *st = create_swiss_table(4);
+    char key[16];
+
+    // enough keys to force long probe sequences and several resizes
+    for (int i = 0; i < 1000; i++)
+    {
+        sprintf(key, "key-%d", i);
+        swiss_table_insert(st, key, key);
+    }
+    // remove every other key, the tombstones left behind must not hide the rest
+    for (int i = 0; i < 1000; i += 2)
+    {
+        sprintf(key, "key-%d", i);
+        swiss_table_remove(st, key);
+    }
+    for (int i = 0; i < 1000; i++)
+    {
+        sprintf(key, "key-%d", i);
+        char *return_value = swiss_table_retrieve(st, key);
+        if (i % 2 == 0)
+        {
+            mu_assert(return_value == NULL, "Deleted value is not NULL");
+        }
+        else
+        {
+            mu_assert(return_value != NULL && strcmp(return_value, key) == 0, "Remaining value was lost by a remove");
+        }
+    }
+    mu_assert(st->count == 500, "Remove did not update the count");
+
+    // removing a missing key is a no-op
+    swiss_table_remove(st, "not-a-key");
+    mu_assert(st->count == 500, "Removing a missing key changed the count");
+
+    destroy_swiss_table(st);
+
+    return NULL;
+}
+
+char *test_swiss_table_churn_reuses_tombstones()
+{
+    SwissTable *st = create_swiss_table(16);
+    char key[32];
+
+    // keep the live set small but cycle many distinct keys through it
+    for (int i = 0; i < 5000; i++)
+    {
+        sprintf(key, "churn-%d", i);
+        swiss_table_insert(st, key, key);
+        if (i >= 8)
+        {
+            sprintf(key, "churn-%d", i - 8);
+            swiss_table_remove(st, key);
+        }
+    }
+    mu_assert(st->count == 8, "Churn did not keep the live set size");
+    mu_assert(st->capacity <= 64, "Tombstones made the table grow without bound");
+    for (int i = 4992; i < 5000; i++)
+    {
+        sprintf(key, "churn-%d", i);
+        char *return_value = swiss_table_retrieve(st, key);
+        mu_assert(return_value != NULL && strcmp(return_value, key) == 0, "Live key lost during churn");
+    }
+    mu_assert(swiss_table_retrieve(st, "churn-0") == NULL, "Removed key is still found");
+
+    destroy_swiss_table(st);
+
+    return NULL;
+}
+
+char *swiss_table_resizing_test()
+{
+    SwissTable *st = create_swiss_table(16);
+
+    swiss_table_insert(st, "resize-key-0", "resize-val-0");
+    swiss_table_insert(st, "resize-key-1", "resize-val-1");
+    swiss_table_insert(st, "resize-key-2", "resize-val-2");
+
+    st = swiss_table_resize(st);
+
+    mu_assert(st->capacity == 32, "Resized table did not double capacity");
+    mu_assert(strcmp(swiss_table_retrieve(st, "resize-key-0"), "resize-val-0") == 0, "Resized table did not copy values correctly");
+    mu_assert(strcmp(swiss_table_retrieve(st, "resize-key-1"), "resize-val-1") == 0, "Resized table did not copy values correctly");
+    mu_assert(strcmp(swiss_table_retrieve(st, "resize-key-2"), "resize-val-2") == 0, "Resized table did not copy values correctly");
+
+    destroy_swiss_table(st);
+
+    return NULL;
+}
+
+/*
+  Sequential keys near the max load still find their key in the first
+  group or two: the seeded hash keeps their probes from clustering.
+ */
+char *swiss_table_probe_length_test()
+{
+    SwissTable *st = create_swiss_table(8);
+    char key[32];
+    for (int i = 0; i < 114000; i++)
+    {
+        sprintf(key, "key-%d", i);
+        swiss_table_insert(st, key, key);
+    }
+    mu_assert(st->capacity == 131072, "Table is not near its max load");
+    unsigned long group_mask = st->capacity / SWISS_GROUP_WIDTH - 1;
+    double total = 0;
+    int longest = 0;
+    for (int i = 0; i < st->capacity; i++)
+    {
+        if (st->ctrl[i] < 0)
+        {
+            continue;
+        }
+        // walk the triangular probe sequence from the home group to the slot's group
+        unsigned long group = (st->slots[i].hash >> 7) & group_mask;
+        int groups = 1;
+        for (unsigned long step = 1; group != (unsigned long)i / SWISS_GROUP_WIDTH; step++)
+        {
+            group = (group + step) & group_mask;
+            groups++;
+        }
+        total += groups;
+        longest = groups > longest ? groups : longest;
+    }
+    mu_assert(total / st->count < 1.5, "Hits probe too many groups on average");
+    mu_assert(longest < 32, "Longest probe visits too many groups");
+
+    destroy_swiss_table(st);
+
+    return NULL;
+}
+
+char *all_tests()
+{
+    mu_suite_start();
+
+    mu_run_test(test_swiss_table_insertion_and_retrieval);
+    mu_run_test(test_swiss_table_insertion_overwrites_correctly);
+    mu_run_test(test_swiss_table_removes_correctly);
+    mu_run_test(test_swiss_table_churn_reuses_tombstones);
+    mu_run_test(swiss_table_resizing_test);
+    mu_run_test(swiss_table_probe_length_test);
+
+    return NULL;
+}
+
+RUN_TESTS(all_tests);
@@ -1,17 +1,17 @@
 SRC=$(wildcard *.c)
-EXE=$(subst .c,,$(SRC))
+EXE?=$(subst .c,,$(SRC))
 
 $(EXE): $(SRC)
-	gcc -Wall -Wextra -g -o $@ $^
+	gcc -Wall -Wextra -g -o $@ $^ -lpthread
 
 test: tests
 
-.PHONY: clean test tests
+.PHONY: clean test tests bench
 
 # Sean's testing stuff below:
 
 CFLAGS=-g -O2 -Wall -Wextra -I. -DTESTING -DNDEBUG $(OPTFLAGS)
-LIBS=-ldl $(OPTLIBS)
+LIBS=-ldl -lpthread $(OPTLIBS)
 PREFIX?=/usr/local
 
 SOURCES=$(wildcard *.c)
@@ -20,6 +20,18 @@ OBJECTS=$(patsubst %.c,%.o,$(SOURCES))
 TEST_SRC=$(wildcard tests/*_tests.c)
 TESTS=$(patsubst %.c,%,$(TEST_SRC))
 
+# C++ tests for the header only templates, minunit hands back string literals as char *
+CXXFLAGS=-g -O2 -std=c++17 -Wall -Wextra -Wno-write-strings -I. -DTESTING -DNDEBUG $(OPTFLAGS)
+CXX_TEST_SRC=$(wildcard tests/*_tests.cpp)
+CXX_TESTS=$(patsubst %.cpp,%,$(CXX_TEST_SRC))
+
+BENCH_SRC=$(wildcard bench/*_bench.c)
+BENCHES=$(patsubst %.c,%,$(BENCH_SRC))
+CXX_BENCH_SRC=$(wildcard bench/*_bench.cpp)
+CXX_BENCHES=$(patsubst %.cpp,%,$(CXX_BENCH_SRC))
+BENCH_WORKLOADS?=hit miss churn growth
+BENCH_ARGS?=
+
 TARGET=build/liblcthw.a
 SO_TARGET=$(patsubst %.a,%.so,$(TARGET))
 
@@ -43,15 +55,33 @@ build:
 # The Unit Tests
 .PHONY: tests
 #tests2: CFLAGS += $(TARGET)
-tests2: $(TESTS)
+tests2: $(TESTS) $(CXX_TESTS)
 	sh ./tests/runtests.sh
 
-$(TESTS): $(TEST_SRC)
-	$(CC) $(CFLAGS) $^ $(TARGET) -o $@
+$(TESTS): %: %.c
+	$(CC) $(CFLAGS) $< $(TARGET) $(LIBS) -o $@
+
+$(CXX_TESTS): %: %.cpp
+	$(CXX) $(CXXFLAGS) $< $(LIBS) -o $@
+
+# The Benchmarks, one JSON line per engine and workload
+# e.g. make bench BENCH_WORKLOADS=hit BENCH_ARGS="--dist zipf --keys 1000000"
+bench: clean $(TARGET) $(BENCHES) $(CXX_BENCHES)
+	@for b in $(BENCHES) $(CXX_BENCHES); do \
+		for w in $(BENCH_WORKLOADS); do \
+			./$$b --workload $$w --json $(BENCH_ARGS) || exit 1; \
+		done; \
+	done
+
+$(BENCHES): %: %.c
+	$(CC) $(CFLAGS) $< $(TARGET) $(LIBS) -lm -o $@
+
+$(CXX_BENCHES): %: %.cpp
+	$(CXX) $(CXXFLAGS) $< $(LIBS) -lm -o $@
 
 # The Cleaner
 clean:
-	rm -rf build $(OBJECTS) $(TESTS)
+	rm -rf build $(OBJECTS) $(TESTS) $(CXX_TESTS) $(BENCHES) $(CXX_BENCHES)
 	rm -f tests/tests.log
 	find . -name "*.gc" -exec rm -f {} \;
 	rm -rf `find . -name "*.dSYM" -print`
@@ -0,0 +1,454 @@
+#ifndef __bench_h__
+#define __bench_h__
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+  Shared benchmark driver. Each bench/<name>_bench.c wraps one engine in
+  a BenchEngine and hands it to bench_main, which runs one workload per
+  process so the reported peak RSS belongs to that workload alone.
+
+  Workloads:
+
+    hit     preload --keys keys, then lookups that find a key with
+            probability --hit-ratio (0.95 unless given)
+    miss    the same with a --hit-ratio of 0.05 unless given
+    churn   preload --keys keys, then alternately insert a new key and
+            remove the oldest one, so the size stays the same
+    growth  insert --ops new keys into a table created almost empty
+
+  Lookup keys are drawn uniformly or from a Zipf distribution (--dist,
+  --theta). Throughput is measured over the whole run, latency by timing
+  every --sample'th operation on its own.
+
+  Anything the engine prints is discarded, so --json output stays one
+  parseable JSON object per run.
+
+  The header compiles as C and as C++, so bench/<name>_bench.cpp drivers
+  for the C++ templates share it.
+ */
+
+typedef struct BenchEngine {
+  const char *name;
+  // 0 for engines that never resize, growth then starts them at full size
+  int grows;
+  void *(*create)(int capacity);
+  void (*insert)(void *table, char *key, char *value);
+  char *(*retrieve)(void *table, char *key);
+  // NULL for engines built once and then only read, they skip churn and growth
+  void (*remove)(void *table, char *key);
+  void (*destroy)(void *table);
+  // called once the preload is in, before lookups are timed, NULL for none
+  void (*seal)(void *table);
+} BenchEngine;
+
+typedef struct BenchOptions {
+  const char *workload;
+  const char *dist;
+  double theta;
+  long keys;
+  long ops;
+  double hit_ratio;
+  long sample;
+  uint64_t seed;
+  int json;
+} BenchOptions;
+
+static uint64_t bench_now_ns(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// xorshift64*, fast enough to stay out of the way of the engine
+static uint64_t bench_random(uint64_t *state)
+{
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 2685821657736338717ULL;
+}
+
+static double bench_random_double(uint64_t *state)
+{
+  return (bench_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+  Zipf distributed ranks in [0, n) after Gray et al., "Quickly
+  Generating Billion-Record Synthetic Databases". Rank 0 is the most
+  popular. theta must not be 1.
+ */
+typedef struct BenchZipf {
+  long n;
+  double theta;
+  double alpha;
+  double zetan;
+  double eta;
+} BenchZipf;
+
+static void bench_zipf_init(BenchZipf *zipf, long n, double theta)
+{
+  double zeta2 = 1.0 + pow(0.5, theta);
+  zipf->n = n;
+  zipf->theta = theta;
+  zipf->alpha = 1.0 / (1.0 - theta);
+  zipf->zetan = 0;
+  for (long i = 1; i <= n; i++)
+  {
+    zipf->zetan += 1.0 / pow((double)i, theta);
+  }
+  zipf->eta = (1.0 - pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zipf->zetan);
+}
+
+static long bench_zipf_next(BenchZipf *zipf, uint64_t *state)
+{
+  double u = bench_random_double(state);
+  double uz = u * zipf->zetan;
+  if (uz < 1.0)
+  {
+    return 0;
+  }
+  if (uz < 1.0 + pow(0.5, zipf->theta))
+  {
+    return 1;
+  }
+  long rank = (long)(zipf->n * pow(zipf->eta * u - zipf->eta + 1.0, zipf->alpha));
+  return rank < zipf->n ? rank : zipf->n - 1;
+}
+
+static long bench_pick(BenchOptions *options, BenchZipf *zipf, uint64_t *state, long n)
+{
+  if (strcmp(options->dist, "zipf") == 0)
+  {
+    // scatter the ranks over the keys: left in order, the hottest keys
+    // would be the first inserted, with neighbouring names, which some
+    // engines keep at the front of their chains. Multiplying by a prime
+    // larger than n is a fixed permutation of [0, n).
+    return (long)((uint64_t)bench_zipf_next(zipf, state) * 2654435761ULL % (uint64_t)n);
+  }
+  return (long)(bench_random(state) % (uint64_t)n);
+}
+
+static int bench_compare_u64(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+static uint64_t bench_percentile(uint64_t *sorted, long n, double p)
+{
+  if (n == 0)
+  {
+    return 0;
+  }
+  long i = (long)(p * (n - 1) + 0.5);
+  return sorted[i];
+}
+
+static long bench_peak_rss_kb(void)
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  // kilobytes on Linux
+  return usage.ru_maxrss;
+}
+
+/*
+  n key strings "<prefix>-<i>", in one block so generating them does not
+  show up in the timed part.
+ */
+static char **bench_make_keys(const char *prefix, long n)
+{
+  char **keys = (char **)malloc((n > 0 ? n : 1) * sizeof(char *));
+  char *block = (char *)malloc((n > 0 ? n : 1) * 24);
+  for (long i = 0; i < n; i++)
+  {
+    keys[i] = block + i * 24;
+    snprintf(keys[i], 24, "%s-%ld", prefix, i);
+  }
+  return keys;
+}
+
+static void bench_free_keys(char **keys)
+{
+  free(keys[0]);
+  free(keys);
+}
+
+static void bench_usage(const char *program)
+{
+  fprintf(stderr,
+          "usage: %s [--workload hit|miss|churn|growth] [--dist uniform|zipf] [--theta F]\n"
+          "          [--keys N] [--ops N] [--hit-ratio F] [--sample N] [--seed N] [--json]\n",
+          program);
+}
+
+static int bench_parse(int argc, char **argv, BenchOptions *options)
+{
+  *options = (BenchOptions){"hit", "uniform", 0.99, 100000, 1000000, -1, 8, 42, 0};
+  for (int i = 1; i < argc; i++)
+  {
+    int has_value = i + 1 < argc;
+    if (strcmp(argv[i], "--json") == 0)
+    {
+      options->json = 1;
+    }
+    else if (strcmp(argv[i], "--workload") == 0 && has_value)
+    {
+      options->workload = argv[++i];
+    }
+    else if (strcmp(argv[i], "--dist") == 0 && has_value)
+    {
+      options->dist = argv[++i];
+    }
+    else if (strcmp(argv[i], "--theta") == 0 && has_value)
+    {
+      options->theta = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--keys") == 0 && has_value)
+    {
+      options->keys = atol(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--ops") == 0 && has_value)
+    {
+      options->ops = atol(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--hit-ratio") == 0 && has_value)
+    {
+      options->hit_ratio = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--sample") == 0 && has_value)
+    {
+      options->sample = atol(argv[++i]);
+    }
+    else if (strcmp(argv[i], "--seed") == 0 && has_value)
+    {
+      options->seed = strtoull(argv[++i], NULL, 10);
+    }
+    else
+    {
+      return -1;
+    }
+  }
+  if (options->hit_ratio < 0)
+  {
+    options->hit_ratio = strcmp(options->workload, "miss") == 0 ? 0.05 : 0.95;
+  }
+  if (options->keys < 1 || options->keys >= 2654435761L || options->ops < 1 || options->sample < 1 || options->theta == 1.0 ||
+      (strcmp(options->dist, "uniform") != 0 && strcmp(options->dist, "zipf") != 0))
+  {
+    return -1;
+  }
+  return 0;
+}
+
+/*
+  Run the lookups of the hit and miss workloads. The keys to look up are
+  drawn before the clock starts.
+ */
+static long bench_lookups(BenchEngine *engine, BenchOptions *options, uint64_t *latencies, uint64_t *elapsed)
+{
+  uint64_t state = options->seed | 1;
+  BenchZipf zipf = {0, 0, 0, 0, 0};
+  if (strcmp(options->dist, "zipf") == 0)
+  {
+    bench_zipf_init(&zipf, options->keys, options->theta);
+  }
+  char **keys = bench_make_keys("key", options->keys);
+  char **missing = bench_make_keys("miss", options->keys);
+  char **stream = (char **)malloc(options->ops * sizeof(char *));
+  for (long i = 0; i < options->ops; i++)
+  {
+    int hit = bench_random_double(&state) < options->hit_ratio;
+    long rank = bench_pick(options, &zipf, &state, options->keys);
+    stream[i] = hit ? keys[rank] : missing[rank];
+  }
+
+  void *table = engine->create(options->keys);
+  for (long i = 0; i < options->keys; i++)
+  {
+    engine->insert(table, keys[i], keys[i]);
+  }
+  if (engine->seal != NULL)
+  {
+    engine->seal(table);
+  }
+  long found = 0;
+  long sampled = 0;
+  uint64_t start = bench_now_ns();
+  for (long i = 0; i < options->ops; i++)
+  {
+    if (i % options->sample == 0)
+    {
+      uint64_t before = bench_now_ns();
+      found += engine->retrieve(table, stream[i]) != NULL;
+      latencies[sampled++] = bench_now_ns() - before;
+    }
+    else
+    {
+      found += engine->retrieve(table, stream[i]) != NULL;
+    }
+  }
+  *elapsed = bench_now_ns() - start;
+
+  engine->destroy(table);
+  free(stream);
+  bench_free_keys(keys);
+  bench_free_keys(missing);
+  return found;
+}
+
+/*
+  Churn: every even operation inserts a new key, every odd one removes
+  the oldest key left.
+ */
+static long bench_churn(BenchEngine *engine, BenchOptions *options, uint64_t *latencies, uint64_t *elapsed)
+{
+  long inserts = (options->ops + 1) / 2;
+  char **keys = bench_make_keys("key", options->keys);
+  char **fresh = bench_make_keys("churn", inserts);
+  void *table = engine->create(options->keys);
+  for (long i = 0; i < options->keys; i++)
+  {
+    engine->insert(table, keys[i], keys[i]);
+  }
+  long sampled = 0;
+  uint64_t start = bench_now_ns();
+  for (long i = 0; i < options->ops; i++)
+  {
+    long j = i / 2;
+    char *oldest = j < options->keys ? keys[j] : fresh[j - options->keys];
+    uint64_t before = i % options->sample == 0 ? bench_now_ns() : 0;
+    if (i % 2 == 0)
+    {
+      engine->insert(table, fresh[j], fresh[j]);
+    }
+    else
+    {
+      engine->remove(table, oldest);
+    }
+    if (i % options->sample == 0)
+    {
+      latencies[sampled++] = bench_now_ns() - before;
+    }
+  }
+  *elapsed = bench_now_ns() - start;
+
+  engine->destroy(table);
+  bench_free_keys(keys);
+  bench_free_keys(fresh);
+  return 0;
+}
+
+/*
+  Growth: insert ops new keys, starting from an almost empty table.
+ */
+static long bench_growth(BenchEngine *engine, BenchOptions *options, uint64_t *latencies, uint64_t *elapsed)
+{
+  char **keys = bench_make_keys("key", options->ops);
+  void *table = engine->create(engine->grows ? 8 : options->ops);
+  long sampled = 0;
+  uint64_t start = bench_now_ns();
+  for (long i = 0; i < options->ops; i++)
+  {
+    if (i % options->sample == 0)
+    {
+      uint64_t before = bench_now_ns();
+      engine->insert(table, keys[i], keys[i]);
+      latencies[sampled++] = bench_now_ns() - before;
+    }
+    else
+    {
+      engine->insert(table, keys[i], keys[i]);
+    }
+  }
+  *elapsed = bench_now_ns() - start;
+
+  engine->destroy(table);
+  bench_free_keys(keys);
+  return 0;
+}
+
+static int bench_main(int argc, char **argv, BenchEngine *engine)
+{
+  BenchOptions options;
+  if (bench_parse(argc, argv, &options) != 0)
+  {
+    bench_usage(argv[0]);
+    return 2;
+  }
+  if (engine->remove == NULL && strcmp(options.workload, "hit") != 0 && strcmp(options.workload, "miss") != 0)
+  {
+    fprintf(stderr, "%s is read only, skipping %s\n", engine->name, options.workload);
+    return 0;
+  }
+  // results go to the real stdout, whatever the engine prints goes nowhere
+  fflush(stdout);
+  FILE *out = fdopen(dup(STDOUT_FILENO), "w");
+  if (out == NULL || freopen("/dev/null", "w", stdout) == NULL)
+  {
+    perror("bench");
+    return 1;
+  }
+
+  long samples = (options.ops + options.sample - 1) / options.sample;
+  uint64_t *latencies = (uint64_t *)malloc(samples * sizeof(uint64_t));
+  uint64_t elapsed = 0;
+  long found;
+  if (strcmp(options.workload, "hit") == 0 || strcmp(options.workload, "miss") == 0)
+  {
+    found = bench_lookups(engine, &options, latencies, &elapsed);
+  }
+  else if (strcmp(options.workload, "churn") == 0)
+  {
+    found = bench_churn(engine, &options, latencies, &elapsed);
+  }
+  else if (strcmp(options.workload, "growth") == 0)
+  {
+    found = bench_growth(engine, &options, latencies, &elapsed);
+  }
+  else
+  {
+    bench_usage(argv[0]);
+    return 2;
+  }
+  qsort(latencies, samples, sizeof(uint64_t), bench_compare_u64);
+
+  double seconds = elapsed / 1e9;
+  double ops_per_sec = options.ops / seconds;
+  double ns_per_op = (double)elapsed / options.ops;
+  uint64_t p50 = bench_percentile(latencies, samples, 0.50);
+  uint64_t p99 = bench_percentile(latencies, samples, 0.99);
+  uint64_t p999 = bench_percentile(latencies, samples, 0.999);
+  long peak_rss_kb = bench_peak_rss_kb();
+  if (options.json)
+  {
+    fprintf(out,
+            "{\"engine\": \"%s\", \"workload\": \"%s\", \"dist\": \"%s\", \"theta\": %g, \"keys\": %ld, "
+            "\"ops\": %ld, \"hit_ratio\": %g, \"found\": %ld, \"seconds\": %.6f, \"ops_per_sec\": %.0f, "
+            "\"ns_per_op\": %.2f, \"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, \"peak_rss_kb\": %ld}\n",
+            engine->name, options.workload, options.dist, options.theta, options.keys, options.ops,
+            options.hit_ratio, found, seconds, ops_per_sec, ns_per_op, (unsigned long long)p50,
+            (unsigned long long)p99, (unsigned long long)p999, peak_rss_kb);
+  }
+  else
+  {
+    fprintf(out, "%-14s %-7s %-8s keys=%-9ld ops=%-9ld %12.0f ops/sec %8.2f ns/op  p50=%lluns p99=%lluns p999=%lluns  peak_rss=%ldKB\n",
+            engine->name, options.workload, options.dist, options.keys, options.ops, ops_per_sec, ns_per_op,
+            (unsigned long long)p50, (unsigned long long)p99, (unsigned long long)p999, peak_rss_kb);
+  }
+  fclose(out);
+  free(latencies);
+  return 0;
+}
+
+#endif
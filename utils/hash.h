@@ -0,0 +1,145 @@
+#ifndef __hash_h__
+#define __hash_h__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/*
+  Hash functions shared by the hash tables.
+
+  Every function hashes len bytes at key to a full 64 bit value. Tables
+  keep that value and reduce it to a bucket index themselves.
+ */
+typedef uint64_t (*HashFunction)(const void *key, size_t len, uint64_t seed);
+
+/*
+  djb2, one byte at a time. The seed is ignored, so results match the
+  original `hash` functions of the tables.
+ */
+static inline uint64_t hash_djb2(const void *key, size_t len, uint64_t seed)
+{
+  (void)seed;
+  uint64_t hash = 5381;
+  const unsigned char *u_key = (const unsigned char *)key;
+  for (size_t i = 0; i < len; i++)
+  {
+    hash = ((hash << 5) + hash) + u_key[i];
+  }
+  return hash;
+}
+
+/*
+  wyhash style 64 bit hash: reads 4 or 8 bytes at a time and mixes with
+  64x64->128 bit multiplies. Keyed by seed, so with a random seed per
+  table an attacker cannot precompute keys that all land in one bucket.
+ */
+static inline void hash_wy_mum(uint64_t *a, uint64_t *b)
+{
+  __uint128_t r = (__uint128_t)*a * *b;
+  *a = (uint64_t)r;
+  *b = (uint64_t)(r >> 64);
+}
+
+static inline uint64_t hash_wy_mix(uint64_t a, uint64_t b)
+{
+  hash_wy_mum(&a, &b);
+  return a ^ b;
+}
+
+static inline uint64_t hash_wy_read8(const unsigned char *p)
+{
+  uint64_t v;
+  memcpy(&v, p, 8);
+  return v;
+}
+
+static inline uint64_t hash_wy_read4(const unsigned char *p)
+{
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+static inline uint64_t hash_wyhash(const void *key, size_t len, uint64_t seed)
+{
+  static const uint64_t secret[4] = {0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull};
+  const unsigned char *p = (const unsigned char *)key;
+  uint64_t a, b;
+  seed ^= hash_wy_mix(seed ^ secret[0], secret[1]);
+  if (len <= 16)
+  {
+    if (len >= 4)
+    {
+      // two overlapping 4 byte reads from each end cover every byte
+      a = (hash_wy_read4(p) << 32) | hash_wy_read4(p + ((len >> 3) << 2));
+      b = (hash_wy_read4(p + len - 4) << 32) | hash_wy_read4(p + len - 4 - ((len >> 3) << 2));
+    }
+    else if (len > 0)
+    {
+      a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+      b = 0;
+    }
+    else
+    {
+      a = b = 0;
+    }
+  }
+  else
+  {
+    size_t i = len;
+    if (i > 48)
+    {
+      // three independent lanes keep the multipliers busy on long keys
+      uint64_t see1 = seed, see2 = seed;
+      do
+      {
+        seed = hash_wy_mix(hash_wy_read8(p) ^ secret[1], hash_wy_read8(p + 8) ^ seed);
+        see1 = hash_wy_mix(hash_wy_read8(p + 16) ^ secret[2], hash_wy_read8(p + 24) ^ see1);
+        see2 = hash_wy_mix(hash_wy_read8(p + 32) ^ secret[3], hash_wy_read8(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= see1 ^ see2;
+    }
+    while (i > 16)
+    {
+      seed = hash_wy_mix(hash_wy_read8(p) ^ secret[1], hash_wy_read8(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+    a = hash_wy_read8(p + i - 16);
+    b = hash_wy_read8(p + i - 8);
+  }
+  a ^= secret[1];
+  b ^= seed;
+  hash_wy_mum(&a, &b);
+  return hash_wy_mix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+/*
+  A seed that differs from process to process, from /dev/urandom when we
+  can read it, from the clock and an address otherwise.
+ */
+static inline uint64_t hash_random_seed(void)
+{
+  uint64_t seed = 0;
+  FILE *urandom = fopen("/dev/urandom", "rb");
+  if (urandom != NULL)
+  {
+    size_t read = fread(&seed, sizeof(seed), 1, urandom);
+    fclose(urandom);
+    if (read == 1)
+    {
+      return seed;
+    }
+  }
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  seed = ((uint64_t)now.tv_sec << 32) ^ (uint64_t)now.tv_nsec ^ (uint64_t)(uintptr_t)&seed;
+  return hash_wy_mix(seed, 0x9e3779b97f4a7c15ull);
+}
+
+#endif